@@ -8,17 +8,30 @@ QT       -= core gui
 
 TARGET = ailib
 TEMPLATE = lib
-CONFIG += staticlib
+CONFIG += staticlib c++11 thread
 
 DEFINES += SMASTAR_LIBRARY
 
 SOURCES += \
     Scheduler.cpp \
+    SchedulingPolicy.cpp \
+    SchedulerTracer.cpp \
+    ParallelScheduler.cpp \
+    TimerWheel.cpp \
+    TaskInbox.cpp \
+    BudgetController.cpp \
     Task.cpp \
     Graph.cpp \
     BehaviorTree.cpp \
+    BehaviorTreeLoader.cpp \
+    BehaviorProfiler.cpp \
+    UtilitySelector.cpp \
+    Decorators.cpp \
+    Blackboard.cpp \
     HighResolutionTime.cpp \
-    Steering.cpp
+    Steering.cpp \
+    NavMesh.cpp \
+    FlatBehaviorTree.cpp
 
 win32 {
     SOURCES += platform/win32/win32_time.cpp
@@ -35,14 +48,30 @@ HEADERS +=\
     Graph.h \
     Any.h \
     Blackboard.h \
+    BlackboardCondition.h \
     GOAP.h \
     BehaviorTree.h \
+    BehaviorTreeLoader.h \
+    BehaviorProfiler.h \
+    UtilitySelector.h \
+    Decorators.h \
+    Random.h \
     Scheduler.h \
+    SchedulingPolicy.h \
+    SchedulerTracer.h \
+    ParallelScheduler.h \
+    TimerWheel.h \
+    TaskInbox.h \
+    TaskPool.h \
+    Coroutine.h \
+    BudgetController.h \
     Task.h \
     HighResolutionTime.h \
     Steering.h \
     Genetic.h \
-    AStarTask.h
+    AStarTask.h \
+    NavMesh.h \
+    FlatBehaviorTree.h
 
 CONFIG(release, debug|release) {
     M_BUILD_DIR = release
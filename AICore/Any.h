@@ -4,6 +4,7 @@
 #pragma once
 
 #include "ai_global.h"
+#include <functional>
 
 BEGIN_NS_AILIB
 
@@ -0,0 +1,360 @@
+#include "BehaviorProfiler.h"
+#include <algorithm>
+#include <iomanip>
+
+BEGIN_NS_AILIB
+
+namespace
+{
+
+uint32_t latencyBucketOf(HighResolutionTime::Timestamp latency)
+{
+    uint32_t bucket = 0;
+    while(latency > 0 && bucket + 1 < NodeProfile::NUM_LATENCY_BUCKETS)
+    {
+        latency >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+// The exclusive upper bound of the latencies in __bucket__, in microseconds.
+HighResolutionTime::Timestamp latencyBoundOf(uint32_t bucket)
+{
+    return static_cast<HighResolutionTime::Timestamp>(1) << bucket;
+}
+
+double ratio(uint64_t count, uint64_t total)
+{
+    return total == 0 ? 0.0 : 100.0 * count / total;
+}
+
+} // namespace
+
+NodeProfile::NodeProfile() :
+    parent(NO_PARENT),
+    depth(0)
+{
+    reset();
+}
+
+void NodeProfile::recordRun(HighResolutionTime::Timestamp duration)
+{
+    ++runs;
+    selfTime += duration;
+}
+
+void NodeProfile::recordStart(HighResolutionTime::Timestamp& start)
+{
+    if(start == 0)
+    {
+        start = HighResolutionTime::now();
+    }
+}
+
+void NodeProfile::recordResult(bool success, HighResolutionTime::Timestamp& start)
+{
+    if(success)
+    {
+        ++successes;
+    }
+    else
+    {
+        ++failures;
+    }
+
+    if(start != 0)
+    {
+        ++latencies[latencyBucketOf(HighResolutionTime::now() - start)];
+        start = 0;
+    }
+}
+
+void NodeProfile::recordAbort(HighResolutionTime::Timestamp& start)
+{
+    // Only active nodes are aborted. Terminating a finished node ends nothing.
+    if(start != 0)
+    {
+        ++aborts;
+        start = 0;
+    }
+}
+
+void NodeProfile::reset()
+{
+    runs = 0;
+    selfTime = 0;
+    successes = 0;
+    failures = 0;
+    aborts = 0;
+    std::fill(latencies, latencies + NUM_LATENCY_BUCKETS, 0);
+}
+
+HighResolutionTime::Timestamp NodeProfile::getLatencyQuantile(double quantile) const
+{
+    uint64_t total = 0;
+    for(uint32_t i = 0; i < NUM_LATENCY_BUCKETS; ++i)
+    {
+        total += latencies[i];
+    }
+
+    uint64_t count = 0;
+    for(uint32_t i = 0; i < NUM_LATENCY_BUCKETS; ++i)
+    {
+        count += latencies[i];
+        if(total > 0 && count >= quantile * total)
+        {
+            return latencyBoundOf(i);
+        }
+    }
+    return 0;
+}
+
+BehaviorProfiler::BehaviorProfiler(SchedulerListener* next) :
+    mNext(next)
+{
+    ;
+}
+
+BehaviorProfiler::~BehaviorProfiler()
+{
+    ;
+}
+
+void BehaviorProfiler::attach(Behavior* root, const std::string& tree)
+{
+    AI_ASSERT(root, "Tried to attach a NULL tree.");
+
+    std::vector<VisitedNode> nodes;
+    flatten(root, nodes);
+
+    ProfileList& profiles = mTrees[tree];
+    for(uint32_t i = 0; i < nodes.size(); ++i)
+    {
+        if(i == profiles.size())
+        {
+            // The deque keeps the addresses of existing profiles stable.
+            profiles.push_back(NodeProfile());
+            profiles.back().name = nodes[i].behavior->getName();
+            profiles.back().parent = nodes[i].parent;
+            profiles.back().depth = nodes[i].depth;
+        }
+        AI_ASSERT(profiles[i].parent == nodes[i].parent,
+                  "All instances of a tree must share its structure.");
+
+        mNodes.insert(static_cast<Task*>(nodes[i].behavior), &profiles[i]);
+        nodes[i].behavior->mProfile = &profiles[i];
+        nodes[i].behavior->mProfileStart = 0;
+    }
+}
+
+void BehaviorProfiler::detach(Behavior* root)
+{
+    std::vector<VisitedNode> nodes;
+    flatten(root, nodes);
+
+    for(std::vector<VisitedNode>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+    {
+        mNodes.remove(static_cast<Task*>(it->behavior));
+        it->behavior->mProfile = NULL;
+        it->behavior->mProfileStart = 0;
+    }
+}
+
+bool BehaviorProfiler::recordsResults()
+{
+#ifdef AI_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void BehaviorProfiler::reset()
+{
+    for(TreeMap::iterator it = mTrees.begin(); it != mTrees.end(); ++it)
+    {
+        for(ProfileList::iterator profile = it->second.begin(); profile != it->second.end(); ++profile)
+        {
+            profile->reset();
+        }
+    }
+}
+
+const std::deque<NodeProfile>* BehaviorProfiler::getProfiles(const std::string& tree) const
+{
+    TreeMap::const_iterator it = mTrees.find(tree);
+    return it == mTrees.end() ? NULL : &it->second;
+}
+
+HighResolutionTime::Timestamp BehaviorProfiler::getInclusiveTime(const std::string& tree,
+                                                                 uint32_t node) const
+{
+    const ProfileList* profiles = getProfiles(tree);
+    AI_ASSERT(profiles && node < profiles->size(), "Invalid node.");
+    return getInclusiveTimes(*profiles)[node];
+}
+
+void BehaviorProfiler::writeText(std::ostream& stream) const
+{
+    for(TreeMap::const_iterator it = mTrees.begin(); it != mTrees.end(); ++it)
+    {
+        const ProfileList& profiles = it->second;
+        const std::vector<HighResolutionTime::Timestamp> inclusive = getInclusiveTimes(profiles);
+
+        stream << it->first << '\n';
+        stream << std::setw(12) << "runs" << std::setw(12) << "self us"
+               << std::setw(12) << "incl us" << std::setw(9) << "succ %"
+               << std::setw(9) << "fail %" << std::setw(9) << "abort %"
+               << std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << "  node\n";
+
+        for(uint32_t i = 0; i < profiles.size(); ++i)
+        {
+            const NodeProfile& profile = profiles[i];
+            const uint64_t activations = profile.successes + profile.failures + profile.aborts;
+            stream << std::setw(12) << profile.runs
+                   << std::setw(12) << profile.selfTime
+                   << std::setw(12) << inclusive[i]
+                   << std::fixed << std::setprecision(1)
+                   << std::setw(9) << ratio(profile.successes, activations)
+                   << std::setw(9) << ratio(profile.failures, activations)
+                   << std::setw(9) << ratio(profile.aborts, activations)
+                   << std::setw(12) << profile.getLatencyQuantile(0.5)
+                   << std::setw(12) << profile.getLatencyQuantile(0.99)
+                   << "  " << std::string(profile.depth * 2, ' ') << profile.name << '\n';
+        }
+        stream << '\n';
+    }
+}
+
+void BehaviorProfiler::writeCsv(std::ostream& stream) const
+{
+    stream << "tree,node,parent,depth,name,runs,self_us,inclusive_us,successes,failures,aborts";
+    for(uint32_t i = 0; i < NodeProfile::NUM_LATENCY_BUCKETS; ++i)
+    {
+        stream << ",latency_lt_" << latencyBoundOf(i) << "us";
+    }
+    stream << '\n';
+
+    for(TreeMap::const_iterator it = mTrees.begin(); it != mTrees.end(); ++it)
+    {
+        const ProfileList& profiles = it->second;
+        const std::vector<HighResolutionTime::Timestamp> inclusive = getInclusiveTimes(profiles);
+
+        for(uint32_t i = 0; i < profiles.size(); ++i)
+        {
+            const NodeProfile& profile = profiles[i];
+            stream << '"' << it->first << "\"," << i << ',';
+            if(profile.parent != NodeProfile::NO_PARENT)
+            {
+                stream << profile.parent;
+            }
+            stream << ',' << profile.depth << ",\"" << profile.name << "\","
+                   << profile.runs << ',' << profile.selfTime << ',' << inclusive[i] << ','
+                   << profile.successes << ',' << profile.failures << ',' << profile.aborts;
+            for(uint32_t j = 0; j < NodeProfile::NUM_LATENCY_BUCKETS; ++j)
+            {
+                stream << ',' << profile.latencies[j];
+            }
+            stream << '\n';
+        }
+    }
+}
+
+void BehaviorProfiler::onTaskAdded(Task* task)
+{
+    if(mNext)
+    {
+        mNext->onTaskAdded(task);
+    }
+}
+
+void BehaviorProfiler::onTaskRemoved(Task* task)
+{
+    if(mNext)
+    {
+        mNext->onTaskRemoved(task);
+    }
+}
+
+void BehaviorProfiler::onBeginRunTask(Task* task)
+{
+#ifdef AI_PROFILE
+    NodeProfile** profile = mNodes.find(task);
+    if(profile)
+    {
+        // Only behaviors are instrumented.
+        (*profile)->recordStart(static_cast<Behavior*>(task)->mProfileStart);
+    }
+#endif
+
+    if(mNext)
+    {
+        mNext->onBeginRunTask(task);
+    }
+}
+
+void BehaviorProfiler::onEndRunTask(Task* task, HighResolutionTime::Timestamp duration)
+{
+    NodeProfile** profile = mNodes.find(task);
+    if(profile)
+    {
+        (*profile)->recordRun(duration);
+    }
+
+    if(mNext)
+    {
+        mNext->onEndRunTask(task, duration);
+    }
+}
+
+void BehaviorProfiler::flatten(Behavior* root, std::vector<VisitedNode>& nodes)
+{
+    std::vector<VisitedNode> stack;
+    VisitedNode first = { root, NodeProfile::NO_PARENT, 0 };
+    stack.push_back(first);
+
+    while(!stack.empty())
+    {
+        const VisitedNode node = stack.back();
+        stack.pop_back();
+
+        const uint32_t idx = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(node);
+
+        // Push the children in reverse, so the first child is visited next.
+        if(Composite* composite = dynamic_cast<Composite*>(node.behavior))
+        {
+            const Composite::BehaviorList& children = composite->getChildren();
+            for(Composite::BehaviorList::const_reverse_iterator it = children.rbegin();
+                it != children.rend(); ++it)
+            {
+                VisitedNode child = { *it, idx, node.depth + 1 };
+                stack.push_back(child);
+            }
+        }
+        else if(Decorator* decorator = dynamic_cast<Decorator*>(node.behavior))
+        {
+            VisitedNode child = { const_cast<Behavior*>(decorator->getChild()), idx, node.depth + 1 };
+            stack.push_back(child);
+        }
+    }
+}
+
+std::vector<HighResolutionTime::Timestamp> BehaviorProfiler::getInclusiveTimes(const ProfileList& profiles)
+{
+    // Parents precede their children, so a reverse pass accumulates whole subtrees.
+    std::vector<HighResolutionTime::Timestamp> inclusive(profiles.size(), 0);
+    for(uint32_t i = static_cast<uint32_t>(profiles.size()); i > 0; --i)
+    {
+        const NodeProfile& profile = profiles[i - 1];
+        inclusive[i - 1] += profile.selfTime;
+        if(profile.parent != NodeProfile::NO_PARENT)
+        {
+            inclusive[profile.parent] += inclusive[i - 1];
+        }
+    }
+    return inclusive;
+}
+
+END_NS_AILIB
@@ -0,0 +1,139 @@
+#ifndef BEHAVIORPROFILER_H
+#define BEHAVIORPROFILER_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "BehaviorTree.h"
+#include "HighResolutionTime.h"
+#include <LinearMath/btHashMap.h>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Defining AI_PROFILE when building the library compiles in the result, abort and latency
+// hooks of behaviors. It doesn't change the layout of any class.
+#ifdef AI_PROFILE
+    #define AI_PROFILE_NODE(call__) \
+        do { if(UNLIKELY(mProfile != NULL)) { mProfile->call__; } } while(0)
+#else
+    #define AI_PROFILE_NODE(call__) do { } while(0)
+#endif
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief NodeProfile aggregates the statistics of one node of a behavior tree over all
+ * instances of the tree.
+ */
+class NodeProfile
+{
+public:
+    // Latencies are binned by powers of two microseconds. The last bucket is open-ended.
+    static const uint32_t NUM_LATENCY_BUCKETS = 24;
+    static const uint32_t NO_PARENT = 0xFFFFFFFF;
+
+    NodeProfile();
+
+    void recordRun(HighResolutionTime::Timestamp duration);
+    // Called at the first run of an activation. __start__ is the node's activation time.
+    void recordStart(HighResolutionTime::Timestamp& /* out */ start);
+    // Ends the activation that began at __start__.
+    void recordResult(bool success, HighResolutionTime::Timestamp& /* in, out */ start);
+    void recordAbort(HighResolutionTime::Timestamp& /* in, out */ start);
+
+    void reset();
+
+    // @returns The upper bound of the latency that __quantile__ of all activations stayed below.
+    HighResolutionTime::Timestamp getLatencyQuantile(double quantile) const;
+
+    std::string name;
+    uint32_t parent;
+    uint32_t depth;
+
+    uint64_t runs;
+    // Time spent in the node's own run().
+    HighResolutionTime::Timestamp selfTime;
+    uint64_t successes;
+    uint64_t failures;
+    uint64_t aborts;
+    // Time from the first run of an activation to its result.
+    uint64_t latencies[NUM_LATENCY_BUCKETS];
+};
+
+/**
+ * @brief BehaviorProfiler records per-node statistics of behavior trees: the number of runs,
+ * self and inclusive time, the ratio of successes, failures and aborts, and a histogram of
+ * the latency from the start of an activation to its result.
+ *
+ * Nodes are identified by their depth-first position in the tree, so all instances of a tree
+ * that share its structure are aggregated. The profiler listens to the scheduler for the
+ * execution times and forwards all events to __next__.
+ *
+ * Results, aborts and latencies are only recorded if the library was built with AI_PROFILE
+ * (see recordsResults). Otherwise only the runs and self times are recorded, and behaviors
+ * don't execute any profiling code. Not thread-safe, all instrumented trees have to run on
+ * the scheduler the profiler listens to.
+ */
+class BehaviorProfiler : public SchedulerListener
+{
+public:
+    explicit BehaviorProfiler(SchedulerListener* next = NULL);
+    virtual ~BehaviorProfiler();
+
+    /**
+     * @brief attach instruments the nodes under __root__ as an instance of the tree __tree__.
+     * The profiler must outlive the instrumentation, and trees must be detached before their
+     * nodes are destroyed or rebuilt.
+     */
+    void attach(Behavior* root, const std::string& tree);
+    void detach(Behavior* root);
+
+    // Clears all statistics, but keeps the instrumentation.
+    void reset();
+
+    // @returns Whether the library was built with AI_PROFILE.
+    static bool recordsResults();
+
+    // @returns NULL if there are no statistics for __tree__.
+    const std::deque<NodeProfile>* getProfiles(const std::string& tree) const;
+    HighResolutionTime::Timestamp getInclusiveTime(const std::string& tree, uint32_t node) const;
+
+    // Writes a human-readable report with one indented line per node.
+    void writeText(std::ostream& stream) const;
+    // Writes one line per node, including the latency histogram.
+    void writeCsv(std::ostream& stream) const;
+
+    virtual void onTaskAdded(Task* task);
+    virtual void onTaskRemoved(Task* task);
+    virtual void onBeginRunTask(Task* task);
+    virtual void onEndRunTask(Task* task, HighResolutionTime::Timestamp duration);
+private:
+    typedef std::deque<NodeProfile> ProfileList;
+    typedef std::map<std::string, ProfileList> TreeMap;
+
+    struct VisitedNode
+    {
+        Behavior* behavior;
+        uint32_t parent;
+        uint32_t depth;
+    };
+
+    typedef btHashMap<btHashPtr, NodeProfile*> NodeMap;
+
+    // Appends the nodes under __root__ in depth-first order.
+    static void flatten(Behavior* root, std::vector<VisitedNode>& /* out */ nodes);
+
+    static std::vector<HighResolutionTime::Timestamp> getInclusiveTimes(const ProfileList& profiles);
+
+    SchedulerListener* mNext;
+    TreeMap mTrees;
+    // The profiles of the instrumented nodes, looked up for every run.
+    NodeMap mNodes;
+};
+
+END_NS_AILIB
+
+#endif // BEHAVIORPROFILER_H
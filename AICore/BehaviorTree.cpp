@@ -1,4 +1,5 @@
 #include "BehaviorTree.h"
+#include "BehaviorProfiler.h"
 #include <stdint.h>
 #include <cstring>
 #include <limits>
@@ -17,9 +18,12 @@ void BehaviorListener::onReset(Behavior* behavior)
 }
 
 Behavior::Behavior() :
-    mListener(NULL)
+    mListener(NULL),
+    mChildIndex(0),
+    mProfile(NULL),
+    mProfileStart(0)
 {
-    ;
+    setName("Behavior");
 }
 
 Behavior::~Behavior()
@@ -34,11 +38,13 @@ void Behavior::setListener(BehaviorListener* listener)
 
 void Behavior::terminate()
 {
+    AI_PROFILE_NODE(recordAbort(mProfileStart));
     setStatus(StatusTerminated);
 }
 
 void Behavior::notifySuccess()
 {
+    AI_PROFILE_NODE(recordResult(true, mProfileStart));
     if(mListener)
     {
         mListener->onSuccess(this);
@@ -48,6 +54,7 @@ void Behavior::notifySuccess()
 
 void Behavior::notifyFailure()
 {
+    AI_PROFILE_NODE(recordResult(false, mProfileStart));
     if(mListener)
     {
         mListener->onFailure(this);
@@ -63,14 +70,14 @@ void Behavior::notifyReset()
     }
 }
 
-void Behavior::setUserData(const hold_any& data)
+void Behavior::setContext(const ContextHandle& context)
 {
-    mUserData = data;
+    mContext = context;
 }
 
-hold_any& Behavior::getUserData()
+const ContextHandle& Behavior::getContext() const
 {
-    return mUserData;
+    return mContext;
 }
 
 Composite::Composite(Scheduler& scheduler,
@@ -78,11 +85,11 @@ Composite::Composite(Scheduler& scheduler,
     mChildren(children),
     mScheduler(scheduler)
 {
-    for(Composite::BehaviorList::iterator it = mChildren.begin();
-        it != mChildren.end(); ++it)
+    for(uint32_t i = 0; i < mChildren.size(); ++i)
     {
         // Composites listen to their children's result codes.
-        (*it)->setListener(this);
+        mChildren[i]->setListener(this);
+        mChildren[i]->mChildIndex = i;
     }
 }
 
@@ -106,25 +113,32 @@ Composite::BehaviorList& Composite::getChildren()
     return mChildren;
 }
 
-void Composite::setUserData(const hold_any& data)
+void Composite::setContext(const ContextHandle& context)
 {
-    Behavior::setUserData(data);
+    Behavior::setContext(context);
     for(Composite::BehaviorList::iterator it = mChildren.begin();
         it != mChildren.end(); ++it)
     {
-        // Pass on the data to all child nodes.
-        (*it)->setUserData(getUserData());
+        // Pass on the context to all child nodes.
+        (*it)->setContext(context);
     }
 }
 
 uint32_t Composite::indexOf(const Behavior* child) const
 {
-    BehaviorList::const_iterator it = std::find(getChildren().begin(),
-                                                getChildren().end(),
-                                                child);
-    AI_ASSERT(it != getChildren().end(),
+    const uint32_t idx = child->mChildIndex;
+    AI_ASSERT(idx < getChildren().size() && getChildren()[idx] == child,
               "Tried to obtain index of inexistant child.");
-    return it - getChildren().begin();
+    return idx;
+}
+
+void Composite::shuffleChildren(Random& random)
+{
+    shuffle(mChildren.begin(), mChildren.end(), random);
+    for(uint32_t i = 0; i < mChildren.size(); ++i)
+    {
+        mChildren[i]->mChildIndex = i;
+    }
 }
 
 SequentialComposite::SequentialComposite(Scheduler& scheduler,
@@ -150,6 +164,8 @@ void SequentialComposite::run()
     // Start by scheduling the first child for execution.
     else
     {
+        // Every activation starts over. Children of the previous one may still be observing.
+        terminateFromIndex(0);
         mScheduler.enqueue(getChildren()[mCurrentBehavior]);
         setStatus(StatusWaiting);
     }
@@ -169,6 +185,12 @@ void SequentialComposite::onReset(Behavior* behavior)
 
     // Terminate all behaviors following this one.
     terminateFromIndex(idx+1);
+
+    // A finished composite is waiting for the reset child's new result.
+    if(getStatus() == StatusDormant)
+    {
+        setStatus(StatusWaiting);
+    }
     notifyReset();
 }
 
@@ -207,7 +229,7 @@ Selector::Selector(Scheduler& scheduler,
                    const Composite::BehaviorList& children) :
     SequentialComposite(scheduler, children)
 {
-    ;
+    setName("Selector");
 }
 
 Selector::~Selector()
@@ -249,7 +271,7 @@ Sequence::Sequence(Scheduler& scheduler,
                    const Composite::BehaviorList& children) :
     SequentialComposite(scheduler, children)
 {
-    ;
+    setName("Sequence");
 }
 
 Sequence::~Sequence()
@@ -286,13 +308,18 @@ void Sequence::onFailure(Behavior* behavior)
 }
 
 Parallel::Parallel(Scheduler& scheduler,
-                   const Composite::BehaviorList& children) :
-    Composite(scheduler, children)
+                   const Composite::BehaviorList& children,
+                   Policy successPolicy,
+                   Policy failurePolicy) :
+    Composite(scheduler, children),
+    mSucceeded((children.size() + 63) / 64, 0),
+    mFailed((children.size() + 63) / 64, 0),
+    mNumSucceeded(0),
+    mNumFailed(0),
+    mSuccessThreshold(successPolicy == RequireOne ? 1 : static_cast<uint32_t>(children.size())),
+    mFailureThreshold(failurePolicy == RequireOne ? 1 : static_cast<uint32_t>(children.size()))
 {
-    // The return code state array limits the maximum number of children for parallel tasks.
-    AI_ASSERT(children.size() <= sMaxChildCount,
-              "A parallel node can't run more than __sMaxChildCount__ parallel tasks.");
-    resetCodes();
+    setName("Parallel");
 }
 
 Parallel::~Parallel()
@@ -300,6 +327,30 @@ Parallel::~Parallel()
     ;
 }
 
+void Parallel::setSuccessThreshold(uint32_t count)
+{
+    AI_ASSERT(count > 0 && count <= getChildren().size(),
+              "The success threshold must be between one and the number of children.");
+    mSuccessThreshold = count;
+}
+
+uint32_t Parallel::getSuccessThreshold() const
+{
+    return mSuccessThreshold;
+}
+
+void Parallel::setFailureThreshold(uint32_t count)
+{
+    AI_ASSERT(count > 0 && count <= getChildren().size(),
+              "The failure threshold must be between one and the number of children.");
+    mFailureThreshold = count;
+}
+
+uint32_t Parallel::getFailureThreshold() const
+{
+    return mFailureThreshold;
+}
+
 void Parallel::run()
 {
     if(getChildren().empty())
@@ -308,6 +359,9 @@ void Parallel::run()
         return;
     }
 
+    // Every activation starts without results.
+    resetCodes();
+
     // Schedule all the child behaviors at once.
     // Reversed to keep the execution sequence left-to-right using our sequential scheduler.
     for(std::vector<Behavior*>::const_reverse_iterator it = getChildren().rbegin();
@@ -336,16 +390,17 @@ void Parallel::terminate()
 void Parallel::onSuccess(Behavior* behavior)
 {
     // Set the corresponding flags for the behavior.
-    const uint32_t idx = indexOf(behavior);
-    ReturnCode before = mCodes[idx];
-    mCodes[idx] = ReturnCodeSuccess;
+    const bool wasSuccess = succeeded();
+    const bool wasFailed = failed();
+    const ReturnCode before = setCode(indexOf(behavior), ReturnCodeSuccess);
 
-    if(allChildrenSucceeded())
+    if(!wasSuccess && succeeded())
     {
-        // Signal successful execution only after all children have succeeded.
+        // Signal successful execution once enough children have succeeded.
+        terminateActiveChildren(behavior);
         notifySuccess();
     }
-    else if(before == ReturnCodeFailure && !anyChildrenFailed())
+    else if(before == ReturnCodeFailure && wasFailed && !failed())
     {
         // This behavior previously failed the parallel node.
         // Schedule the parallel node to run again to restart all terminated nodes and
@@ -357,23 +412,14 @@ void Parallel::onSuccess(Behavior* behavior)
 
 void Parallel::onFailure(Behavior* behavior)
 {
-    // Clear the corresponding flags for the behavior.
-    const uint32_t idx = indexOf(behavior);
-    const bool wasFailed = anyChildrenFailed();
-    mCodes[idx] = ReturnCodeFailure;
+    // Set the corresponding flags for the behavior.
+    const bool wasFailed = failed();
+    setCode(indexOf(behavior), ReturnCodeFailure);
 
-    if(!wasFailed)
+    if(!wasFailed && failed())
     {
         // End all remaining, active parallel tasks.
-        for(std::vector<Behavior*>::const_iterator it = getChildren().begin();
-            it != getChildren().end(); ++it)
-        {
-            if((*it)->getStatus() == StatusRunning ||
-               (*it)->getStatus() == StatusWaiting)
-            {
-                (*it)->terminate();
-            }
-        }
+        terminateActiveChildren(behavior);
 
         // Signal the failure of this node to the parent node.
         notifyFailure();
@@ -383,54 +429,101 @@ void Parallel::onFailure(Behavior* behavior)
 void Parallel::onReset(Behavior* behavior)
 {
     // Clear the corresponding flags for the behavior.
-    const uint32_t idx = indexOf(behavior);
-    const bool wasSuccess = allChildrenSucceeded();
-    const ReturnCode before = mCodes[idx];
-    mCodes[idx] = ReturnCodeNone;
+    const bool wasSuccess = succeeded();
+    const bool wasFailed = failed();
+    const ReturnCode before = setCode(indexOf(behavior), ReturnCodeNone);
 
     // Notify the parent node that this node has an uncertain state if
     // the __behavior__ was determining this node's return state.
-    if((before == ReturnCodeSuccess && wasSuccess) ||
-       (before == ReturnCodeFailure && !anyChildrenFailed()))
+    if((before == ReturnCodeSuccess && wasSuccess && !succeeded()) ||
+       (before == ReturnCodeFailure && wasFailed && !failed()))
     {
         setStatus(StatusWaiting);
         notifyReset();
     }
 }
 
-void Parallel::resetCodes()
+Parallel::ReturnCode Parallel::getCode(uint32_t idx) const
 {
-    std::memset(mCodes, ReturnCodeNone, sizeof(ReturnCode)*getChildren().size());
+    const uint64_t bit = uint64_t(1) << (idx & 63);
+    if(mSucceeded[idx >> 6] & bit)
+    {
+        return ReturnCodeSuccess;
+    }
+    return mFailed[idx >> 6] & bit ? ReturnCodeFailure : ReturnCodeNone;
 }
 
-bool Parallel::allChildrenSucceeded() const
+Parallel::ReturnCode Parallel::setCode(uint32_t idx, ReturnCode code)
 {
-    for(uint32_t i = 0; i < getChildren().size(); ++i)
+    const ReturnCode before = getCode(idx);
+    const uint64_t bit = uint64_t(1) << (idx & 63);
+
+    // Keep the counters in sync with the bitsets.
+    if(before == ReturnCodeSuccess)
     {
-        if(mCodes[i] != ReturnCodeSuccess)
-        {
-            return false;
-        }
+        mSucceeded[idx >> 6] &= ~bit;
+        --mNumSucceeded;
+    }
+    else if(before == ReturnCodeFailure)
+    {
+        mFailed[idx >> 6] &= ~bit;
+        --mNumFailed;
     }
-    return true;
+
+    if(code == ReturnCodeSuccess)
+    {
+        mSucceeded[idx >> 6] |= bit;
+        ++mNumSucceeded;
+    }
+    else if(code == ReturnCodeFailure)
+    {
+        mFailed[idx >> 6] |= bit;
+        ++mNumFailed;
+    }
+    return before;
+}
+
+void Parallel::resetCodes()
+{
+    std::fill(mSucceeded.begin(), mSucceeded.end(), 0);
+    std::fill(mFailed.begin(), mFailed.end(), 0);
+    mNumSucceeded = 0;
+    mNumFailed = 0;
 }
 
-bool Parallel::anyChildrenFailed() const
+bool Parallel::succeeded() const
 {
-    for(uint32_t i = 0; i < getChildren().size(); ++i)
+    return mNumSucceeded >= mSuccessThreshold;
+}
+
+bool Parallel::failed() const
+{
+    // Fail early once the success threshold can't be reached anymore.
+    return mNumFailed >= mFailureThreshold ||
+           mNumFailed > getChildren().size() - mSuccessThreshold;
+}
+
+void Parallel::terminateActiveChildren(const Behavior* finished)
+{
+    for(std::vector<Behavior*>::const_iterator it = getChildren().begin();
+        it != getChildren().end(); ++it)
     {
-        if(mCodes[i] == ReturnCodeFailure)
+        const Status status = (*it)->getStatus();
+        if(*it != finished &&
+           (status == StatusRunning ||
+            status == StatusWaiting ||
+            status == StatusSleeping))
         {
-            return true;
+            (*it)->terminate();
         }
     }
-    return false;
 }
 
 Decorator::Decorator(Scheduler& scheduler, Behavior* child) :
     mScheduler(scheduler),
     mChild(child)
 {
+    setName("Decorator");
     UNUSED(mScheduler);
     AI_ASSERT(mChild, "Child mustn't be NULL.");
     mChild->setListener(this);
@@ -462,13 +555,19 @@ void Decorator::onFailure(Behavior* behavior)
 void Decorator::onReset(Behavior* behavior)
 {
     UNUSED(behavior);
+
+    // A finished decorator is waiting for the reset child's new result.
+    if(getStatus() == StatusDormant)
+    {
+        setStatus(StatusWaiting);
+    }
     notifyReset();
 }
 
-void Decorator::setUserData(const hold_any &data)
+void Decorator::setContext(const ContextHandle& context)
 {
-    Behavior::setUserData(data);
-    mChild->setUserData(data);
+    Behavior::setContext(context);
+    mChild->setContext(context);
 }
 
 const Behavior* Decorator::getChild() const
@@ -486,18 +585,12 @@ void Decorator::terminateChild()
     mChild->terminate();
 }
 
-Composite::BehaviorList make_shuffled(const Composite::BehaviorList& children)
-{
-    Composite::BehaviorList list = children;
-    shuffle(list.begin(), list.end());
-    return list;
-}
-
 RandomSelector::RandomSelector(Scheduler& scheduler,
-                               const Composite::BehaviorList& children) :
-    RandomComposite<Selector>::RandomComposite(scheduler, children)
+                               const Composite::BehaviorList& children,
+                               const Random& random) :
+    RandomComposite<Selector>::RandomComposite(scheduler, children, random)
 {
-    ;
+    setName("RandomSelector");
 }
 
 RandomSelector::~RandomSelector()
@@ -506,10 +599,11 @@ RandomSelector::~RandomSelector()
 }
 
 RandomSequence::RandomSequence(Scheduler& scheduler,
-                               const Composite::BehaviorList& children) :
-    RandomComposite<Sequence>::RandomComposite(scheduler,children)
+                               const Composite::BehaviorList& children,
+                               const Random& random) :
+    RandomComposite<Sequence>::RandomComposite(scheduler, children, random)
 {
-    ;
+    setName("RandomSequence");
 }
 
 RandomSequence::~RandomSequence()
@@ -5,13 +5,62 @@
 
 #include "ai_global.h"
 #include "Scheduler.h"
-#include "Any.h"
+#include "Random.h"
 #include <vector>
-#include <cstdlib>
 
 BEGIN_NS_AILIB
 
 class Behavior;
+class NodeProfile;
+
+/**
+ * @brief ContextHandle is a typed pointer to the agent a behavior tree runs for.
+ *
+ * Behaviors share the agent's data through the handle instead of copies of it. Reading it back
+ * is a plain pointer cast, the type is only checked by assertions.
+ */
+class ContextHandle
+{
+public:
+    ContextHandle() :
+        mData(NULL),
+        mType(NULL)
+    {
+        ;
+    }
+
+    template <typename T>
+    explicit ContextHandle(T* data) :
+        mData(data),
+        mType(typeOf<T>())
+    {
+        ;
+    }
+
+    // @returns NULL if the handle is empty. T must be the type the handle was created with.
+    template <typename T>
+    FORCE_INLINE T* get() const
+    {
+        AI_ASSERT(mData == NULL || mType == typeOf<T>(), "The context has a different type.");
+        return static_cast<T*>(mData);
+    }
+
+    FORCE_INLINE bool empty() const
+    {
+        return mData == NULL;
+    }
+private:
+    // A unique address per type, which doesn't require RTTI.
+    template <typename T>
+    static const void* typeOf()
+    {
+        static const char type = 0;
+        return &type;
+    }
+
+    void* mData;
+    const void* mType;
+};
 
 class BehaviorListener
 {
@@ -38,13 +87,29 @@ public:
     void notifyFailure();
     void notifyReset();
 
-    // Virtual to allow subclasses to decide whether or not the user data should be passed on
+    // Virtual to allow subclasses to decide whether or not the context should be passed on
     // to child behaviors.
-    virtual void setUserData(const hold_any& data);
-    hold_any& getUserData();
+    virtual void setContext(const ContextHandle& context);
+    const ContextHandle& getContext() const;
+
+    // @returns The agent the behavior runs for, NULL if no context was set.
+    template <typename T>
+    FORCE_INLINE T* getContext() const
+    {
+        return mContext.get<T>();
+    }
 private:
+    friend class Composite;
+    friend class BehaviorProfiler;
+
     BehaviorListener* mListener;
-    hold_any mUserData;
+    ContextHandle mContext;
+    // The position in the parent composite's child list.
+    uint32_t mChildIndex;
+    // Set while a BehaviorProfiler instruments the behavior. Present regardless of
+    // AI_PROFILE, so all code agrees on the layout of behaviors.
+    NodeProfile* mProfile;
+    HighResolutionTime::Timestamp mProfileStart;
 };
 
 class Composite : public Behavior, public BehaviorListener
@@ -55,15 +120,19 @@ public:
     Composite(Scheduler& scheduler, const BehaviorList& children);
     virtual ~Composite();
 
+    // The children know their position in this list. Reorder them with shuffleChildren().
     const BehaviorList& getChildren() const;
     BehaviorList& getChildren();
 
-    // Cascades the user data to all children.
-    virtual void setUserData(const hold_any& data);
+    // Cascades the context to all children.
+    virtual void setContext(const ContextHandle& context);
 private:
     BehaviorList mChildren;
 protected:
+    // Constant time lookup of the index of __child__, which must be a child of this node.
     uint32_t indexOf(const Behavior* child) const;
+    // Shuffles the children and updates their indices.
+    void shuffleChildren(Random& random);
 
     Scheduler& mScheduler;
 };
@@ -110,31 +179,69 @@ public:
     virtual void onFailure(Behavior* behavior);
 };
 
+/**
+ * @brief Parallel runs all its children at once.
+ *
+ * The node succeeds once enough children succeeded and fails once enough children failed, or
+ * once too many failed for it to still succeed. The remaining children are terminated. By
+ * default all children have to succeed and a single failure fails the node.
+ *
+ * The results are kept in bitsets and the number of children is unlimited. Callbacks from
+ * children cost constant time, regardless of the number of children.
+ */
 class Parallel : public Composite
 {
 public:
+    enum Policy
+    {
+        // Met by the first child with the result.
+        RequireOne = 0,
+        // Met once all children have the result.
+        RequireAll
+    };
+
     Parallel(Scheduler& scheduler,
-             const Composite::BehaviorList& children);
+             const Composite::BehaviorList& children,
+             Policy successPolicy = RequireAll,
+             Policy failurePolicy = RequireOne);
     virtual ~Parallel();
 
+    // N-of-M policies: The node succeeds once __count__ children succeeded.
+    void setSuccessThreshold(uint32_t count);
+    uint32_t getSuccessThreshold() const;
+    // The node fails once __count__ children failed.
+    void setFailureThreshold(uint32_t count);
+    uint32_t getFailureThreshold() const;
+
     virtual void run();
     virtual void terminate();
     virtual void onSuccess(Behavior* behavior);
     virtual void onFailure(Behavior* behavior);
     virtual void onReset(Behavior* behavior);
 private:
-    void resetCodes();
-    bool allChildrenSucceeded() const;
-    bool anyChildrenFailed() const;
-
     enum ReturnCode
     {
         ReturnCodeNone = 0,
         ReturnCodeSuccess,
         ReturnCodeFailure
     };
-    static const int32_t sMaxChildCount = 8;
-    ReturnCode mCodes[sMaxChildCount];
+
+    ReturnCode getCode(uint32_t idx) const;
+    // @returns The previous return code of the child at __idx__.
+    ReturnCode setCode(uint32_t idx, ReturnCode code);
+    void resetCodes();
+    bool succeeded() const;
+    bool failed() const;
+    // Terminates all active children except __finished__.
+    void terminateActiveChildren(const Behavior* finished);
+
+    // One bit per child.
+    std::vector<uint64_t> mSucceeded;
+    std::vector<uint64_t> mFailed;
+    uint32_t mNumSucceeded;
+    uint32_t mNumFailed;
+    uint32_t mSuccessThreshold;
+    uint32_t mFailureThreshold;
 };
 
 class Decorator : public Behavior, public BehaviorListener
@@ -147,7 +254,7 @@ public:
     virtual void onSuccess(Behavior* behavior);
     virtual void onFailure(Behavior* behavior);
     virtual void onReset(Behavior* behavior);
-    virtual void setUserData(const hold_any &data);
+    virtual void setContext(const ContextHandle& context);
 
     const Behavior* getChild() const;
 protected:
@@ -160,7 +267,7 @@ private:
 
 // Requires a random access iterator.
 template <typename ITER>
-void shuffle(ITER start, ITER end)
+void shuffle(ITER start, ITER end, Random& random)
 {
     AI_ASSERT(end - start <= std::numeric_limits<int32_t>::max(),
               "Too many children - integer overflow.");
@@ -168,8 +275,7 @@ void shuffle(ITER start, ITER end)
     // Fisher-Yates shuffle, used by the random composites below.
     for(int32_t i = end - start - 1; i > 0; --i)
     {
-        // The rand() use can be made deterministic by calling srand() with the same seed on startup.
-        const uint32_t j = rand() % (i + 1);
+        const uint32_t j = random.nextBelow(i + 1);
         typedef typename std::iterator_traits<ITER>::value_type ValueType;
         ValueType tmp = *(start + i);
         *(start + i) = *(start + j);
@@ -177,17 +283,22 @@ void shuffle(ITER start, ITER end)
     }
 }
 
-Composite::BehaviorList make_shuffled(const Composite::BehaviorList& children);
-
+/**
+ * The random composites shuffle their children with their own generator. Give each agent's
+ * composites a generator of its own stream (see Random) to keep their choices reproducible,
+ * no matter which other composites or threads draw numbers.
+ */
 template <typename T>
 class RandomComposite : public T
 {
 public:
     RandomComposite(Scheduler& scheduler,
-                    const Composite::BehaviorList& children) :
-        T(scheduler, make_shuffled(children))
+                    const Composite::BehaviorList& children,
+                    const Random& random) :
+        T(scheduler, children),
+        mRandom(random)
     {
-        ;
+        Composite::shuffleChildren(mRandom);
     }
 
     virtual ~RandomComposite() {}
@@ -196,15 +307,24 @@ public:
     {
         T::terminate();
         // Re-shuffle on termination. (After terminating the children)
-        shuffle(Composite::getChildren().begin(), Composite::getChildren().end());
+        Composite::shuffleChildren(mRandom);
     }
+
+    // Reseeding takes effect at the next shuffle.
+    Random& getRandom()
+    {
+        return mRandom;
+    }
+private:
+    Random mRandom;
 };
 
 class RandomSelector : public RandomComposite<Selector>
 {
 public:
     RandomSelector(Scheduler& scheduler,
-                   const Composite::BehaviorList& children);
+                   const Composite::BehaviorList& children,
+                   const Random& random = Random::unique());
     virtual ~RandomSelector();
 };
 
@@ -212,7 +332,8 @@ class RandomSequence : public RandomComposite<Sequence>
 {
 public:
     RandomSequence(Scheduler& scheduler,
-                   const Composite::BehaviorList& children);
+                   const Composite::BehaviorList& children,
+                   const Random& random = Random::unique());
     virtual ~RandomSequence();
 };
 
@@ -0,0 +1,1409 @@
+#include "BehaviorTreeLoader.h"
+#include "Decorators.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+BEGIN_NS_AILIB
+
+namespace
+{
+
+const char sMagic[4] = { 'A', 'I', 'B', 'T' };
+const uint32_t sMaxIndex = std::numeric_limits<uint16_t>::max();
+
+// Bounds-checked little-endian reads from a binary description.
+class BinaryReader
+{
+public:
+    BinaryReader(const char* data, size_t size) :
+        mData(reinterpret_cast<const uint8_t*>(data)),
+        mSize(size),
+        mPos(0),
+        mFailed(false)
+    {
+        ;
+    }
+
+    uint8_t readUInt8()
+    {
+        if(!ensure(1))
+        {
+            return 0;
+        }
+        return mData[mPos++];
+    }
+
+    uint16_t readUInt16()
+    {
+        if(!ensure(2))
+        {
+            return 0;
+        }
+        const uint16_t value = static_cast<uint16_t>(mData[mPos] | (mData[mPos + 1] << 8));
+        mPos += 2;
+        return value;
+    }
+
+    uint32_t readUInt32()
+    {
+        const uint32_t low = readUInt16();
+        return low | (static_cast<uint32_t>(readUInt16()) << 16);
+    }
+
+    bool readBytes(char* dest, size_t size)
+    {
+        if(!ensure(size))
+        {
+            return false;
+        }
+        std::memcpy(dest, mData + mPos, size);
+        mPos += size;
+        return true;
+    }
+
+    bool failed() const
+    {
+        return mFailed;
+    }
+
+    bool atEnd() const
+    {
+        return mPos == mSize;
+    }
+private:
+    bool ensure(size_t size)
+    {
+        if(mFailed || mSize - mPos < size)
+        {
+            mFailed = true;
+            return false;
+        }
+        return true;
+    }
+
+    const uint8_t* mData;
+    const size_t mSize;
+    size_t mPos;
+    bool mFailed;
+};
+
+void writeUInt8(std::vector<char>& data, uint8_t value)
+{
+    data.push_back(static_cast<char>(value));
+}
+
+void writeUInt16(std::vector<char>& data, uint16_t value)
+{
+    data.push_back(static_cast<char>(value & 0xFF));
+    data.push_back(static_cast<char>(value >> 8));
+}
+
+void writeUInt32(std::vector<char>& data, uint32_t value)
+{
+    writeUInt16(data, static_cast<uint16_t>(value & 0xFFFF));
+    writeUInt16(data, static_cast<uint16_t>(value >> 16));
+}
+
+// A parsed JSON document. Only used to translate JSON into descriptions.
+class JsonValue
+{
+public:
+    enum Type
+    {
+        TypeNull = 0,
+        TypeBool,
+        TypeNumber,
+        TypeString,
+        TypeArray,
+        TypeObject
+    };
+
+    JsonValue() :
+        type(TypeNull),
+        number(0),
+        integral(false)
+    {
+        ;
+    }
+
+    Type type;
+    double number;
+    // Numbers without fraction or exponent become int parameters.
+    bool integral;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue> > members;
+};
+
+class JsonParser
+{
+public:
+    static const uint32_t MAX_DEPTH = 256;
+
+    JsonParser(const char* data, size_t size) :
+        mPos(data),
+        mEnd(data + size),
+        mDepth(0)
+    {
+        ;
+    }
+
+    bool parse(JsonValue& value, std::string& error)
+    {
+        if(!parseValue(value) || (skipWhitespace(), mPos != mEnd))
+        {
+            error = mError.empty() ? "Unexpected characters after the JSON document." : mError;
+            return false;
+        }
+        return true;
+    }
+private:
+    bool fail(const char* error)
+    {
+        if(mError.empty())
+        {
+            mError = error;
+        }
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while(mPos != mEnd && (*mPos == ' ' || *mPos == '\t' || *mPos == '\n' || *mPos == '\r'))
+        {
+            ++mPos;
+        }
+    }
+
+    bool consume(const char* literal)
+    {
+        const size_t length = std::strlen(literal);
+        if(static_cast<size_t>(mEnd - mPos) < length || std::strncmp(mPos, literal, length) != 0)
+        {
+            return false;
+        }
+        mPos += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value)
+    {
+        skipWhitespace();
+        if(mPos == mEnd)
+        {
+            return fail("Unexpected end of the JSON document.");
+        }
+
+        switch(*mPos)
+        {
+        case '{':
+            return parseObject(value);
+        case '[':
+            return parseArray(value);
+        case '"':
+            value.type = JsonValue::TypeString;
+            return parseString(value.string);
+        case 't':
+        case 'f':
+            value.type = JsonValue::TypeBool;
+            value.integral = true;
+            value.number = *mPos == 't' ? 1 : 0;
+            return consume(*mPos == 't' ? "true" : "false") || fail("Invalid JSON literal.");
+        case 'n':
+            value.type = JsonValue::TypeNull;
+            return consume("null") || fail("Invalid JSON literal.");
+        default:
+            return parseNumber(value);
+        }
+    }
+
+    bool parseObject(JsonValue& value)
+    {
+        if(++mDepth > MAX_DEPTH)
+        {
+            return fail("The JSON document is nested too deeply.");
+        }
+
+        value.type = JsonValue::TypeObject;
+        ++mPos;
+        skipWhitespace();
+        if(mPos != mEnd && *mPos == '}')
+        {
+            ++mPos;
+            --mDepth;
+            return true;
+        }
+
+        for(;;)
+        {
+            skipWhitespace();
+            value.members.push_back(std::make_pair(std::string(), JsonValue()));
+            if(mPos == mEnd || *mPos != '"' || !parseString(value.members.back().first))
+            {
+                return fail("Expected a member name.");
+            }
+
+            skipWhitespace();
+            if(mPos == mEnd || *mPos++ != ':')
+            {
+                return fail("Expected ':' after a member name.");
+            }
+
+            if(!parseValue(value.members.back().second))
+            {
+                return false;
+            }
+
+            skipWhitespace();
+            if(mPos == mEnd)
+            {
+                return fail("Unterminated JSON object.");
+            }
+            if(*mPos == '}')
+            {
+                ++mPos;
+                --mDepth;
+                return true;
+            }
+            if(*mPos++ != ',')
+            {
+                return fail("Expected ',' or '}' in a JSON object.");
+            }
+        }
+    }
+
+    bool parseArray(JsonValue& value)
+    {
+        if(++mDepth > MAX_DEPTH)
+        {
+            return fail("The JSON document is nested too deeply.");
+        }
+
+        value.type = JsonValue::TypeArray;
+        ++mPos;
+        skipWhitespace();
+        if(mPos != mEnd && *mPos == ']')
+        {
+            ++mPos;
+            --mDepth;
+            return true;
+        }
+
+        for(;;)
+        {
+            value.elements.push_back(JsonValue());
+            if(!parseValue(value.elements.back()))
+            {
+                return false;
+            }
+
+            skipWhitespace();
+            if(mPos == mEnd)
+            {
+                return fail("Unterminated JSON array.");
+            }
+            if(*mPos == ']')
+            {
+                ++mPos;
+                --mDepth;
+                return true;
+            }
+            if(*mPos++ != ',')
+            {
+                return fail("Expected ',' or ']' in a JSON array.");
+            }
+        }
+    }
+
+    bool parseString(std::string& str)
+    {
+        // Skip the opening quote.
+        ++mPos;
+        while(mPos != mEnd && *mPos != '"')
+        {
+            char c = *mPos++;
+            if(c == '\\')
+            {
+                if(mPos == mEnd)
+                {
+                    break;
+                }
+
+                c = *mPos++;
+                switch(c)
+                {
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case '"':
+                case '\\':
+                case '/':
+                    break;
+                case 'u':
+                    // Node types and parameters are expected to be ASCII.
+                    return fail("Unicode escapes are not supported.");
+                default:
+                    return fail("Invalid escape sequence.");
+                }
+            }
+            str.push_back(c);
+        }
+
+        if(mPos == mEnd)
+        {
+            return fail("Unterminated JSON string.");
+        }
+        ++mPos;
+        return true;
+    }
+
+    bool parseNumber(JsonValue& value)
+    {
+        const char* start = mPos;
+        value.integral = true;
+        if(mPos != mEnd && *mPos == '-')
+        {
+            ++mPos;
+        }
+
+        while(mPos != mEnd && ((*mPos >= '0' && *mPos <= '9') ||
+                               *mPos == '.' || *mPos == 'e' || *mPos == 'E' ||
+                               *mPos == '+' || *mPos == '-'))
+        {
+            if(*mPos == '.' || *mPos == 'e' || *mPos == 'E')
+            {
+                value.integral = false;
+            }
+            ++mPos;
+        }
+
+        const std::string literal(start, mPos);
+        char* end = NULL;
+        value.type = JsonValue::TypeNumber;
+        value.number = std::strtod(literal.c_str(), &end);
+        if(literal.empty() || end != literal.c_str() + literal.size())
+        {
+            return fail("Invalid JSON value.");
+        }
+        return true;
+    }
+
+    const char* mPos;
+    const char* const mEnd;
+    uint32_t mDepth;
+    std::string mError;
+};
+
+const JsonValue* findMember(const JsonValue& object, const char* name)
+{
+    for(size_t i = 0; i < object.members.size(); ++i)
+    {
+        if(object.members[i].first == name)
+        {
+            return &object.members[i].second;
+        }
+    }
+    return NULL;
+}
+
+// Node factories of the composites in BehaviorTree.h.
+template <typename T>
+Behavior* createComposite(NodeContext& context)
+{
+    return context.create<T>(context.getScheduler(), context.getChildren());
+}
+
+template <typename T>
+Behavior* createRandomComposite(NodeContext& context)
+{
+    Random random = Random::unique();
+    if(context.has("seed") || context.has("stream"))
+    {
+        random.setSeed(static_cast<uint32_t>(context.getInt("seed")),
+                       static_cast<uint32_t>(context.getInt("stream")));
+    }
+    return context.create<T>(context.getScheduler(), context.getChildren(), random);
+}
+
+Behavior* createParallel(NodeContext& context)
+{
+    const int32_t numChildren = static_cast<int32_t>(context.getChildren().size());
+    const int32_t success = context.getInt("successThreshold", numChildren);
+    const int32_t failure = context.getInt("failureThreshold", 1);
+    if(numChildren > 0 &&
+       (success <= 0 || success > numChildren || failure <= 0 || failure > numChildren))
+    {
+        return NULL;
+    }
+
+    Parallel* parallel = context.create<Parallel>(context.getScheduler(), context.getChildren());
+    if(numChildren > 0)
+    {
+        parallel->setSuccessThreshold(static_cast<uint32_t>(success));
+        parallel->setFailureThreshold(static_cast<uint32_t>(failure));
+    }
+    return parallel;
+}
+
+// Node factories of the decorators in Decorators.h. Durations are given in seconds.
+HighResolutionTime::Timestamp getDuration(const NodeContext& context, const char* key)
+{
+    return HighResolutionTime::seconds(context.getFloat(key));
+}
+
+LimitPolicy getLimitPolicy(const NodeContext& context)
+{
+    return context.getInt("wait") != 0 ? LimitWait : LimitFail;
+}
+
+template <typename T>
+Behavior* createDecorator(NodeContext& context)
+{
+    if(context.getChildren().size() != 1)
+    {
+        return NULL;
+    }
+    return context.create<T>(context.getScheduler(), context.getChildren().front());
+}
+
+Behavior* createTimeout(NodeContext& context)
+{
+    const HighResolutionTime::Timestamp timeout = getDuration(context, "duration");
+    if(context.getChildren().size() != 1 || timeout <= 0)
+    {
+        return NULL;
+    }
+    return context.create<Timeout>(context.getScheduler(), context.getChildren().front(), timeout);
+}
+
+Behavior* createCooldown(NodeContext& context)
+{
+    const HighResolutionTime::Timestamp cooldown = getDuration(context, "duration");
+    if(context.getChildren().size() != 1 || cooldown < 0)
+    {
+        return NULL;
+    }
+    return context.create<Cooldown>(context.getScheduler(), context.getChildren().front(),
+                                    cooldown, getLimitPolicy(context));
+}
+
+Behavior* createRateLimit(NodeContext& context)
+{
+    const int32_t count = context.getInt("count", 1);
+    const HighResolutionTime::Timestamp period = getDuration(context, "period");
+    if(context.getChildren().size() != 1 || count <= 0 || period < 0)
+    {
+        return NULL;
+    }
+    return context.create<RateLimit>(context.getScheduler(), context.getChildren().front(),
+                                     static_cast<uint32_t>(count), period, getLimitPolicy(context));
+}
+
+Behavior* createRetry(NodeContext& context)
+{
+    const int32_t retries = context.getInt("retries", 1);
+    const HighResolutionTime::Timestamp delay = getDuration(context, "delay");
+    if(context.getChildren().size() != 1 || retries < 0 || delay < 0)
+    {
+        return NULL;
+    }
+    return context.create<Retry>(context.getScheduler(), context.getChildren().front(),
+                                 static_cast<uint32_t>(retries), delay);
+}
+
+Behavior* createRepeat(NodeContext& context)
+{
+    const int32_t count = context.getInt("count", Repeat::REPEAT_FOREVER);
+    const HighResolutionTime::Timestamp delay = getDuration(context, "delay");
+    if(context.getChildren().size() != 1 || count < 0 || delay < 0)
+    {
+        return NULL;
+    }
+    return context.create<Repeat>(context.getScheduler(), context.getChildren().front(),
+                                  static_cast<uint32_t>(count), delay);
+}
+
+bool isActive(const Behavior* behavior)
+{
+    const Status status = behavior->getStatus();
+    return status == StatusRunning || status == StatusWaiting || status == StatusSleeping;
+}
+
+} // namespace
+
+BehaviorTreeDescription::BehaviorTreeDescription()
+{
+    ;
+}
+
+void BehaviorTreeDescription::clear()
+{
+    mStrings.clear();
+    mNodes.clear();
+    mParameters.clear();
+    mOpen.clear();
+}
+
+void BehaviorTreeDescription::beginNode(const std::string& type)
+{
+    AI_ASSERT(mNodes.empty() || !mOpen.empty(), "A tree can only have a single root.");
+    AI_ASSERT(mNodes.size() < sMaxIndex, "Too many nodes.");
+
+    if(!mOpen.empty())
+    {
+        Node& parent = mNodes[mOpen.back()];
+        AI_ASSERT(parent.numChildren < sMaxIndex, "Too many children.");
+        ++parent.numChildren;
+    }
+
+    Node node;
+    node.type = intern(type);
+    node.numChildren = 0;
+    node.numParameters = 0;
+    node.firstParameter = static_cast<uint32_t>(mParameters.size());
+    mNodes.push_back(node);
+    mOpen.push_back(static_cast<uint32_t>(mNodes.size() - 1));
+}
+
+void BehaviorTreeDescription::setParameter(const std::string& key, int32_t value)
+{
+    addParameter(key, ParameterInt).value.i = value;
+}
+
+void BehaviorTreeDescription::setParameter(const std::string& key, float value)
+{
+    addParameter(key, ParameterFloat).value.f = value;
+}
+
+void BehaviorTreeDescription::setParameter(const std::string& key, const std::string& value)
+{
+    const uint16_t str = intern(value);
+    addParameter(key, ParameterString).value.s = str;
+}
+
+void BehaviorTreeDescription::endNode()
+{
+    AI_ASSERT(!mOpen.empty(), "There is no open node to end.");
+    mOpen.pop_back();
+}
+
+bool BehaviorTreeDescription::isComplete() const
+{
+    return !mNodes.empty() && mOpen.empty();
+}
+
+bool BehaviorTreeDescription::read(const char* data, size_t size)
+{
+    if(size >= sizeof(sMagic) && std::memcmp(data, sMagic, sizeof(sMagic)) == 0)
+    {
+        return readBinary(data, size);
+    }
+    return readJson(data, size);
+}
+
+bool BehaviorTreeDescription::readBinary(const char* data, size_t size)
+{
+    clear();
+
+    BinaryReader reader(data, size);
+    char magic[sizeof(sMagic)];
+    if(!reader.readBytes(magic, sizeof(magic)) || std::memcmp(magic, sMagic, sizeof(sMagic)) != 0)
+    {
+        return fail("Not a binary behavior tree.");
+    }
+
+    if(reader.readUInt16() != VERSION)
+    {
+        return fail("Unsupported binary behavior tree version.");
+    }
+
+    const uint16_t numStrings = reader.readUInt16();
+    mStrings.resize(numStrings);
+    for(uint16_t i = 0; i < numStrings && !reader.failed(); ++i)
+    {
+        mStrings[i].resize(reader.readUInt16());
+        if(!mStrings[i].empty())
+        {
+            reader.readBytes(&mStrings[i][0], mStrings[i].size());
+        }
+    }
+
+    // The number of subtrees that still have to be read. Each node is the root of one and
+    // adds one per child.
+    uint32_t pending = 1;
+    const uint16_t numNodes = reader.readUInt16();
+    mNodes.reserve(numNodes);
+    for(uint16_t i = 0; i < numNodes && !reader.failed(); ++i)
+    {
+        Node node;
+        node.type = reader.readUInt16();
+        node.numChildren = reader.readUInt16();
+        node.numParameters = reader.readUInt8();
+        node.firstParameter = static_cast<uint32_t>(mParameters.size());
+
+        if(pending == 0)
+        {
+            return fail("A tree can only have a single root.");
+        }
+        pending += node.numChildren - 1;
+
+        for(uint8_t j = 0; j < node.numParameters && !reader.failed(); ++j)
+        {
+            Parameter parameter;
+            parameter.key = reader.readUInt16();
+            parameter.kind = reader.readUInt8();
+            parameter.value.i = 0;
+            switch(parameter.kind)
+            {
+            case ParameterInt:
+                parameter.value.i = static_cast<int32_t>(reader.readUInt32());
+                break;
+            case ParameterFloat:
+            {
+                const uint32_t bits = reader.readUInt32();
+                std::memcpy(&parameter.value.f, &bits, sizeof(bits));
+                break;
+            }
+            case ParameterString:
+                parameter.value.s = reader.readUInt16();
+                if(parameter.value.s >= numStrings)
+                {
+                    return fail("Invalid string reference.");
+                }
+                break;
+            default:
+                return fail("Invalid parameter kind.");
+            }
+
+            if(parameter.key >= numStrings)
+            {
+                return fail("Invalid string reference.");
+            }
+            mParameters.push_back(parameter);
+        }
+
+        if(node.type >= numStrings)
+        {
+            return fail("Invalid string reference.");
+        }
+        mNodes.push_back(node);
+    }
+
+    if(reader.failed())
+    {
+        return fail("Unexpected end of the binary behavior tree.");
+    }
+    if(!reader.atEnd())
+    {
+        return fail("Unexpected data after the binary behavior tree.");
+    }
+    if(mNodes.empty() || pending != 0)
+    {
+        return fail("The binary behavior tree is incomplete.");
+    }
+    return true;
+}
+
+bool BehaviorTreeDescription::readJson(const char* data, size_t size)
+{
+    clear();
+
+    JsonValue document;
+    JsonParser parser(data, size);
+    if(!parser.parse(document, mError))
+    {
+        return fail(mError);
+    }
+
+    // Translate the nodes depth-first. The root is visited first.
+    std::vector<std::pair<const JsonValue*, size_t> > stack;
+    stack.push_back(std::make_pair(&document, size_t(0)));
+    while(!stack.empty())
+    {
+        const JsonValue& object = *stack.back().first;
+        size_t& nextChild = stack.back().second;
+
+        if(nextChild == 0)
+        {
+            const JsonValue* type = findMember(object, "type");
+            if(object.type != JsonValue::TypeObject || !type || type->type != JsonValue::TypeString)
+            {
+                return fail("Every node must be an object with a string member \"type\".");
+            }
+            if(mNodes.size() >= sMaxIndex || mStrings.size() + 2 * object.members.size() >= sMaxIndex)
+            {
+                return fail("The tree is too large.");
+            }
+            if(type->string.size() > sMaxIndex)
+            {
+                return fail("The node type is too long.");
+            }
+
+            beginNode(type->string);
+            uint32_t numParameters = 0;
+            for(size_t i = 0; i < object.members.size(); ++i)
+            {
+                const std::string& key = object.members[i].first;
+                const JsonValue& value = object.members[i].second;
+                if(key == "type" || key == "children")
+                {
+                    continue;
+                }
+
+                if(++numParameters > std::numeric_limits<uint8_t>::max())
+                {
+                    return fail("Nodes are limited to 255 parameters.");
+                }
+                if(key.size() > sMaxIndex ||
+                   (value.type == JsonValue::TypeString && value.string.size() > sMaxIndex))
+                {
+                    return fail("The parameter \"" + key.substr(0, 32) + "\" is too long.");
+                }
+
+                if(value.type == JsonValue::TypeString)
+                {
+                    setParameter(key, value.string);
+                }
+                else if((value.type == JsonValue::TypeNumber || value.type == JsonValue::TypeBool) &&
+                        value.integral &&
+                        value.number >= std::numeric_limits<int32_t>::min() &&
+                        value.number <= std::numeric_limits<int32_t>::max())
+                {
+                    setParameter(key, static_cast<int32_t>(value.number));
+                }
+                else if(value.type == JsonValue::TypeNumber)
+                {
+                    setParameter(key, static_cast<float>(value.number));
+                }
+                else
+                {
+                    return fail("Parameters must be numbers, booleans or strings.");
+                }
+            }
+        }
+
+        const JsonValue* children = findMember(object, "children");
+        if(children && children->type != JsonValue::TypeArray)
+        {
+            return fail("The member \"children\" must be an array.");
+        }
+        if(children && children->elements.size() >= sMaxIndex)
+        {
+            return fail("Too many children.");
+        }
+
+        if(children && nextChild < children->elements.size())
+        {
+            stack.push_back(std::make_pair(&children->elements[nextChild++], size_t(0)));
+        }
+        else
+        {
+            endNode();
+            stack.pop_back();
+        }
+    }
+    return true;
+}
+
+void BehaviorTreeDescription::writeBinary(std::vector<char>& data) const
+{
+    AI_ASSERT(isComplete(), "Tried to write an incomplete description.");
+
+    data.insert(data.end(), sMagic, sMagic + sizeof(sMagic));
+    writeUInt16(data, VERSION);
+
+    writeUInt16(data, static_cast<uint16_t>(mStrings.size()));
+    for(std::vector<std::string>::const_iterator it = mStrings.begin(); it != mStrings.end(); ++it)
+    {
+        writeUInt16(data, static_cast<uint16_t>(it->size()));
+        data.insert(data.end(), it->begin(), it->end());
+    }
+
+    writeUInt16(data, static_cast<uint16_t>(mNodes.size()));
+    for(std::vector<Node>::const_iterator it = mNodes.begin(); it != mNodes.end(); ++it)
+    {
+        writeUInt16(data, it->type);
+        writeUInt16(data, it->numChildren);
+        writeUInt8(data, it->numParameters);
+        for(uint32_t i = 0; i < it->numParameters; ++i)
+        {
+            const Parameter& parameter = mParameters[it->firstParameter + i];
+            writeUInt16(data, parameter.key);
+            writeUInt8(data, parameter.kind);
+            if(parameter.kind == ParameterString)
+            {
+                writeUInt16(data, parameter.value.s);
+            }
+            else
+            {
+                uint32_t bits;
+                std::memcpy(&bits, &parameter.value, sizeof(bits));
+                writeUInt32(data, bits);
+            }
+        }
+    }
+}
+
+const std::string& BehaviorTreeDescription::getError() const
+{
+    return mError;
+}
+
+uint16_t BehaviorTreeDescription::intern(const std::string& str)
+{
+    std::vector<std::string>::const_iterator it = std::find(mStrings.begin(), mStrings.end(), str);
+    if(it != mStrings.end())
+    {
+        return static_cast<uint16_t>(it - mStrings.begin());
+    }
+
+    AI_ASSERT(mStrings.size() < sMaxIndex, "Too many strings.");
+    AI_ASSERT(str.size() <= sMaxIndex, "Strings are limited to 65535 characters.");
+    mStrings.push_back(str);
+    return static_cast<uint16_t>(mStrings.size() - 1);
+}
+
+BehaviorTreeDescription::Parameter& BehaviorTreeDescription::addParameter(const std::string& key,
+                                                                          ParameterKind kind)
+{
+    AI_ASSERT(!mOpen.empty(), "Parameters must belong to a node.");
+    Node& node = mNodes[mOpen.back()];
+    AI_ASSERT(node.firstParameter + node.numParameters == mParameters.size(),
+              "Parameters must be set before the node's first child begins.");
+    AI_ASSERT(node.numParameters < std::numeric_limits<uint8_t>::max(), "Too many parameters.");
+
+    Parameter parameter;
+    parameter.key = intern(key);
+    parameter.kind = static_cast<uint8_t>(kind);
+    parameter.value.i = 0;
+    mParameters.push_back(parameter);
+    ++node.numParameters;
+    return mParameters.back();
+}
+
+bool BehaviorTreeDescription::fail(const std::string& error)
+{
+    // Copy first, __error__ may be mError itself.
+    const std::string message = error;
+    clear();
+    mError = message;
+    return false;
+}
+
+BehaviorArena::BehaviorArena(size_t blockSize) :
+    mBlockSize(blockSize),
+    mOffset(0),
+    mUsed(0)
+{
+    AI_ASSERT(blockSize > 0, "The block size must be positive.");
+}
+
+BehaviorArena::~BehaviorArena()
+{
+    reset();
+}
+
+void* BehaviorArena::allocate(size_t size, size_t alignment)
+{
+    AI_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0,
+              "The alignment must be a power of two.");
+
+    // Blocks are aligned for any fundamental type, so aligning the offset suffices.
+    size_t offset = (mOffset + alignment - 1) & ~(alignment - 1);
+    if(mBlocks.empty() || offset + size > mBlocks.back().size)
+    {
+        addBlock(std::max(mBlockSize, size));
+        offset = 0;
+    }
+
+    mUsed += offset - mOffset + size;
+    mOffset = offset + size;
+    return mBlocks.back().data + offset;
+}
+
+void BehaviorArena::reset()
+{
+    for(std::vector<Block>::iterator it = mBlocks.begin(); it != mBlocks.end(); ++it)
+    {
+        delete[] it->data;
+    }
+    mBlocks.clear();
+    mOffset = 0;
+    mUsed = 0;
+}
+
+void BehaviorArena::swap(BehaviorArena& other)
+{
+    mBlocks.swap(other.mBlocks);
+    std::swap(mBlockSize, other.mBlockSize);
+    std::swap(mOffset, other.mOffset);
+    std::swap(mUsed, other.mUsed);
+}
+
+void BehaviorArena::reserve(size_t size)
+{
+    if(mBlocks.empty() || mBlocks.back().size - mOffset < size)
+    {
+        addBlock(std::max(mBlockSize, size));
+    }
+}
+
+size_t BehaviorArena::getUsedSize() const
+{
+    return mUsed;
+}
+
+void BehaviorArena::addBlock(size_t size)
+{
+    Block block;
+    block.data = new char[size];
+    block.size = size;
+    mBlocks.push_back(block);
+    mOffset = 0;
+}
+
+NodeContext::NodeContext(Scheduler& scheduler,
+                         BehaviorArena& arena,
+                         std::vector<Behavior*>& nodes,
+                         const BehaviorTreeDescription& description,
+                         uint32_t node,
+                         const Composite::BehaviorList& children) :
+    mScheduler(scheduler),
+    mArena(arena),
+    mNodes(nodes),
+    mDescription(description),
+    mNode(node),
+    mChildren(children)
+{
+    ;
+}
+
+Scheduler& NodeContext::getScheduler() const
+{
+    return mScheduler;
+}
+
+const Composite::BehaviorList& NodeContext::getChildren() const
+{
+    return mChildren;
+}
+
+bool NodeContext::has(const char* key) const
+{
+    return find(key) != NULL;
+}
+
+int32_t NodeContext::getInt(const char* key, int32_t defaultValue) const
+{
+    const BehaviorTreeDescription::Parameter* parameter = find(key);
+    if(!parameter)
+    {
+        return defaultValue;
+    }
+
+    switch(parameter->kind)
+    {
+    case BehaviorTreeDescription::ParameterInt:
+        return parameter->value.i;
+    case BehaviorTreeDescription::ParameterFloat:
+        return static_cast<int32_t>(parameter->value.f);
+    default:
+        return defaultValue;
+    }
+}
+
+float NodeContext::getFloat(const char* key, float defaultValue) const
+{
+    const BehaviorTreeDescription::Parameter* parameter = find(key);
+    if(!parameter)
+    {
+        return defaultValue;
+    }
+
+    switch(parameter->kind)
+    {
+    case BehaviorTreeDescription::ParameterInt:
+        return static_cast<float>(parameter->value.i);
+    case BehaviorTreeDescription::ParameterFloat:
+        return parameter->value.f;
+    default:
+        return defaultValue;
+    }
+}
+
+std::string NodeContext::getString(const char* key, const std::string& defaultValue) const
+{
+    const BehaviorTreeDescription::Parameter* parameter = find(key);
+    if(!parameter || parameter->kind != BehaviorTreeDescription::ParameterString)
+    {
+        return defaultValue;
+    }
+    return mDescription.getString(parameter->value.s);
+}
+
+const BehaviorTreeDescription::Parameter* NodeContext::find(const char* key) const
+{
+    const BehaviorTreeDescription::Node& node = mDescription.getNode(mNode);
+    for(uint32_t i = 0; i < node.numParameters; ++i)
+    {
+        const BehaviorTreeDescription::Parameter& parameter =
+            mDescription.getParameter(node.firstParameter + i);
+        if(mDescription.getString(parameter.key) == key)
+        {
+            return &parameter;
+        }
+    }
+    return NULL;
+}
+
+NodeRegistry::NodeRegistry()
+{
+    add("Sequence", &createComposite<Sequence>);
+    add("Selector", &createComposite<Selector>);
+    add("RandomSequence", &createRandomComposite<RandomSequence>);
+    add("RandomSelector", &createRandomComposite<RandomSelector>);
+    add("Parallel", &createParallel);
+    add("Inverter", &createDecorator<Inverter>);
+    add("Succeeder", &createDecorator<Succeeder>);
+    add("Timeout", &createTimeout);
+    add("Cooldown", &createCooldown);
+    add("RateLimit", &createRateLimit);
+    add("Retry", &createRetry);
+    add("Repeat", &createRepeat);
+}
+
+void NodeRegistry::add(const std::string& type, NodeFactory factory)
+{
+    AI_ASSERT(factory, "Factories may not be NULL.");
+    mFactories[type] = factory;
+}
+
+void NodeRegistry::remove(const std::string& type)
+{
+    mFactories.erase(type);
+}
+
+NodeFactory NodeRegistry::find(const std::string& type) const
+{
+    FactoryMap::const_iterator it = mFactories.find(type);
+    return it == mFactories.end() ? NULL : it->second;
+}
+
+bool NodeRegistry::validate(const BehaviorTreeDescription& description, std::string& error) const
+{
+    if(!description.isComplete())
+    {
+        error = "The description is incomplete.";
+        return false;
+    }
+
+    for(uint32_t i = 0; i < description.getNumNodes(); ++i)
+    {
+        const std::string& type = description.getString(description.getNode(i).type);
+        if(!find(type))
+        {
+            error = "Unknown node type \"" + type + "\".";
+            return false;
+        }
+    }
+    return true;
+}
+
+BehaviorTree::BehaviorTree(Scheduler& scheduler, const NodeRegistry& registry) :
+    mScheduler(scheduler),
+    mRegistry(registry),
+    mRoot(NULL),
+    mPreparedRoot(NULL),
+    mListener(NULL),
+    mArenaSize(0),
+    mLibrary(NULL)
+{
+    ;
+}
+
+BehaviorTree::~BehaviorTree()
+{
+    AI_ASSERT(!mLibrary, "Trees of a library must be destroyed by the library.");
+    discard();
+    clear();
+}
+
+bool BehaviorTree::build(const BehaviorTreeDescription& description)
+{
+    if(!prepare(description))
+    {
+        return false;
+    }
+    commit();
+    return true;
+}
+
+void BehaviorTree::clear()
+{
+    if(mRoot && isActive(mRoot))
+    {
+        mRoot->terminate();
+    }
+    destroyNodes();
+    mArena.reset();
+    mRoot = NULL;
+}
+
+void BehaviorTree::start()
+{
+    AI_ASSERT(mRoot, "Tried to start an empty tree.");
+    mScheduler.enqueue(mRoot);
+}
+
+Behavior* BehaviorTree::getRoot() const
+{
+    return mRoot;
+}
+
+void BehaviorTree::setListener(BehaviorListener* listener)
+{
+    mListener = listener;
+    if(mRoot)
+    {
+        mRoot->setListener(listener);
+    }
+}
+
+void BehaviorTree::setContext(const ContextHandle& context)
+{
+    mContext = context;
+    if(mRoot)
+    {
+        mRoot->setContext(context);
+    }
+}
+
+const std::string& BehaviorTree::getError() const
+{
+    return mError;
+}
+
+bool BehaviorTree::prepare(const BehaviorTreeDescription& description)
+{
+    discard();
+    if(!mRegistry.validate(description, mError))
+    {
+        return false;
+    }
+
+    // Build next to the old tree, so it survives failing factories.
+    mPreparedArena.reserve(mArenaSize);
+    mPreparedNodes.reserve(description.getNumNodes());
+
+    // Children precede their parents in reverse depth-first order. Built nodes are pushed on
+    // a stack, so the first child of the next parent is on top.
+    Composite::BehaviorList stack;
+    Composite::BehaviorList children;
+    for(uint32_t i = description.getNumNodes(); i > 0; --i)
+    {
+        const BehaviorTreeDescription::Node& node = description.getNode(i - 1);
+        AI_ASSERT(node.numChildren <= stack.size(), "Invalid description.");
+
+        children.assign(stack.rbegin(), stack.rbegin() + node.numChildren);
+        stack.resize(stack.size() - node.numChildren);
+
+        NodeContext context(mScheduler, mPreparedArena, mPreparedNodes, description, i - 1, children);
+        Behavior* behavior = mRegistry.find(description.getString(node.type))(context);
+        if(!behavior)
+        {
+            mError = "Failed to create a node of type \"" +
+                     description.getString(node.type) + "\".";
+            discard();
+            return false;
+        }
+        stack.push_back(behavior);
+    }
+
+    mPreparedRoot = stack.back();
+    return true;
+}
+
+void BehaviorTree::commit()
+{
+    AI_ASSERT(mPreparedRoot, "There is no prepared tree to commit.");
+
+    const bool wasActive = mRoot && isActive(mRoot);
+    clear();
+
+    mArena.swap(mPreparedArena);
+    mNodes.swap(mPreparedNodes);
+    mArenaSize = mArena.getUsedSize();
+    mRoot = mPreparedRoot;
+    mPreparedRoot = NULL;
+    mRoot->setListener(mListener);
+    if(!mContext.empty())
+    {
+        mRoot->setContext(mContext);
+    }
+
+    if(wasActive)
+    {
+        start();
+    }
+}
+
+void BehaviorTree::discard()
+{
+    for(std::vector<Behavior*>::reverse_iterator it = mPreparedNodes.rbegin();
+        it != mPreparedNodes.rend();
+        ++it)
+    {
+        (*it)->~Behavior();
+    }
+    mPreparedNodes.clear();
+    mPreparedArena.reset();
+    mPreparedRoot = NULL;
+}
+
+void BehaviorTree::destroyNodes()
+{
+    // Parents first, their destructors still access their children.
+    for(std::vector<Behavior*>::reverse_iterator it = mNodes.rbegin(); it != mNodes.rend(); ++it)
+    {
+        (*it)->~Behavior();
+    }
+    mNodes.clear();
+}
+
+BehaviorTreeLibrary::BehaviorTreeLibrary(const NodeRegistry& registry) :
+    mRegistry(registry)
+{
+    ;
+}
+
+BehaviorTreeLibrary::~BehaviorTreeLibrary()
+{
+#ifndef NDEBUG
+    for(EntryMap::const_iterator it = mEntries.begin(); it != mEntries.end(); ++it)
+    {
+        AI_ASSERT(it->second.trees.empty(), "Destroyed a library that still owns trees.");
+    }
+#endif
+}
+
+bool BehaviorTreeLibrary::load(const std::string& name, const char* data, size_t size)
+{
+    BehaviorTreeDescription description;
+    if(!description.read(data, size))
+    {
+        mError = description.getError();
+        return false;
+    }
+    return load(name, description);
+}
+
+bool BehaviorTreeLibrary::load(const std::string& name, const BehaviorTreeDescription& description)
+{
+    if(!mRegistry.validate(description, mError))
+    {
+        return false;
+    }
+
+    Entry& entry = mEntries[name];
+
+    // Hot reload all trees of the definition. Build every tree before replacing any, so a
+    // failing build leaves the definition and all of its trees as they were.
+    std::vector<BehaviorTree*>::iterator it;
+    for(it = entry.trees.begin(); it != entry.trees.end(); ++it)
+    {
+        if(!(*it)->prepare(description))
+        {
+            mError = (*it)->getError();
+            for(std::vector<BehaviorTree*>::iterator jt = entry.trees.begin(); jt != it; ++jt)
+            {
+                (*jt)->discard();
+            }
+            return false;
+        }
+    }
+
+    entry.description = description;
+    for(it = entry.trees.begin(); it != entry.trees.end(); ++it)
+    {
+        (*it)->commit();
+    }
+    return true;
+}
+
+bool BehaviorTreeLibrary::loadFile(const std::string& name, const std::string& path)
+{
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if(!file)
+    {
+        mError = "Failed to open \"" + path + "\".";
+        return false;
+    }
+
+    const std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                                 std::istreambuf_iterator<char>());
+    return load(name, data.empty() ? NULL : &data[0], data.size());
+}
+
+const BehaviorTreeDescription* BehaviorTreeLibrary::find(const std::string& name) const
+{
+    EntryMap::const_iterator it = mEntries.find(name);
+    return it == mEntries.end() ? NULL : &it->second.description;
+}
+
+BehaviorTree* BehaviorTreeLibrary::create(const std::string& name, Scheduler& scheduler)
+{
+    EntryMap::iterator it = mEntries.find(name);
+    if(it == mEntries.end())
+    {
+        mError = "Unknown behavior tree \"" + name + "\".";
+        return NULL;
+    }
+
+    Entry& entry = it->second;
+    BehaviorTree* tree = new BehaviorTree(scheduler, mRegistry);
+    if(!entry.trees.empty())
+    {
+        // Trees of a definition have the same size. Build in a single block.
+        tree->mArenaSize = entry.trees.back()->mArenaSize;
+    }
+
+    if(!tree->build(entry.description))
+    {
+        mError = tree->getError();
+        delete tree;
+        return NULL;
+    }
+
+    tree->mLibrary = this;
+    tree->mDefinition = name;
+    entry.trees.push_back(tree);
+    return tree;
+}
+
+void BehaviorTreeLibrary::destroy(BehaviorTree* tree)
+{
+    if(!tree)
+    {
+        return;
+    }
+
+    AI_ASSERT(tree->mLibrary == this, "The tree wasn't created by this library.");
+    std::vector<BehaviorTree*>& trees = mEntries[tree->mDefinition].trees;
+    trees.erase(std::find(trees.begin(), trees.end(), tree));
+
+    tree->mLibrary = NULL;
+    delete tree;
+}
+
+const std::string& BehaviorTreeLibrary::getError() const
+{
+    return mError;
+}
+
+END_NS_AILIB
@@ -0,0 +1,383 @@
+#ifndef BEHAVIORTREELOADER_H
+#define BEHAVIORTREELOADER_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "BehaviorTree.h"
+#include <map>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief BehaviorTreeDescription is the data a behavior tree is built from: node type names
+ * and parameters in depth-first order.
+ *
+ * Descriptions are built in C++, or read from the compact binary format or from JSON.
+ *
+ * @code
+ * description.beginNode("Selector");
+ *     description.beginNode("Sequence");
+ *         description.beginNode("CanSeeEnemy"); description.endNode();
+ *         description.beginNode("Attack");
+ *         description.setParameter("weapon", "rifle");
+ *         description.endNode();
+ *     description.endNode();
+ *     description.beginNode("Patrol"); description.endNode();
+ * description.endNode();
+ * @endcode
+ *
+ * The equivalent JSON names the type of each node. All other members are parameters:
+ * @code
+ * {"type": "Selector", "children": [
+ *     {"type": "Sequence", "children": [{"type": "CanSeeEnemy"},
+ *                                       {"type": "Attack", "weapon": "rifle"}]},
+ *     {"type": "Patrol"}]}
+ * @endcode
+ *
+ * The binary format is little-endian. All strings are stored once and referenced by index:
+ * @code
+ * char[4]  magic "AIBT"
+ * uint16   version
+ * uint16   number of strings, each: uint16 length, bytes
+ * uint16   number of nodes, each in depth-first order:
+ *          uint16 type (string), uint16 number of children, uint8 number of parameters,
+ *          each parameter: uint16 key (string), uint8 kind,
+ *                          int32 | float32 | uint16 (string) value
+ * @endcode
+ */
+class BehaviorTreeDescription
+{
+public:
+    static const uint16_t VERSION = 1;
+
+    enum ParameterKind
+    {
+        ParameterInt = 0,
+        ParameterFloat,
+        ParameterString
+    };
+
+    class Parameter
+    {
+    public:
+        uint16_t key;
+        uint8_t kind;
+        union
+        {
+            int32_t i;
+            float f;
+            uint16_t s;
+        } value;
+    };
+
+    class Node
+    {
+    public:
+        uint16_t type;
+        uint16_t numChildren;
+        uint8_t numParameters;
+        uint32_t firstParameter;
+    };
+
+    BehaviorTreeDescription();
+
+    void clear();
+
+    // Parameters must be set before the node's first child begins. Strings are limited to
+    // 65535 characters, descriptions to 65535 distinct strings and nodes.
+    void beginNode(const std::string& type);
+    void setParameter(const std::string& key, int32_t value);
+    void setParameter(const std::string& key, float value);
+    void setParameter(const std::string& key, const std::string& value);
+    void endNode();
+
+    // @returns true if the description has a root and all nodes were ended.
+    bool isComplete() const;
+
+    /**
+     * @brief read replaces the description with the tree in __data__, which is either in the
+     * binary format or JSON.
+     * @return false if the data is malformed. The description is empty then,
+     * getError describes the problem.
+     */
+    bool read(const char* data, size_t size);
+    bool readBinary(const char* data, size_t size);
+    bool readJson(const char* data, size_t size);
+
+    // Appends the description in the binary format to __data__.
+    void writeBinary(std::vector<char>& /* out */ data) const;
+
+    const std::string& getError() const;
+
+    FORCE_INLINE const Node& getNode(uint32_t idx) const
+    {
+        return mNodes[idx];
+    }
+
+    FORCE_INLINE uint32_t getNumNodes() const
+    {
+        return static_cast<uint32_t>(mNodes.size());
+    }
+
+    FORCE_INLINE const Parameter& getParameter(uint32_t idx) const
+    {
+        return mParameters[idx];
+    }
+
+    FORCE_INLINE const std::string& getString(uint16_t idx) const
+    {
+        return mStrings[idx];
+    }
+private:
+    uint16_t intern(const std::string& str);
+    Parameter& addParameter(const std::string& key, ParameterKind kind);
+    bool fail(const std::string& error);
+
+    std::vector<std::string> mStrings;
+    std::vector<Node> mNodes;
+    std::vector<Parameter> mParameters;
+    // Builder state: the nodes that haven't been ended yet.
+    std::vector<uint32_t> mOpen;
+    std::string mError;
+};
+
+/**
+ * @brief BehaviorArena hands out the memory for the nodes of one behavior tree from a few
+ * contiguous blocks. Memory is only released all at once.
+ */
+class BehaviorArena
+{
+public:
+    explicit BehaviorArena(size_t blockSize = 4096);
+    ~BehaviorArena();
+
+    void* allocate(size_t size, size_t alignment);
+
+    // Releases all memory.
+    void reset();
+    void swap(BehaviorArena& other);
+
+    // Ensures that the next __size__ bytes are served from a single block.
+    void reserve(size_t size);
+
+    // @returns The number of bytes handed out since the last reset.
+    size_t getUsedSize() const;
+private:
+    BehaviorArena(const BehaviorArena&);
+    BehaviorArena& operator=(const BehaviorArena&);
+
+    void addBlock(size_t size);
+
+    struct Block
+    {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<Block> mBlocks;
+    size_t mBlockSize;
+    size_t mOffset;
+    size_t mUsed;
+};
+
+/**
+ * @brief NodeContext is passed to node factories. It provides the node's parameters, its
+ * already built children and the memory for the node.
+ */
+class NodeContext
+{
+public:
+    NodeContext(Scheduler& scheduler,
+                BehaviorArena& arena,
+                std::vector<Behavior*>& nodes,
+                const BehaviorTreeDescription& description,
+                uint32_t node,
+                const Composite::BehaviorList& children);
+
+    Scheduler& getScheduler() const;
+    const Composite::BehaviorList& getChildren() const;
+
+    // @returns true if the node sets the parameter __key__.
+    bool has(const char* key) const;
+    // @returns The value of the parameter __key__, or __defaultValue__ if it is missing.
+    int32_t getInt(const char* key, int32_t defaultValue = 0) const;
+    float getFloat(const char* key, float defaultValue = 0.0f) const;
+    std::string getString(const char* key, const std::string& defaultValue = std::string()) const;
+
+    // Constructs a node of type T in the tree's arena. The tree destroys it.
+    template <typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        T* node = new (mArena.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        mNodes.push_back(node);
+        return node;
+    }
+private:
+    const BehaviorTreeDescription::Parameter* find(const char* key) const;
+
+    Scheduler& mScheduler;
+    BehaviorArena& mArena;
+    std::vector<Behavior*>& mNodes;
+    const BehaviorTreeDescription& mDescription;
+    const uint32_t mNode;
+    const Composite::BehaviorList& mChildren;
+};
+
+// Creates a node with NodeContext::create. @returns NULL if the node can't be created.
+typedef Behavior* (*NodeFactory)(NodeContext& context);
+
+/**
+ * @brief NodeRegistry maps the node types of descriptions to factories. The composites of
+ * BehaviorTree.h and the decorators of Decorators.h are registered by default:
+ * - Sequence, Selector
+ * - RandomSequence, RandomSelector, with the optional int parameters "seed" and "stream".
+ *   Without either, every node draws from its own stream (see Random::unique).
+ * - Parallel, with the optional int parameters "successThreshold" and "failureThreshold".
+ * - Inverter, Succeeder
+ * - Timeout with the float "duration", Cooldown with the float "duration" and int "wait",
+ *   RateLimit with the int "count", float "period" and int "wait",
+ *   Retry with the int "retries" and float "delay", Repeat with the int "count" (0 repeats
+ *   forever) and float "delay". Durations are in seconds, "wait" selects LimitWait.
+ */
+class NodeRegistry
+{
+public:
+    NodeRegistry();
+
+    // Replaces an existing factory for __type__.
+    void add(const std::string& type, NodeFactory factory);
+    void remove(const std::string& type);
+
+    // @returns NULL if the type isn't registered.
+    NodeFactory find(const std::string& type) const;
+
+    // @returns false if __description__ uses types that aren't registered.
+    bool validate(const BehaviorTreeDescription& description,
+                  std::string& /* out */ error) const;
+private:
+    typedef std::map<std::string, NodeFactory> FactoryMap;
+
+    FactoryMap mFactories;
+};
+
+class BehaviorTreeLibrary;
+
+/**
+ * @brief BehaviorTree is a behavior tree built from a description. All nodes live in one
+ * arena owned by the tree.
+ */
+class BehaviorTree
+{
+public:
+    BehaviorTree(Scheduler& scheduler, const NodeRegistry& registry);
+    ~BehaviorTree();
+
+    /**
+     * @brief build replaces the tree's nodes with the tree in __description__. If the old tree
+     * was active, it is terminated and the new tree is started in its place.
+     * Mustn't be called from one of the tree's own behaviors.
+     * @return false if the description can't be built. The old tree is kept then.
+     */
+    bool build(const BehaviorTreeDescription& description);
+
+    // Destroys all nodes.
+    void clear();
+
+    // Enqueues the root with the scheduler.
+    void start();
+
+    // @returns The root node, NULL if the tree is empty.
+    Behavior* getRoot() const;
+
+    // Set on every root the tree builds.
+    void setListener(BehaviorListener* listener);
+    void setContext(const ContextHandle& context);
+
+    const std::string& getError() const;
+private:
+    friend class BehaviorTreeLibrary;
+
+    BehaviorTree(const BehaviorTree&);
+    BehaviorTree& operator=(const BehaviorTree&);
+
+    // Builds __description__ next to the current tree. Only commit() replaces the tree.
+    bool prepare(const BehaviorTreeDescription& description);
+    void commit();
+    // Destroys the prepared nodes.
+    void discard();
+    void destroyNodes();
+
+    Scheduler& mScheduler;
+    const NodeRegistry& mRegistry;
+    BehaviorArena mArena;
+    // In construction order, children before their parents.
+    std::vector<Behavior*> mNodes;
+    Behavior* mRoot;
+    // The tree built by prepare(), until it is committed or discarded.
+    BehaviorArena mPreparedArena;
+    std::vector<Behavior*> mPreparedNodes;
+    Behavior* mPreparedRoot;
+    BehaviorListener* mListener;
+    ContextHandle mContext;
+    std::string mError;
+    // The arena size of the last build, reserved up-front by the next one.
+    size_t mArenaSize;
+    // The library and definition the tree was created from, if any.
+    BehaviorTreeLibrary* mLibrary;
+    std::string mDefinition;
+};
+
+/**
+ * @brief BehaviorTreeLibrary keeps named descriptions and the trees built from them.
+ *
+ * Loading a description under an existing name hot-reloads it: all trees created from it
+ * are rebuilt, and active trees restart with the new definition. Invalid data, or a definition
+ * that fails to build for any of the trees, is rejected without touching the current definition
+ * and its trees.
+ */
+class BehaviorTreeLibrary
+{
+public:
+    explicit BehaviorTreeLibrary(const NodeRegistry& registry);
+    // The trees created by the library must be destroyed first.
+    ~BehaviorTreeLibrary();
+
+    // Adds or replaces the definition __name__. @returns false if it is invalid.
+    bool load(const std::string& name, const char* data, size_t size);
+    bool load(const std::string& name, const BehaviorTreeDescription& description);
+    // Reads the file at __path__, in the binary format or JSON.
+    bool loadFile(const std::string& name, const std::string& path);
+
+    // @returns NULL if there is no definition __name__.
+    const BehaviorTreeDescription* find(const std::string& name) const;
+
+    // Builds a tree of the definition __name__ that follows reloads. NULL on failure.
+    BehaviorTree* create(const std::string& name, Scheduler& scheduler);
+    void destroy(BehaviorTree* tree);
+
+    const std::string& getError() const;
+private:
+    BehaviorTreeLibrary(const BehaviorTreeLibrary&);
+    BehaviorTreeLibrary& operator=(const BehaviorTreeLibrary&);
+
+    struct Entry
+    {
+        BehaviorTreeDescription description;
+        std::vector<BehaviorTree*> trees;
+    };
+
+    typedef std::map<std::string, Entry> EntryMap;
+
+    const NodeRegistry& mRegistry;
+    EntryMap mEntries;
+    std::string mError;
+};
+
+END_NS_AILIB
+
+#endif // BEHAVIORTREELOADER_H
@@ -0,0 +1,63 @@
+#include "Blackboard.h"
+#include "Scheduler.h"
+#include <algorithm>
+
+BEGIN_NS_AILIB
+
+DeferredNotifications::~DeferredNotifications()
+{
+    ;
+}
+
+BlackboardDispatcher::BlackboardDispatcher(Scheduler& scheduler) :
+    mScheduler(scheduler)
+{
+    setName("BlackboardDispatcher");
+    setPriority(PriorityCritical);
+}
+
+BlackboardDispatcher::~BlackboardDispatcher()
+{
+    if(getStatus() == StatusRunning)
+    {
+        mScheduler.dequeue(this);
+    }
+}
+
+void BlackboardDispatcher::run()
+{
+    // Blackboards written by the listeners are scheduled again, they're flushed by the next run.
+    mFlushing.swap(mPending);
+    for(size_t i = 0; i < mFlushing.size(); ++i)
+    {
+        // Blackboards destroyed by listeners were cancelled.
+        if(mFlushing[i])
+        {
+            mFlushing[i]->flush();
+        }
+    }
+    mFlushing.clear();
+
+    setStatus(mPending.empty() ? StatusDormant : StatusRunning);
+}
+
+void BlackboardDispatcher::schedule(DeferredNotifications* notifications)
+{
+    AI_ASSERT(notifications, "Tried to schedule NULL notifications.");
+    mPending.push_back(notifications);
+    resume();
+}
+
+void BlackboardDispatcher::cancel(DeferredNotifications* notifications)
+{
+    std::replace(mFlushing.begin(), mFlushing.end(),
+                 notifications, static_cast<DeferredNotifications*>(NULL));
+    mPending.erase(std::remove(mPending.begin(), mPending.end(), notifications), mPending.end());
+}
+
+void BlackboardDispatcher::enqueue()
+{
+    mScheduler.enqueue(this);
+}
+
+END_NS_AILIB
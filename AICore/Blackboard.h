@@ -5,11 +5,15 @@
 
 #include "ai_global.h"
 #include "Any.h"
+#include "Task.h"
 #include "btHashMap.h"
 #include <map>
+#include <vector>
 
 BEGIN_NS_AILIB
 
+class Scheduler;
+
 template <typename KEY>
 class BlackboardListener
 {
@@ -21,40 +25,256 @@ public:
 typedef uint32_t Handle;
 const static Handle INVALID_HANDLE = 0;
 
+// When a blackboard notifies its listeners.
+enum BlackboardDispatch
+{
+    // From within set(), once per write.
+    DispatchImmediate = 0,
+    // From flush(), once per changed key, no matter how often the key was written in between.
+    DispatchDeferred
+};
+
+// A source of notifications that were held back until flush() is called.
+class DeferredNotifications
+{
+public:
+    virtual ~DeferredNotifications();
+    virtual void flush() = 0;
+};
+
+/**
+ * @brief BlackboardDispatcher flushes the deferred notifications of blackboards from within
+ * the updates of __scheduler__.
+ *
+ * The dispatcher is a task that is only enqueued while notifications are pending. It runs
+ * with PriorityCritical, so observers are notified before the other tasks of the update when
+ * a priority-aware policy is used. The dispatcher must outlive the blackboards that use it.
+ */
+class BlackboardDispatcher : public Task
+{
+public:
+    explicit BlackboardDispatcher(Scheduler& scheduler);
+    virtual ~BlackboardDispatcher();
+
+    virtual void run();
+
+    // Flushes __notifications__ when the dispatcher runs next.
+    void schedule(DeferredNotifications* notifications);
+    // Withdraws a scheduled flush, e.g. when __notifications__ is destroyed.
+    void cancel(DeferredNotifications* notifications);
+
+    // Enqueues the dispatcher again if flushes are pending, but it was terminated, e.g. by
+    // Scheduler::clear().
+    FORCE_INLINE void resume()
+    {
+        const Status status = getStatus();
+        if(UNLIKELY(status == StatusDormant || status == StatusTerminated) && !mPending.empty())
+        {
+            enqueue();
+        }
+    }
+private:
+    void enqueue();
+
+    Scheduler& mScheduler;
+    std::vector<DeferredNotifications*> mPending;
+    std::vector<DeferredNotifications*> mFlushing;
+};
+
 /**
  * @brief Blackboard A generic class to store knowledge associated to unique keys.
+ *
+ * Listeners either subscribe to a single key or to all keys. Writing a key only calls the
+ * listeners of that key and the ones of all keys, writes to keys nobody listens to cost no
+ * more than storing the value. Listeners may subscribe and unsubscribe while they are being
+ * notified, but mustn't write to the blackboard.
+ *
+ * With DispatchDeferred, writes only mark their key as changed. flush() notifies the
+ * listeners once per changed key with its latest value. Given a BlackboardDispatcher, the
+ * flush happens within the next update of the dispatcher's scheduler, so systems that write
+ * many keys per frame (e.g. perception) cause one notification per key and frame.
+ *
+ * Copies only contain the knowledge, listeners stay subscribed to the original.
  */
 template <typename KEY>
-class Blackboard
+class Blackboard : public DeferredNotifications
 {
-    typedef std::map<Handle, BlackboardListener<KEY>* > BlackboardListeners;
+    typedef std::vector<std::pair<Handle, BlackboardListener<KEY>*> > Listeners;
+
+    struct Entry
+    {
+        Entry() :
+            changed(false)
+        {
+            ;
+        }
+
+        explicit Entry(const ailib::hold_any& value_) :
+            value(value_),
+            changed(false)
+        {
+            ;
+        }
+
+        ailib::hold_any value;
+        // Whether a deferred notification of the key is pending.
+        bool changed;
+    };
 public:
     typedef KEY key_type;
 
     Blackboard() :
-        mCount(INVALID_HANDLE)
+        mCount(INVALID_HANDLE),
+        mDispatch(DispatchImmediate),
+        mDispatcher(NULL),
+        mDispatchDepth(0),
+        mRemovedWhileDispatching(false)
     {
         ;
     }
 
-    // INVALID_HANLDE (= 0) is never returned.
+    Blackboard(const Blackboard& other) :
+        DeferredNotifications(),
+        mKnowledge(other.mKnowledge),
+        mCount(INVALID_HANDLE),
+        mDispatch(DispatchImmediate),
+        mDispatcher(NULL),
+        mDispatchDepth(0),
+        mRemovedWhileDispatching(false)
+    {
+        clearChanges();
+    }
+
+    // Copies the knowledge of __other__. Changed keys aren't reported to the listeners.
+    Blackboard& operator=(const Blackboard& other)
+    {
+        if(this != &other)
+        {
+            mKnowledge = other.mKnowledge;
+            clearChanges();
+        }
+        return *this;
+    }
+
+    virtual ~Blackboard()
+    {
+        // Also pending after a manual flush().
+        if(mDispatcher)
+        {
+            mDispatcher->cancel(this);
+        }
+
+        for(size_t i = 0; i < mSubscriptions.size(); ++i)
+        {
+            delete mSubscriptions[i];
+        }
+    }
+
+    // Notifies __listener__ of changes of all keys. INVALID_HANLDE (= 0) is never returned.
     Handle addListener(BlackboardListener<KEY>* listener)
     {
         AI_ASSERT(listener, "Tried to add NULL listener.");
-        mListeners.insert(std::make_pair(++mCount, listener));
-        return mCount;
+        return addTo(mAllKeys, listener);
+    }
+
+    // Notifies __listener__ of changes of __key__. INVALID_HANLDE (= 0) is never returned.
+    Handle subscribe(const KEY& key, BlackboardListener<KEY>* listener)
+    {
+        AI_ASSERT(listener, "Tried to add NULL listener.");
+        return addTo(*getSubscription(key), listener);
     }
 
+    // Removes listeners added by addListener() or subscribe().
     void removeListener(Handle id)
     {
-        size_t numRemoved = mListeners.erase(id);
-        AI_ASSERT(numRemoved == 1, "Tried to remove non-existant listener.");
+        typename std::map<Handle, Listeners*>::iterator it = mHandles.find(id);
+        AI_ASSERT(it != mHandles.end(), "Tried to remove non-existant listener.");
+        if(it == mHandles.end())
+        {
+            return;
+        }
+
+        Listeners& listeners = *it->second;
+        mHandles.erase(it);
+
+        for(size_t i = 0; i < listeners.size(); ++i)
+        {
+            if(listeners[i].first == id)
+            {
+                if(mDispatchDepth > 0)
+                {
+                    // Keep the positions of the listeners that are yet to be notified.
+                    listeners[i].second = NULL;
+                    mRemovedWhileDispatching = true;
+                }
+                else
+                {
+                    listeners.erase(listeners.begin() + i);
+                }
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief setDispatch sets when listeners are notified. Deferred notifications are flushed
+     * by __dispatcher__, or by calling flush() if it's NULL. Pending notifications are flushed
+     * when switching back to DispatchImmediate.
+     */
+    void setDispatch(BlackboardDispatch dispatch, BlackboardDispatcher* dispatcher = NULL)
+    {
+        if(mDispatcher)
+        {
+            mDispatcher->cancel(this);
+        }
+
+        mDispatch = dispatch;
+        mDispatcher = dispatcher;
+
+        if(!mChanged.empty())
+        {
+            if(mDispatch == DispatchImmediate)
+            {
+                flush();
+            }
+            else if(mDispatcher)
+            {
+                mDispatcher->schedule(this);
+            }
+        }
+    }
+
+    FORCE_INLINE BlackboardDispatch getDispatch() const
+    {
+        return mDispatch;
+    }
+
+    // Notifies the listeners of the keys that changed since the last flush.
+    virtual void flush()
+    {
+        for(size_t i = 0; i < mChanged.size(); ++i)
+        {
+            const KEY& key = mChanged[i];
+
+            // Removed keys aren't reported. Keys that were removed and written again are
+            // listed twice, but only reported once.
+            Entry* entry = mKnowledge.find(key);
+            if(entry && entry->changed)
+            {
+                entry->changed = false;
+                // Looked up now, the key may have been subscribed to since it changed.
+                dispatch(key, findListeners(key), entry->value);
+            }
+        }
+        mChanged.clear();
     }
 
     template <typename T>
     FORCE_INLINE T get(const KEY& key) const
     {
-        return ailib::any_cast<T>(mKnowledge[key]);
+        const Entry* entry = mKnowledge.find(key);
+        AI_ASSERT(entry, "Tried to get a value that isn't on the blackboard.");
+        return ailib::any_cast<T>(entry->value);
     }
 
     FORCE_INLINE bool has(const KEY& key) const
@@ -65,14 +285,23 @@ public:
     template <typename T>
     void set(const KEY& key, const T& value)
     {
-        ailib::hold_any newVal(value);
-        mKnowledge.insert(key, newVal);
+        Entry* stored = mKnowledge.find(key);
+        if(stored)
+        {
+            // Reuses the storage if the type didn't change.
+            stored->value = value;
+        }
+        else
+        {
+            mKnowledge.insert(key, Entry(ailib::hold_any(value)));
+            stored = mKnowledge.find(key);
+        }
 
-        for(typename BlackboardListeners::iterator it = mListeners.begin();
-            it != mListeners.end(); ++it)
+        if(mSubscriptions.empty() && mAllKeys.empty())
         {
-            it->second->onValueChanged(key, newVal);
+            return;
         }
+        notifyChanged(key, *stored);
     }
 
     FORCE_INLINE void remove(const KEY& key)
@@ -95,6 +324,7 @@ public:
             hash *= fnv_prime;
             hash += mKnowledge.getKeyAtIndex(i).getHash();
         }
+        return hash;
     }
 
     FORCE_INLINE int size() const
@@ -112,10 +342,10 @@ public:
         for(int i = 0; i < mKnowledge.size(); ++i)
         {
             const KEY& key = mKnowledge.getKeyAtIndex(i);
-            const ailib::hold_any* value = other.mKnowledge.find(key);
+            const Entry* entry = other.mKnowledge.find(key);
 
-            if(value == NULL ||
-               *value != *mKnowledge.getAtIndex(i))
+            if(entry == NULL ||
+               entry->value != mKnowledge.getAtIndex(i)->value)
             {
                 return false;
             }
@@ -125,10 +355,226 @@ public:
     }
 
 private:
+    Handle addTo(Listeners& listeners, BlackboardListener<KEY>* listener)
+    {
+        listeners.push_back(std::make_pair(++mCount, listener));
+        mHandles.insert(std::make_pair(mCount, &listeners));
+        return mCount;
+    }
+
+    // Creates the listeners of __key__ on first use. Only subscribe() creates them.
+    Listeners* getSubscription(const KEY& key)
+    {
+        Listeners* const* existing = mSubscriptionIndex.find(key);
+        if(existing)
+        {
+            return *existing;
+        }
+
+        // Allocated individually, so handles can rely on its address.
+        Listeners* listeners = new Listeners();
+        mSubscriptions.push_back(listeners);
+        mSubscriptionIndex.insert(key, listeners);
+        return listeners;
+    }
+
+    // @returns NULL if nobody subscribed to __key__.
+    Listeners* findListeners(const KEY& key) const
+    {
+        Listeners* const* listeners = mSubscriptions.empty() ? NULL : mSubscriptionIndex.find(key);
+        return listeners && !(*listeners)->empty() ? *listeners : NULL;
+    }
+
+    void notifyChanged(const KEY& key, Entry& entry)
+    {
+        // Listeners of all keys are notified of every key, without looking it up.
+        Listeners* listeners = NULL;
+        if(mDispatch == DispatchImmediate || mAllKeys.empty())
+        {
+            listeners = findListeners(key);
+            if(!listeners && mAllKeys.empty())
+            {
+                return;
+            }
+        }
+
+        if(mDispatch == DispatchImmediate)
+        {
+            dispatch(key, listeners, entry.value);
+            return;
+        }
+
+        if(!entry.changed)
+        {
+            entry.changed = true;
+            mChanged.push_back(key);
+            if(mChanged.size() == 1 && mDispatcher)
+            {
+                mDispatcher->schedule(this);
+                return;
+            }
+        }
+        if(mDispatcher)
+        {
+            mDispatcher->resume();
+        }
+    }
+
+    // Copies don't inherit pending notifications.
+    void clearChanges()
+    {
+        for(int i = 0; i < mKnowledge.size(); ++i)
+        {
+            mKnowledge.getAtIndex(i)->changed = false;
+        }
+        mChanged.clear();
+    }
+
+    // Notifies the listeners of __key__, if any, then the ones of all keys.
+    void dispatch(const KEY& key, const Listeners* listeners, const ailib::hold_any& value)
+    {
+        ++mDispatchDepth;
+        if(listeners)
+        {
+            notifyAll(*listeners, key, value);
+        }
+        notifyAll(mAllKeys, key, value);
+        if(--mDispatchDepth == 0 && mRemovedWhileDispatching)
+        {
+            compact(mAllKeys);
+            for(size_t i = 0; i < mSubscriptions.size(); ++i)
+            {
+                compact(*mSubscriptions[i]);
+            }
+            mRemovedWhileDispatching = false;
+        }
+    }
+
+    static void notifyAll(const Listeners& listeners,
+                          const KEY& key,
+                          const ailib::hold_any& value)
+    {
+        // Listeners subscribed during the notification wait for the next change.
+        const size_t count = listeners.size();
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(listeners[i].second)
+            {
+                listeners[i].second->onValueChanged(key, value);
+            }
+        }
+    }
+
+    // Erases the listeners that were removed during a notification.
+    static void compact(Listeners& listeners)
+    {
+        size_t kept = 0;
+        for(size_t i = 0; i < listeners.size(); ++i)
+        {
+            if(listeners[i].second)
+            {
+                listeners[kept++] = listeners[i];
+            }
+        }
+        listeners.resize(kept);
+    }
+
     // TODO: Use sparse hashmap instead.
-    btHashMap<KEY, ailib::hold_any> mKnowledge;
-    BlackboardListeners mListeners;
+    btHashMap<KEY, Entry> mKnowledge;
+    // The listeners of the keys that were subscribed to.
+    btHashMap<KEY, Listeners*> mSubscriptionIndex;
+    std::vector<Listeners*> mSubscriptions;
+    Listeners mAllKeys;
+    // Where the listener of each handle is stored.
+    std::map<Handle, Listeners*> mHandles;
+    // The keys with pending deferred notifications, in the order of their first change.
+    std::vector<KEY> mChanged;
     uint32_t mCount;
+    BlackboardDispatch mDispatch;
+    BlackboardDispatcher* mDispatcher;
+    uint32_t mDispatchDepth;
+    bool mRemovedWhileDispatching;
+};
+
+/**
+ * @brief TypedBlackboard stores knowledge in a plain struct, SCHEMA, whose members are the
+ * blackboard's keys.
+ *
+ * The keys are declared up front and the compiler lays out the values, so accessing a key is
+ * a load from a fixed offset: no hash lookup, no type check and no allocation. Keys are
+ * member pointers:
+ * @code
+ * struct SoldierKnowledge
+ * {
+ *     float health;
+ *     btVector3 target;
+ *     bool enemyVisible;
+ * };
+ *
+ * TypedBlackboard<SoldierKnowledge> blackboard;
+ * blackboard.set(&SoldierKnowledge::health, 100.0f);
+ * const float health = blackboard.get(&SoldierKnowledge::health);
+ * @endcode
+ *
+ * All keys always have a value, the ones of a value-initialized SCHEMA to begin with. Use a
+ * Blackboard for knowledge whose keys aren't known at compile time.
+ */
+template <typename SCHEMA>
+class TypedBlackboard
+{
+    // Keeps the value parameter of set() from taking part in type deduction.
+    template <typename T>
+    struct Value
+    {
+        typedef T type;
+    };
+public:
+    typedef SCHEMA schema_type;
+
+    TypedBlackboard() :
+        mValues()
+    {
+        ;
+    }
+
+    explicit TypedBlackboard(const SCHEMA& values) :
+        mValues(values)
+    {
+        ;
+    }
+
+    template <typename T>
+    FORCE_INLINE const T& get(T SCHEMA::* key) const
+    {
+        return mValues.*key;
+    }
+
+    template <typename T>
+    FORCE_INLINE void set(T SCHEMA::* key, const typename Value<T>::type& value)
+    {
+        mValues.*key = value;
+    }
+
+    // Direct access to all values, e.g. for bulk updates.
+    FORCE_INLINE const SCHEMA& getValues() const
+    {
+        return mValues;
+    }
+
+    FORCE_INLINE SCHEMA& getValues()
+    {
+        return mValues;
+    }
+
+    // @returns The position of __key__ in SCHEMA, e.g. to identify keys at runtime.
+    template <typename T>
+    FORCE_INLINE uint32_t offsetOf(T SCHEMA::* key) const
+    {
+        return static_cast<uint32_t>(reinterpret_cast<const char*>(&(mValues.*key)) -
+                                     reinterpret_cast<const char*>(&mValues));
+    }
+private:
+    SCHEMA mValues;
 };
 
 // Adapter class to enable the use of Blackboards as keys in btHashMap.
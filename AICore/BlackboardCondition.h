@@ -0,0 +1,188 @@
+#ifndef BLACKBOARDCONDITION_H
+#define BLACKBOARDCONDITION_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "BehaviorTree.h"
+#include "Blackboard.h"
+#include <vector>
+
+BEGIN_NS_AILIB
+
+// Which results of a condition stay observed after the condition finished.
+enum ObserverAborts
+{
+    // The condition is evaluated once per activation.
+    AbortNone = 0,
+    // While the condition holds, it fails as soon as it doesn't anymore.
+    // Aborts the siblings that were started after it, e.g. the action of a sequence.
+    AbortSelf = 1,
+    // While the condition doesn't hold, it succeeds as soon as it does.
+    // Aborts the lower priority branches of the enclosing selector.
+    AbortLowerPriority = 2,
+    AbortBoth = AbortSelf | AbortLowerPriority
+};
+
+/**
+ * @brief BlackboardCondition is a leaf behavior that succeeds if evaluate() holds for the
+ * contents of a blackboard, and fails otherwise.
+ *
+ * With observer aborts, the condition keeps listening to the keys passed to observe() after
+ * it finished. A change of one of these keys schedules a single re-evaluation, no matter how
+ * often the key is set before the condition runs. If the result flips, the condition resets
+ * its parent (see BehaviorListener::onReset), which terminates the behaviors that were
+ * started after it, and reports the new result. Subtrees whose inputs didn't change are
+ * never re-entered, so agents that wait for their environment to change don't cost any
+ * scheduler time.
+ *
+ * @code
+ * // Attack as soon as an enemy is seen, patrol otherwise.
+ * Selector(Sequence(EnemyVisible(AbortBoth), Attack), Patrol)
+ * @endcode
+ *
+ * The observer is armed until the condition is terminated by its parent.
+ * On a blackboard with DispatchDeferred, bursts of writes reach the condition once per flush.
+ */
+template <typename KEY>
+class BlackboardCondition : public Behavior, public BlackboardListener<KEY>
+{
+public:
+    BlackboardCondition(Scheduler& scheduler,
+                        Blackboard<KEY>& blackboard,
+                        ObserverAborts aborts = AbortNone) :
+        mScheduler(scheduler),
+        mBlackboard(blackboard),
+        mAborts(aborts),
+        mObserving(false),
+        mLastResult(false),
+        mReevaluate(false)
+    {
+        setName("BlackboardCondition");
+    }
+
+    virtual ~BlackboardCondition()
+    {
+        stopObserving();
+    }
+
+    // Re-evaluates the condition whenever __key__ changes.
+    void observe(const KEY& key)
+    {
+        mKeys.push_back(key);
+        if(isObserving())
+        {
+            mHandles.push_back(mBlackboard.subscribe(key, this));
+        }
+    }
+
+    // @returns true if the condition listens for changes of its keys.
+    FORCE_INLINE bool isObserving() const
+    {
+        return mObserving;
+    }
+
+    virtual void run()
+    {
+        const bool result = evaluate(mBlackboard);
+        const bool reevaluation = mReevaluate;
+        mReevaluate = false;
+
+        if(reevaluation && result == mLastResult)
+        {
+            // Nothing the parent depends on changed.
+            setStatus(StatusDormant);
+            return;
+        }
+
+        mLastResult = result;
+        const bool observe = result ? (mAborts & AbortSelf) != 0 :
+                                      (mAborts & AbortLowerPriority) != 0;
+        if(observe)
+        {
+            startObserving();
+        }
+        else
+        {
+            stopObserving();
+        }
+
+        if(reevaluation)
+        {
+            // The result the parent based its decision on is invalid.
+            notifyReset();
+        }
+
+        if(result)
+        {
+            notifySuccess();
+        }
+        else
+        {
+            notifyFailure();
+        }
+    }
+
+    virtual void terminate()
+    {
+        stopObserving();
+        mReevaluate = false;
+        Behavior::terminate();
+    }
+
+    // Only called for the observed keys, the condition subscribes to each of them.
+    virtual void onValueChanged(const KEY& key, const ailib::hold_any& value)
+    {
+        UNUSED(key);
+        UNUSED(value);
+
+        // Coalesce changes until the scheduled re-evaluation ran.
+        if(getStatus() != StatusDormant || !isObserving())
+        {
+            return;
+        }
+
+        mReevaluate = true;
+        mScheduler.enqueue(this);
+    }
+protected:
+    virtual bool evaluate(const Blackboard<KEY>& blackboard) const = 0;
+private:
+    void startObserving()
+    {
+        if(!isObserving())
+        {
+            mObserving = true;
+            for(size_t i = 0; i < mKeys.size(); ++i)
+            {
+                mHandles.push_back(mBlackboard.subscribe(mKeys[i], this));
+            }
+        }
+    }
+
+    void stopObserving()
+    {
+        if(isObserving())
+        {
+            mObserving = false;
+            for(size_t i = 0; i < mHandles.size(); ++i)
+            {
+                mBlackboard.removeListener(mHandles[i]);
+            }
+            mHandles.clear();
+        }
+    }
+
+    Scheduler& mScheduler;
+    Blackboard<KEY>& mBlackboard;
+    std::vector<KEY> mKeys;
+    const ObserverAborts mAborts;
+    std::vector<Handle> mHandles;
+    bool mObserving;
+    bool mLastResult;
+    bool mReevaluate;
+};
+
+END_NS_AILIB
+
+#endif // BLACKBOARDCONDITION_H
@@ -0,0 +1,186 @@
+#include "BudgetController.h"
+#include <algorithm>
+#include <cstring>
+
+BEGIN_NS_AILIB
+
+RuntimeSketch::RuntimeSketch()
+{
+    clear();
+}
+
+void RuntimeSketch::add(HighResolutionTime::Timestamp duration)
+{
+    ++mCounts[bucketOf(duration)];
+
+    if(++mTotal >= MAX_TOTAL)
+    {
+        // Age the distribution. Buckets with a single sample drop out.
+        mTotal = 0;
+        for(uint32_t i = 0; i < NUM_BUCKETS; ++i)
+        {
+            mCounts[i] >>= 1;
+            mTotal += mCounts[i];
+        }
+    }
+}
+
+void RuntimeSketch::clear()
+{
+    std::memset(mCounts, 0, sizeof(mCounts));
+    mTotal = 0;
+}
+
+HighResolutionTime::Timestamp RuntimeSketch::quantile(float q) const
+{
+    if(mTotal == 0)
+    {
+        return 0;
+    }
+
+    const uint32_t rank = static_cast<uint32_t>(std::max(0.f, std::min(1.f, q)) * (mTotal - 1));
+    uint32_t seen = 0;
+    for(uint32_t i = 0; i < NUM_BUCKETS; ++i)
+    {
+        seen += mCounts[i];
+        if(seen > rank)
+        {
+            return upperBoundOf(i);
+        }
+    }
+    return upperBoundOf(NUM_BUCKETS - 1);
+}
+
+uint32_t RuntimeSketch::getTotal() const
+{
+    return mTotal;
+}
+
+uint32_t RuntimeSketch::bucketOf(HighResolutionTime::Timestamp duration)
+{
+    // Same log-linear layout as FairSharePolicy: values below 8 map to themselves,
+    // above that 4 buckets per power of two.
+    const uint64_t value = static_cast<uint64_t>(std::max<HighResolutionTime::Timestamp>(duration, 0));
+    if(value < 8)
+    {
+        return static_cast<uint32_t>(value);
+    }
+
+    const uint32_t msb = findLastSet(value);
+    const uint32_t bucket = (msb - 1) * 4 + static_cast<uint32_t>((value >> (msb - 2)) & 3);
+    return std::min(bucket, NUM_BUCKETS - 1);
+}
+
+HighResolutionTime::Timestamp RuntimeSketch::upperBoundOf(uint32_t bucket)
+{
+    if(bucket < 8)
+    {
+        return bucket;
+    }
+
+    const uint32_t msb = bucket / 4 + 1;
+    const uint64_t mantissa = 4 + bucket % 4;
+    return static_cast<HighResolutionTime::Timestamp>(((mantissa + 1) << (msb - 2)) - 1);
+}
+
+BudgetController::BudgetController(HighResolutionTime::Timestamp maxBudget,
+                                   HighResolutionTime::Timestamp targetFrameTime) :
+    mMinBudget(maxBudget / 4),
+    mMaxBudget(maxBudget),
+    mTargetFrameTime(targetFrameTime),
+    mBudget(maxBudget),
+    mFrameBudget(maxBudget),
+    mOvershoot(0),
+    mDeviations(2.f),
+    mUnknownQuantile(0.9f)
+{
+    AI_ASSERT(maxBudget > 0, "The budget must be positive.");
+}
+
+void BudgetController::setBudgetLimits(HighResolutionTime::Timestamp minBudget,
+                                       HighResolutionTime::Timestamp maxBudget)
+{
+    AI_ASSERT(minBudget >= 0 && minBudget <= maxBudget, "Invalid budget limits.");
+    mMinBudget = minBudget;
+    mMaxBudget = maxBudget;
+    mBudget = std::max(mMinBudget, std::min(mBudget, mMaxBudget));
+}
+
+void BudgetController::setTargetFrameTime(HighResolutionTime::Timestamp frameTime)
+{
+    AI_ASSERT(frameTime >= 0, "The target frame time may not be negative.");
+    mTargetFrameTime = frameTime;
+}
+
+void BudgetController::setPredictionMargin(float deviations, float unknownQuantile)
+{
+    AI_ASSERT(deviations >= 0.f, "The prediction margin may not be negative.");
+    mDeviations = deviations;
+    mUnknownQuantile = unknownQuantile;
+}
+
+HighResolutionTime::Timestamp BudgetController::beginFrame(HighResolutionTime::Timestamp maxRuntime,
+                                                           float dt)
+{
+    // dt <= 0 means the frame time is unknown, keep the current budget.
+    const HighResolutionTime::Timestamp frameTime = HighResolutionTime::seconds(static_cast<double>(dt));
+    if(mTargetFrameTime > 0 && frameTime > 0)
+    {
+        if(frameTime > mTargetFrameTime)
+        {
+            // The frame rate dropped. Back off quickly.
+            mBudget -= mBudget / 4;
+        }
+        else
+        {
+            // Recover slowly, so the budget doesn't oscillate around the limit.
+            mBudget += std::max<HighResolutionTime::Timestamp>(mMaxBudget / 32, 1);
+        }
+        mBudget = std::max(mMinBudget, std::min(mBudget, mMaxBudget));
+    }
+
+    // Pay back the time the last frame took beyond its budget.
+    mFrameBudget = std::max(mMinBudget, mBudget - mOvershoot);
+    mFrameBudget = std::min(mFrameBudget, maxRuntime);
+    mOvershoot = 0;
+    return mFrameBudget;
+}
+
+void BudgetController::endFrame(HighResolutionTime::Timestamp used)
+{
+    mOvershoot = std::max<HighResolutionTime::Timestamp>(used - mFrameBudget, 0);
+}
+
+void BudgetController::record(Task* task, HighResolutionTime::Timestamp duration)
+{
+    task->addRunSample(duration);
+    mSketch.add(duration);
+}
+
+HighResolutionTime::Timestamp BudgetController::predict(const Task* task) const
+{
+    if(task->getNumRunSamples() == 0)
+    {
+        return mSketch.quantile(mUnknownQuantile);
+    }
+
+    return task->getRunEstimate() +
+           static_cast<HighResolutionTime::Timestamp>(mDeviations * task->getRunDeviation());
+}
+
+bool BudgetController::fits(const Task* task, HighResolutionTime::Timestamp remaining) const
+{
+    return predict(task) <= remaining;
+}
+
+HighResolutionTime::Timestamp BudgetController::getBudget() const
+{
+    return mBudget;
+}
+
+const RuntimeSketch& BudgetController::getSketch() const
+{
+    return mSketch;
+}
+
+END_NS_AILIB
@@ -0,0 +1,99 @@
+#ifndef BUDGETCONTROLLER_H
+#define BUDGETCONTROLLER_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "Task.h"
+#include "HighResolutionTime.h"
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief RuntimeSketch approximates the distribution of task execution times.
+ *
+ * Samples are counted in log-linear buckets (4 per power of two, so the relative error of
+ * a quantile is below 19%). Counts are halved once the total reaches a limit, which lets
+ * the sketch follow changes of the workload.
+ */
+class RuntimeSketch
+{
+public:
+    static const uint32_t NUM_BUCKETS = 96;
+
+    RuntimeSketch();
+
+    void add(HighResolutionTime::Timestamp duration);
+    void clear();
+
+    // @returns The upper bound of the bucket containing the __q__-quantile, 0 if empty.
+    HighResolutionTime::Timestamp quantile(float q) const;
+    uint32_t getTotal() const;
+private:
+    static const uint32_t MAX_TOTAL = 4096;
+
+    static uint32_t bucketOf(HighResolutionTime::Timestamp duration);
+    static HighResolutionTime::Timestamp upperBoundOf(uint32_t bucket);
+
+    uint32_t mCounts[NUM_BUCKETS];
+    uint32_t mTotal;
+};
+
+/**
+ * @brief The BudgetController computes the time budget of each Scheduler::update and predicts
+ * whether a task still fits into what remains of it.
+ *
+ * The budget follows the measured frame time (__dt__): it shrinks multiplicatively while frames
+ * take longer than the target frame time and grows additively up to the maximum budget
+ * otherwise. Time spent beyond the budget is deducted from the next frame's budget.
+ *
+ * The cost of a task is predicted as its average execution time plus a multiple of its
+ * mean deviation. Tasks without history are assumed to cost the configured quantile of
+ * all recorded executions.
+ */
+class BudgetController
+{
+public:
+    // Holds a 2 ms budget at 60 frames per second by default.
+    BudgetController(HighResolutionTime::Timestamp maxBudget = 2000,
+                     HighResolutionTime::Timestamp targetFrameTime = 16667);
+
+    // The budget never drops below __minBudget__ and never exceeds __maxBudget__.
+    void setBudgetLimits(HighResolutionTime::Timestamp minBudget,
+                         HighResolutionTime::Timestamp maxBudget);
+    void setTargetFrameTime(HighResolutionTime::Timestamp frameTime);
+
+    /**
+     * @brief setPredictionMargin sets how pessimistic the cost predictions are.
+     * @param deviations The number of mean deviations added to a task's average cost.
+     * @param unknownQuantile The quantile of all executions assumed for tasks without history.
+     */
+    void setPredictionMargin(float deviations, float unknownQuantile);
+
+    // @returns The budget for the frame that took __dt__ seconds, at most __maxRuntime__.
+    HighResolutionTime::Timestamp beginFrame(HighResolutionTime::Timestamp maxRuntime, float dt);
+    // Records the time actually spent during the frame.
+    void endFrame(HighResolutionTime::Timestamp used);
+
+    // Records the duration of one execution of __task__.
+    void record(Task* task, HighResolutionTime::Timestamp duration);
+    HighResolutionTime::Timestamp predict(const Task* task) const;
+    bool fits(const Task* task, HighResolutionTime::Timestamp remaining) const;
+
+    HighResolutionTime::Timestamp getBudget() const;
+    const RuntimeSketch& getSketch() const;
+private:
+    RuntimeSketch mSketch;
+    HighResolutionTime::Timestamp mMinBudget;
+    HighResolutionTime::Timestamp mMaxBudget;
+    HighResolutionTime::Timestamp mTargetFrameTime;
+    HighResolutionTime::Timestamp mBudget;
+    HighResolutionTime::Timestamp mFrameBudget;
+    HighResolutionTime::Timestamp mOvershoot;
+    float mDeviations;
+    float mUnknownQuantile;
+};
+
+END_NS_AILIB
+
+#endif // BUDGETCONTROLLER_H
@@ -0,0 +1,558 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "Task.h"
+#include "Blackboard.h"
+#include "HighResolutionTime.h"
+
+// Coroutine tasks require C++20. The rest of the library only requires C++11,
+// so this header is empty for older language versions.
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <new>
+
+BEGIN_NS_AILIB
+
+class CoroutineTask;
+
+/**
+ * @brief CoroutineFramePool provides the memory for coroutine frames.
+ *
+ * Frames up to MAX_POOLED_SIZE bytes are served from free lists of fixed size classes,
+ * which are refilled in chunks and never returned to the system. Coroutine tasks are
+ * typically created and destroyed at a high rate with only a handful of different frame
+ * sizes, so after a warm-up no further heap allocations occur.
+ */
+class CoroutineFramePool
+{
+public:
+    static const size_t SIZE_CLASS      = 64;
+    static const size_t MAX_POOLED_SIZE = 1024;
+    static const size_t BLOCKS_PER_CHUNK = 16;
+
+    static void* allocate(size_t size)
+    {
+        if(size > MAX_POOLED_SIZE)
+        {
+            return ::operator new(size);
+        }
+
+        CoroutineFramePool& pool = instance();
+        const size_t sizeClass = classOf(size);
+
+        std::lock_guard<std::mutex> guard(pool.mLock);
+        if(!pool.mFree[sizeClass])
+        {
+            pool.refill(sizeClass);
+        }
+
+        FreeBlock* block = pool.mFree[sizeClass];
+        pool.mFree[sizeClass] = block->next;
+        return block;
+    }
+
+    static void deallocate(void* ptr, size_t size)
+    {
+        if(size > MAX_POOLED_SIZE)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+
+        CoroutineFramePool& pool = instance();
+        const size_t sizeClass = classOf(size);
+
+        std::lock_guard<std::mutex> guard(pool.mLock);
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        block->next = pool.mFree[sizeClass];
+        pool.mFree[sizeClass] = block;
+    }
+private:
+    static const size_t NUM_CLASSES = MAX_POOLED_SIZE / SIZE_CLASS;
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct Chunk
+    {
+        Chunk* next;
+    };
+
+    CoroutineFramePool() :
+        mChunks(NULL)
+    {
+        for(size_t i = 0; i < NUM_CLASSES; ++i)
+        {
+            mFree[i] = NULL;
+        }
+    }
+
+    ~CoroutineFramePool()
+    {
+        while(mChunks)
+        {
+            Chunk* next = mChunks->next;
+            ::operator delete(mChunks);
+            mChunks = next;
+        }
+    }
+
+    static CoroutineFramePool& instance()
+    {
+        static CoroutineFramePool pool;
+        return pool;
+    }
+
+    static size_t classOf(size_t size)
+    {
+        return size == 0 ? 0 : (size - 1) / SIZE_CLASS;
+    }
+
+    void refill(size_t sizeClass)
+    {
+        const size_t blockSize = (sizeClass + 1) * SIZE_CLASS;
+
+        // The chunk header keeps the blocks aligned to the maximum fundamental alignment.
+        const size_t headerSize = alignof(std::max_align_t) > sizeof(Chunk) ?
+                                      alignof(std::max_align_t) : sizeof(Chunk);
+        char* memory = static_cast<char*>(::operator new(headerSize + blockSize * BLOCKS_PER_CHUNK));
+
+        Chunk* chunk = reinterpret_cast<Chunk*>(memory);
+        chunk->next = mChunks;
+        mChunks = chunk;
+
+        for(size_t i = 0; i < BLOCKS_PER_CHUNK; ++i)
+        {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(memory + headerSize + i * blockSize);
+            block->next = mFree[sizeClass];
+            mFree[sizeClass] = block;
+        }
+    }
+
+    std::mutex mLock;
+    FreeBlock* mFree[NUM_CLASSES];
+    Chunk* mChunks;
+};
+
+/**
+ * @brief Coroutine is the return type of coroutines that are executed by a CoroutineTask.
+ *
+ * @code
+ * Coroutine patrol(Agent& agent)
+ * {
+ *     for(;;)
+ *     {
+ *         agent.walkToNextWaypoint();
+ *         co_await sleepFor(HighResolutionTime::seconds(2.));
+ *     }
+ * }
+ *
+ * CoroutineTask task(patrol(agent));
+ * scheduler.enqueue(&task);
+ * @endcode
+ */
+class Coroutine
+{
+public:
+    class promise_type
+    {
+    public:
+        promise_type() :
+            task(NULL)
+        {
+            ;
+        }
+
+        Coroutine get_return_object()
+        {
+            return Coroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        // The body only starts when the task is run by a scheduler.
+        std::suspend_always initial_suspend() noexcept
+        {
+            return std::suspend_always();
+        }
+
+        // Keep the frame alive, so the task can observe completion.
+        std::suspend_always final_suspend() noexcept
+        {
+            return std::suspend_always();
+        }
+
+        void return_void()
+        {
+            ;
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+
+        static void* operator new(size_t size)
+        {
+            return CoroutineFramePool::allocate(size);
+        }
+
+        static void operator delete(void* ptr, size_t size)
+        {
+            CoroutineFramePool::deallocate(ptr, size);
+        }
+
+        CoroutineTask* task;
+    };
+
+    typedef std::coroutine_handle<promise_type> handle_type;
+
+    explicit Coroutine(handle_type handle) :
+        mHandle(handle)
+    {
+        ;
+    }
+
+    Coroutine(Coroutine&& other) :
+        mHandle(other.mHandle)
+    {
+        other.mHandle = handle_type();
+    }
+
+    ~Coroutine()
+    {
+        if(mHandle)
+        {
+            mHandle.destroy();
+        }
+    }
+
+    handle_type release()
+    {
+        handle_type handle = mHandle;
+        mHandle = handle_type();
+        return handle;
+    }
+private:
+    Coroutine(const Coroutine&);
+    Coroutine& operator=(const Coroutine&);
+
+    handle_type mHandle;
+};
+
+/**
+ * @brief CoroutineTask executes a Coroutine. Every run resumes the coroutine until its next
+ * co_await suspends it. The task terminates when the coroutine returns.
+ *
+ * The awaitables below decide the task's status while it is suspended: it keeps running
+ * (__yield__), sleeps in the scheduler's timer wheel (__sleepFor__, __sleepUntil__) or waits
+ * without being executed until an event wakes it (__waitFor__, __waitForChange__).
+ */
+class CoroutineTask : public Task
+{
+public:
+    explicit CoroutineTask(Coroutine&& coroutine) :
+        mHandle(coroutine.release()),
+        mAwaited(NULL),
+        mWaiters(NULL),
+        mNextWaiter(NULL)
+    {
+        setName("Coroutine");
+        AI_ASSERT(mHandle, "The coroutine was already moved into another task.");
+        mHandle.promise().task = this;
+    }
+
+    virtual ~CoroutineTask()
+    {
+        unlinkWaiter();
+        // Tasks that were terminated while waiting may still be linked.
+        while(mWaiters)
+        {
+            CoroutineTask* waiter = popWaiter();
+            AI_ASSERT(waiter->getStatus() != StatusWaiting,
+                      "Destroyed a coroutine task that other tasks are waiting for.");
+            UNUSED(waiter);
+        }
+        mHandle.destroy();
+    }
+
+    virtual void run()
+    {
+        AI_ASSERT(!mHandle.done(), "Ran a coroutine task that has already completed.");
+        mHandle.resume();
+
+        if(mHandle.done())
+        {
+            setStatus(StatusTerminated);
+            wakeWaiters();
+        }
+    }
+
+    bool isDone() const
+    {
+        return mHandle.done();
+    }
+
+    /**
+     * @brief terminate stops the task for good without completing the coroutine. The task
+     * stops waiting for another task, and the tasks waiting for this one are resumed.
+     * Tasks that are terminated otherwise (e.g. by Scheduler::clear) are unlinked when
+     * they are destroyed, and aren't resumed by the task they waited for.
+     */
+    void terminate()
+    {
+        unlinkWaiter();
+        setStatus(StatusTerminated);
+        wakeWaiters();
+    }
+private:
+    friend class WaitForTask;
+
+    CoroutineTask(const CoroutineTask&);
+    CoroutineTask& operator=(const CoroutineTask&);
+
+    void wakeWaiters()
+    {
+        while(mWaiters)
+        {
+            CoroutineTask* waiter = popWaiter();
+            // Don't revive waiters that were terminated in the meantime.
+            if(waiter->getStatus() == StatusWaiting)
+            {
+                waiter->setStatus(StatusRunning);
+            }
+        }
+    }
+
+    CoroutineTask* popWaiter()
+    {
+        CoroutineTask* waiter = mWaiters;
+        mWaiters = waiter->mNextWaiter;
+        waiter->mNextWaiter = NULL;
+        waiter->mAwaited = NULL;
+        return waiter;
+    }
+
+    void linkWaiter(CoroutineTask* awaited)
+    {
+        // A task that was resumed otherwise may still be linked to the task it waited for.
+        unlinkWaiter();
+        mAwaited = awaited;
+        mNextWaiter = awaited->mWaiters;
+        awaited->mWaiters = this;
+    }
+
+    // Removes the task from the waiters of the task it waits for, if any.
+    void unlinkWaiter()
+    {
+        if(!mAwaited)
+        {
+            return;
+        }
+
+        CoroutineTask** link = &mAwaited->mWaiters;
+        while(*link != this)
+        {
+            link = &(*link)->mNextWaiter;
+        }
+        *link = mNextWaiter;
+        mNextWaiter = NULL;
+        mAwaited = NULL;
+    }
+
+    Coroutine::handle_type mHandle;
+    // The task this task waits for.
+    CoroutineTask* mAwaited;
+    // Intrusive list of the tasks waiting for this task's completion.
+    CoroutineTask* mWaiters;
+    CoroutineTask* mNextWaiter;
+};
+
+// Suspends the coroutine until the next update.
+class Yield
+{
+public:
+    bool await_ready() const
+    {
+        return false;
+    }
+
+    void await_suspend(Coroutine::handle_type handle)
+    {
+        UNUSED(handle);
+    }
+
+    void await_resume()
+    {
+        ;
+    }
+};
+
+inline Yield yield()
+{
+    return Yield();
+}
+
+// Suspends the coroutine in the scheduler's timer wheel until __wakeTime__.
+class SleepUntil
+{
+public:
+    explicit SleepUntil(HighResolutionTime::Timestamp wakeTime) :
+        mWakeTime(wakeTime)
+    {
+        ;
+    }
+
+    bool await_ready() const
+    {
+        return false;
+    }
+
+    void await_suspend(Coroutine::handle_type handle)
+    {
+        handle.promise().task->sleepUntil(mWakeTime);
+    }
+
+    void await_resume()
+    {
+        ;
+    }
+private:
+    HighResolutionTime::Timestamp mWakeTime;
+};
+
+inline SleepUntil sleepUntil(HighResolutionTime::Timestamp wakeTime)
+{
+    return SleepUntil(wakeTime);
+}
+
+inline SleepUntil sleepFor(HighResolutionTime::Timestamp duration)
+{
+    return SleepUntil(HighResolutionTime::now() + duration);
+}
+
+/**
+ * @brief WaitForTask suspends the coroutine until another coroutine task completed.
+ * The waiting task isn't executed in the meantime. Both tasks must be executed by the
+ * same scheduler.
+ */
+class WaitForTask
+{
+public:
+    explicit WaitForTask(CoroutineTask& other) :
+        mOther(other)
+    {
+        ;
+    }
+
+    bool await_ready() const
+    {
+        return mOther.isDone();
+    }
+
+    void await_suspend(Coroutine::handle_type handle)
+    {
+        CoroutineTask* task = handle.promise().task;
+        AI_ASSERT(task != &mOther, "A task can't wait for itself.");
+
+        task->linkWaiter(&mOther);
+        task->setStatus(StatusWaiting);
+    }
+
+    void await_resume()
+    {
+        ;
+    }
+private:
+    CoroutineTask& mOther;
+};
+
+inline WaitForTask waitFor(CoroutineTask& other)
+{
+    return WaitForTask(other);
+}
+
+/**
+ * @brief WaitForChange suspends the coroutine until __key__ is set on __blackboard__.
+ * The waiting task isn't executed in the meantime. The blackboard must only be changed
+ * from the thread that executes the task.
+ */
+template <typename KEY>
+class WaitForChange : private BlackboardListener<KEY>
+{
+public:
+    WaitForChange(Blackboard<KEY>& blackboard, const KEY& key) :
+        mBlackboard(blackboard),
+        mKey(key),
+        mTask(NULL),
+        mHandle(INVALID_HANDLE)
+    {
+        ;
+    }
+
+    ~WaitForChange()
+    {
+        // The task was terminated while waiting.
+        unsubscribe();
+    }
+
+    bool await_ready() const
+    {
+        return false;
+    }
+
+    void await_suspend(Coroutine::handle_type handle)
+    {
+        mTask = handle.promise().task;
+        mHandle = mBlackboard.subscribe(mKey, this);
+        mTask->setStatus(StatusWaiting);
+    }
+
+    void await_resume()
+    {
+        unsubscribe();
+    }
+private:
+    virtual void onValueChanged(const KEY& key, const hold_any& value)
+    {
+        UNUSED(key);
+        UNUSED(value);
+        if(mTask && mTask->getStatus() == StatusWaiting)
+        {
+            mTask->setStatus(StatusRunning);
+        }
+    }
+
+    void unsubscribe()
+    {
+        if(mHandle != INVALID_HANDLE)
+        {
+            mBlackboard.removeListener(mHandle);
+            mHandle = INVALID_HANDLE;
+        }
+    }
+
+    Blackboard<KEY>& mBlackboard;
+    KEY mKey;
+    CoroutineTask* mTask;
+    Handle mHandle;
+};
+
+template <typename KEY>
+inline WaitForChange<KEY> waitForChange(Blackboard<KEY>& blackboard, const KEY& key)
+{
+    return WaitForChange<KEY>(blackboard, key);
+}
+
+END_NS_AILIB
+
+#endif // __cpp_impl_coroutine
+
+#endif // COROUTINE_H
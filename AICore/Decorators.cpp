@@ -0,0 +1,353 @@
+#include "Decorators.h"
+
+BEGIN_NS_AILIB
+
+namespace
+{
+
+// Runs __task__ again after __delay__. The scheduler wakes it, nothing polls.
+void resumeAfter(Task* task, HighResolutionTime::Timestamp delay)
+{
+    if(delay > 0)
+    {
+        task->sleepFor(delay);
+    }
+    else
+    {
+        task->setStatus(StatusRunning);
+    }
+}
+
+} // namespace
+
+Inverter::Inverter(Scheduler& scheduler, Behavior* child) :
+    Decorator(scheduler, child)
+{
+    setName("Inverter");
+}
+
+Inverter::~Inverter()
+{
+    ;
+}
+
+void Inverter::run()
+{
+    scheduleBehavior();
+    setStatus(StatusWaiting);
+}
+
+void Inverter::onSuccess(Behavior* behavior)
+{
+    UNUSED(behavior);
+    notifyFailure();
+}
+
+void Inverter::onFailure(Behavior* behavior)
+{
+    UNUSED(behavior);
+    notifySuccess();
+}
+
+Succeeder::Succeeder(Scheduler& scheduler, Behavior* child) :
+    Decorator(scheduler, child)
+{
+    setName("Succeeder");
+}
+
+Succeeder::~Succeeder()
+{
+    ;
+}
+
+void Succeeder::run()
+{
+    scheduleBehavior();
+    setStatus(StatusWaiting);
+}
+
+void Succeeder::onFailure(Behavior* behavior)
+{
+    UNUSED(behavior);
+    notifySuccess();
+}
+
+Timeout::Timeout(Scheduler& scheduler, Behavior* child, HighResolutionTime::Timestamp timeout) :
+    Decorator(scheduler, child),
+    mTimeout(timeout),
+    mExpiry(0)
+{
+    setName("Timeout");
+    AI_ASSERT(timeout > 0, "The timeout must be positive.");
+}
+
+Timeout::~Timeout()
+{
+    ;
+}
+
+void Timeout::run()
+{
+    // The timer woke the node before the child finished.
+    if(mExpiry != 0)
+    {
+        mExpiry = 0;
+        terminateChild();
+        notifyFailure();
+        return;
+    }
+
+    mExpiry = HighResolutionTime::now() + mTimeout;
+    scheduleBehavior();
+    // Sleep instead of waiting, so the node is woken when the child is overdue.
+    sleepUntil(mExpiry);
+}
+
+void Timeout::terminate()
+{
+    mExpiry = 0;
+    Decorator::terminate();
+}
+
+void Timeout::onSuccess(Behavior* behavior)
+{
+    UNUSED(behavior);
+    mExpiry = 0;
+    notifySuccess();
+}
+
+void Timeout::onFailure(Behavior* behavior)
+{
+    UNUSED(behavior);
+    mExpiry = 0;
+    notifyFailure();
+}
+
+void Timeout::onReset(Behavior* behavior)
+{
+    UNUSED(behavior);
+
+    // The child's new result has to arrive in time, too.
+    if(getStatus() == StatusDormant)
+    {
+        mExpiry = HighResolutionTime::now() + mTimeout;
+        sleepUntil(mExpiry);
+    }
+    notifyReset();
+}
+
+Cooldown::Cooldown(Scheduler& scheduler,
+                   Behavior* child,
+                   HighResolutionTime::Timestamp cooldown,
+                   LimitPolicy policy) :
+    Decorator(scheduler, child),
+    mCooldown(cooldown),
+    mPolicy(policy),
+    mReadyTime(0)
+{
+    setName("Cooldown");
+}
+
+Cooldown::~Cooldown()
+{
+    ;
+}
+
+void Cooldown::run()
+{
+    if(HighResolutionTime::now() < mReadyTime)
+    {
+        if(mPolicy == LimitWait)
+        {
+            sleepUntil(mReadyTime);
+        }
+        else
+        {
+            notifyFailure();
+        }
+        return;
+    }
+
+    scheduleBehavior();
+    setStatus(StatusWaiting);
+}
+
+void Cooldown::terminate()
+{
+    // Aborting the running child starts the cooldown, too.
+    if(getStatus() == StatusWaiting)
+    {
+        mReadyTime = HighResolutionTime::now() + mCooldown;
+    }
+    Decorator::terminate();
+}
+
+void Cooldown::onSuccess(Behavior* behavior)
+{
+    UNUSED(behavior);
+    mReadyTime = HighResolutionTime::now() + mCooldown;
+    notifySuccess();
+}
+
+void Cooldown::onFailure(Behavior* behavior)
+{
+    UNUSED(behavior);
+    mReadyTime = HighResolutionTime::now() + mCooldown;
+    notifyFailure();
+}
+
+HighResolutionTime::Timestamp Cooldown::getReadyTime() const
+{
+    return mReadyTime;
+}
+
+RateLimit::RateLimit(Scheduler& scheduler,
+                     Behavior* child,
+                     uint32_t count,
+                     HighResolutionTime::Timestamp period,
+                     LimitPolicy policy) :
+    Decorator(scheduler, child),
+    mPeriod(period),
+    mPolicy(policy),
+    // Runs that left the window before the node was created.
+    mStarts(count, -period),
+    mOldest(0)
+{
+    setName("RateLimit");
+    AI_ASSERT(count > 0, "The node must be allowed to run its child.");
+}
+
+RateLimit::~RateLimit()
+{
+    ;
+}
+
+void RateLimit::run()
+{
+    const HighResolutionTime::Timestamp now = HighResolutionTime::now();
+    const HighResolutionTime::Timestamp available = mStarts[mOldest] + mPeriod;
+    if(now < available)
+    {
+        if(mPolicy == LimitWait)
+        {
+            sleepUntil(available);
+        }
+        else
+        {
+            notifyFailure();
+        }
+        return;
+    }
+
+    // Replace the oldest run.
+    mStarts[mOldest] = now;
+    mOldest = (mOldest + 1) % mStarts.size();
+
+    scheduleBehavior();
+    setStatus(StatusWaiting);
+}
+
+Retry::Retry(Scheduler& scheduler,
+             Behavior* child,
+             uint32_t retries,
+             HighResolutionTime::Timestamp delay) :
+    Decorator(scheduler, child),
+    mRetries(retries),
+    mDelay(delay),
+    mAttempt(0)
+{
+    setName("Retry");
+}
+
+Retry::~Retry()
+{
+    ;
+}
+
+void Retry::run()
+{
+    scheduleBehavior();
+    setStatus(StatusWaiting);
+}
+
+void Retry::terminate()
+{
+    mAttempt = 0;
+    Decorator::terminate();
+}
+
+void Retry::onSuccess(Behavior* behavior)
+{
+    UNUSED(behavior);
+    mAttempt = 0;
+    notifySuccess();
+}
+
+void Retry::onFailure(Behavior* behavior)
+{
+    UNUSED(behavior);
+    if(mAttempt < mRetries)
+    {
+        // The child is still reporting. Restart it from run(), once it finished.
+        ++mAttempt;
+        resumeAfter(this, mDelay);
+    }
+    else
+    {
+        mAttempt = 0;
+        notifyFailure();
+    }
+}
+
+Repeat::Repeat(Scheduler& scheduler,
+               Behavior* child,
+               uint32_t count,
+               HighResolutionTime::Timestamp delay) :
+    Decorator(scheduler, child),
+    mCount(count),
+    mDelay(delay),
+    mIteration(0)
+{
+    setName("Repeat");
+}
+
+Repeat::~Repeat()
+{
+    ;
+}
+
+void Repeat::run()
+{
+    scheduleBehavior();
+    setStatus(StatusWaiting);
+}
+
+void Repeat::terminate()
+{
+    mIteration = 0;
+    Decorator::terminate();
+}
+
+void Repeat::onSuccess(Behavior* behavior)
+{
+    UNUSED(behavior);
+    if(mCount != REPEAT_FOREVER && ++mIteration >= mCount)
+    {
+        mIteration = 0;
+        notifySuccess();
+    }
+    else
+    {
+        // The child is still reporting. Restart it from run(), once it finished.
+        resumeAfter(this, mDelay);
+    }
+}
+
+void Repeat::onFailure(Behavior* behavior)
+{
+    UNUSED(behavior);
+    mIteration = 0;
+    notifyFailure();
+}
+
+END_NS_AILIB
@@ -0,0 +1,174 @@
+#ifndef DECORATORS_H
+#define DECORATORS_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "BehaviorTree.h"
+#include "HighResolutionTime.h"
+#include <vector>
+
+BEGIN_NS_AILIB
+
+/*
+ * Decorators that wait do so by sleeping in the scheduler's timer wheel (see Task::sleepUntil),
+ * never by polling, so a waiting decorator costs nothing until it is due. All times are in
+ * microseconds, see HighResolutionTime.
+ */
+
+// What a limiting decorator does when it is started while its child may not run.
+enum LimitPolicy
+{
+    // Fail immediately.
+    LimitFail = 0,
+    // Sleep until the child may run, then run it.
+    LimitWait
+};
+
+// Reports the opposite of the child's result.
+class Inverter : public Decorator
+{
+public:
+    Inverter(Scheduler& scheduler, Behavior* child);
+    virtual ~Inverter();
+
+    virtual void run();
+    virtual void onSuccess(Behavior* behavior);
+    virtual void onFailure(Behavior* behavior);
+};
+
+// Succeeds once the child finished, regardless of its result.
+class Succeeder : public Decorator
+{
+public:
+    Succeeder(Scheduler& scheduler, Behavior* child);
+    virtual ~Succeeder();
+
+    virtual void run();
+    virtual void onFailure(Behavior* behavior);
+};
+
+/**
+ * @brief Timeout fails and terminates its child if the child didn't finish within __timeout__
+ * of being started.
+ */
+class Timeout : public Decorator
+{
+public:
+    Timeout(Scheduler& scheduler, Behavior* child, HighResolutionTime::Timestamp timeout);
+    virtual ~Timeout();
+
+    virtual void run();
+    virtual void terminate();
+    virtual void onSuccess(Behavior* behavior);
+    virtual void onFailure(Behavior* behavior);
+    virtual void onReset(Behavior* behavior);
+private:
+    const HighResolutionTime::Timestamp mTimeout;
+    // When the running child times out, 0 if it isn't running.
+    HighResolutionTime::Timestamp mExpiry;
+};
+
+/**
+ * @brief Cooldown keeps its child from running again for __cooldown__ after it finished or was
+ * aborted. Depending on __policy__, starting the node during the cooldown fails or waits for
+ * the cooldown to end.
+ */
+class Cooldown : public Decorator
+{
+public:
+    Cooldown(Scheduler& scheduler,
+             Behavior* child,
+             HighResolutionTime::Timestamp cooldown,
+             LimitPolicy policy = LimitFail);
+    virtual ~Cooldown();
+
+    virtual void run();
+    virtual void terminate();
+    virtual void onSuccess(Behavior* behavior);
+    virtual void onFailure(Behavior* behavior);
+
+    // @returns The time at which the cooldown ends.
+    HighResolutionTime::Timestamp getReadyTime() const;
+private:
+    const HighResolutionTime::Timestamp mCooldown;
+    const LimitPolicy mPolicy;
+    HighResolutionTime::Timestamp mReadyTime;
+};
+
+/**
+ * @brief RateLimit runs its child at most __count__ times within any window of __period__.
+ * Depending on __policy__, starting the node beyond that fails or waits until the oldest
+ * run leaves the window.
+ */
+class RateLimit : public Decorator
+{
+public:
+    RateLimit(Scheduler& scheduler,
+              Behavior* child,
+              uint32_t count,
+              HighResolutionTime::Timestamp period,
+              LimitPolicy policy = LimitFail);
+    virtual ~RateLimit();
+
+    virtual void run();
+private:
+    const HighResolutionTime::Timestamp mPeriod;
+    const LimitPolicy mPolicy;
+    // The start times of the last runs, a ring buffer with the oldest at mOldest.
+    std::vector<HighResolutionTime::Timestamp> mStarts;
+    uint32_t mOldest;
+};
+
+/**
+ * @brief Retry restarts its child up to __retries__ times while it fails, after waiting for
+ * __delay__. Succeeds as soon as the child succeeds.
+ */
+class Retry : public Decorator
+{
+public:
+    Retry(Scheduler& scheduler,
+          Behavior* child,
+          uint32_t retries,
+          HighResolutionTime::Timestamp delay = 0);
+    virtual ~Retry();
+
+    virtual void run();
+    virtual void terminate();
+    virtual void onSuccess(Behavior* behavior);
+    virtual void onFailure(Behavior* behavior);
+private:
+    const uint32_t mRetries;
+    const HighResolutionTime::Timestamp mDelay;
+    uint32_t mAttempt;
+};
+
+/**
+ * @brief Repeat restarts its child __count__ times while it succeeds, waiting for __delay__
+ * between the runs. Succeeds after the last run, fails as soon as the child fails.
+ * A __count__ of REPEAT_FOREVER repeats until the child fails or the node is terminated.
+ */
+class Repeat : public Decorator
+{
+public:
+    static const uint32_t REPEAT_FOREVER = 0;
+
+    Repeat(Scheduler& scheduler,
+           Behavior* child,
+           uint32_t count = REPEAT_FOREVER,
+           HighResolutionTime::Timestamp delay = 0);
+    virtual ~Repeat();
+
+    virtual void run();
+    virtual void terminate();
+    virtual void onSuccess(Behavior* behavior);
+    virtual void onFailure(Behavior* behavior);
+private:
+    const uint32_t mCount;
+    const HighResolutionTime::Timestamp mDelay;
+    uint32_t mIteration;
+};
+
+END_NS_AILIB
+
+#endif // DECORATORS_H
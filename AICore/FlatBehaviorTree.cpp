@@ -0,0 +1,527 @@
+#include "FlatBehaviorTree.h"
+#include "HighResolutionTime.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+
+BEGIN_NS_AILIB
+
+TreeAction::~TreeAction()
+{
+    ;
+}
+
+void TreeAction::abort(BehaviorTreeInstance& instance)
+{
+    UNUSED(instance);
+}
+
+BehaviorAction::BehaviorAction(uint32_t leafSlot) :
+    mLeafSlot(leafSlot)
+{
+    ;
+}
+
+BehaviorResult BehaviorAction::execute(BehaviorTreeInstance& instance)
+{
+    Behavior* behavior = instance.getLeaf(mLeafSlot);
+    AI_ASSERT(behavior, "The instance has no behavior for this leaf slot.");
+
+    uint8_t& result = instance.mLeaves->results[mLeafSlot];
+    if(result == ResultRunning)
+    {
+        switch(behavior->getStatus())
+        {
+        case StatusDormant:
+        case StatusTerminated:
+            // Start a new activation.
+            behavior->setListener(instance.mLeaves);
+            behavior->setStatus(StatusRunning);
+            behavior->run();
+            break;
+        case StatusRunning:
+            behavior->run();
+            break;
+        case StatusSleeping:
+            if(behavior->getWakeTime() <= HighResolutionTime::now())
+            {
+                behavior->setStatus(StatusRunning);
+                behavior->run();
+            }
+            break;
+        case StatusWaiting:
+            // Woken by someone else setting its status to running.
+            break;
+        }
+    }
+
+    // The behavior reports its result through the instance, possibly between ticks.
+    const BehaviorResult finished = static_cast<BehaviorResult>(result);
+    result = ResultRunning;
+    return finished;
+}
+
+void BehaviorAction::abort(BehaviorTreeInstance& instance)
+{
+    Behavior* behavior = instance.getLeaf(mLeafSlot);
+    if(behavior->getStatus() != StatusDormant && behavior->getStatus() != StatusTerminated)
+    {
+        behavior->terminate();
+    }
+    instance.mLeaves->results[mLeafSlot] = ResultRunning;
+}
+
+BehaviorTreeDefinition::BehaviorTreeDefinition() :
+    mNumCursors(0)
+{
+    ;
+}
+
+void BehaviorTreeDefinition::beginSequence()
+{
+    addNode(NodeSequence, NULL);
+}
+
+void BehaviorTreeDefinition::beginSelector()
+{
+    addNode(NodeSelector, NULL);
+}
+
+void BehaviorTreeDefinition::beginParallel()
+{
+    addNode(NodeParallel, NULL);
+}
+
+void BehaviorTreeDefinition::action(TreeAction* action)
+{
+    AI_ASSERT(action, "Actions may not be NULL.");
+    addNode(NodeAction, action);
+}
+
+void BehaviorTreeDefinition::end()
+{
+    AI_ASSERT(!mOpen.empty(), "There is no open composite to end.");
+    AI_ASSERT(mNodes.size() - mOpen.back() <= std::numeric_limits<uint16_t>::max(),
+              "Composites are limited to subtrees of 65535 nodes.");
+    mNodes[mOpen.back()].end = static_cast<uint32_t>(mNodes.size());
+    mOpen.pop_back();
+}
+
+bool BehaviorTreeDefinition::isComplete() const
+{
+    return !mNodes.empty() && mOpen.empty();
+}
+
+uint32_t BehaviorTreeDefinition::getNumNodes() const
+{
+    return static_cast<uint32_t>(mNodes.size());
+}
+
+size_t BehaviorTreeDefinition::getStateSize() const
+{
+    // Cursors first, to keep them aligned.
+    return mNumCursors * sizeof(uint16_t) + (mNodes.size() + 3) / 4;
+}
+
+void BehaviorTreeDefinition::addNode(NodeType type, TreeAction* action)
+{
+    AI_ASSERT(mNodes.empty() || !mOpen.empty(), "A tree can only have a single root.");
+
+    Node node;
+    node.type = static_cast<uint8_t>(type);
+    node.cursor = 0;
+    node.end = static_cast<uint32_t>(mNodes.size() + 1);
+    node.action = action;
+    if(type == NodeSequence || type == NodeSelector)
+    {
+        AI_ASSERT(mNumCursors < std::numeric_limits<uint16_t>::max(), "Too many composites.");
+        node.cursor = static_cast<uint16_t>(mNumCursors++);
+    }
+    mNodes.push_back(node);
+
+    if(type != NodeAction)
+    {
+        mOpen.push_back(static_cast<uint32_t>(mNodes.size() - 1));
+    }
+}
+
+BehaviorResult BehaviorTreeDefinition::tick(BehaviorTreeInstance& instance) const
+{
+    AI_ASSERT(isComplete(), "Tried to tick an incomplete tree.");
+    AI_ASSERT(&instance.getDefinition() == this, "The instance executes another definition.");
+
+    const BehaviorResult result = tickNode(0, instance);
+    instance.mLastResult = static_cast<uint8_t>(result);
+    return result;
+}
+
+void BehaviorTreeDefinition::tick(BehaviorTreeInstance* const* instances, size_t count) const
+{
+    for(size_t i = 0; i < count; ++i)
+    {
+        tick(*instances[i]);
+    }
+}
+
+void BehaviorTreeDefinition::abort(BehaviorTreeInstance& instance) const
+{
+    abortNode(0, instance);
+}
+
+BehaviorResult BehaviorTreeDefinition::tickNode(uint32_t idx, BehaviorTreeInstance& instance) const
+{
+    const Node& node = mNodes[idx];
+    BehaviorResult result;
+
+    switch(node.type)
+    {
+    case NodeAction:
+        result = node.action->execute(instance);
+        break;
+    case NodeSequence:
+        result = tickSequential(idx, instance, ResultSuccess);
+        break;
+    case NodeSelector:
+        result = tickSequential(idx, instance, ResultFailure);
+        break;
+    case NodeParallel:
+    default:
+        result = tickParallel(idx, instance);
+        break;
+    }
+
+    instance.setState(idx, result == ResultRunning ? BehaviorTreeInstance::StateRunning :
+                                                     BehaviorTreeInstance::StateIdle);
+    return result;
+}
+
+BehaviorResult BehaviorTreeDefinition::tickSequential(uint32_t idx,
+                                                      BehaviorTreeInstance& instance,
+                                                      BehaviorResult continueOn) const
+{
+    const Node& node = mNodes[idx];
+    const uint32_t end = node.end;
+
+    // Resume at the running child, or start with the first one.
+    uint32_t child = instance.getState(idx) == BehaviorTreeInstance::StateRunning ?
+                         instance.getCursor(idx, node) : idx + 1;
+
+    while(child < end)
+    {
+        const BehaviorResult result = tickNode(child, instance);
+        if(result == ResultRunning)
+        {
+            instance.setCursor(idx, node, child);
+            return ResultRunning;
+        }
+
+        if(result != continueOn)
+        {
+            return result;
+        }
+        child = mNodes[child].end;
+    }
+
+    // All children succeeded (sequence) or failed (selector). Empty composites succeed.
+    return end == idx + 1 ? ResultSuccess : continueOn;
+}
+
+BehaviorResult BehaviorTreeDefinition::tickParallel(uint32_t idx,
+                                                    BehaviorTreeInstance& instance) const
+{
+    const uint32_t end = mNodes[idx].end;
+
+    bool allSucceeded = true;
+    for(uint32_t child = idx + 1; child < end; child = mNodes[child].end)
+    {
+        if(instance.getState(child) == BehaviorTreeInstance::StateSucceeded)
+        {
+            continue;
+        }
+
+        const BehaviorResult result = tickNode(child, instance);
+        if(result == ResultFailure)
+        {
+            // End the remaining children and fail immediately.
+            resetChildren(idx, instance);
+            return ResultFailure;
+        }
+
+        if(result == ResultSuccess)
+        {
+            instance.setState(child, BehaviorTreeInstance::StateSucceeded);
+        }
+        else
+        {
+            allSucceeded = false;
+        }
+    }
+
+    if(allSucceeded)
+    {
+        resetChildren(idx, instance);
+        return ResultSuccess;
+    }
+    return ResultRunning;
+}
+
+void BehaviorTreeDefinition::abortNode(uint32_t idx, BehaviorTreeInstance& instance) const
+{
+    if(instance.getState(idx) != BehaviorTreeInstance::StateRunning)
+    {
+        instance.setState(idx, BehaviorTreeInstance::StateIdle);
+        return;
+    }
+
+    const Node& node = mNodes[idx];
+    switch(node.type)
+    {
+    case NodeAction:
+        node.action->abort(instance);
+        break;
+    case NodeSequence:
+    case NodeSelector:
+        abortNode(instance.getCursor(idx, node), instance);
+        break;
+    case NodeParallel:
+    default:
+        resetChildren(idx, instance);
+        break;
+    }
+    instance.setState(idx, BehaviorTreeInstance::StateIdle);
+}
+
+void BehaviorTreeDefinition::resetChildren(uint32_t idx, BehaviorTreeInstance& instance) const
+{
+    for(uint32_t child = idx + 1; child < mNodes[idx].end; child = mNodes[child].end)
+    {
+        abortNode(child, instance);
+    }
+}
+
+BehaviorTreeInstance::BehaviorTreeInstance(const BehaviorTreeDefinition& definition,
+                                           void* context) :
+    mDefinition(&definition),
+    mContext(context),
+    mCursors(NULL),
+    mState(NULL),
+    mLeaves(NULL),
+    mLastResult(ResultRunning),
+    mOwnsState(true)
+{
+    AI_ASSERT(definition.isComplete(), "Instances require a complete definition.");
+
+    // uint16_t elements keep the cursors aligned.
+    const size_t size = definition.getStateSize();
+    uint16_t* state = new uint16_t[(size + 1) / 2]();
+    mCursors = state;
+    mState = reinterpret_cast<uint8_t*>(state) + definition.mNumCursors * sizeof(uint16_t);
+}
+
+BehaviorTreeInstance::BehaviorTreeInstance(const BehaviorTreeDefinition& definition,
+                                           void* context,
+                                           uint8_t* state) :
+    mDefinition(&definition),
+    mContext(context),
+    mCursors(reinterpret_cast<uint16_t*>(state)),
+    mState(state + definition.mNumCursors * sizeof(uint16_t)),
+    mLeaves(NULL),
+    mLastResult(ResultRunning),
+    mOwnsState(false)
+{
+    AI_ASSERT(definition.isComplete(), "Instances require a complete definition.");
+    std::memset(state, 0, definition.getStateSize());
+}
+
+BehaviorTreeInstance::~BehaviorTreeInstance()
+{
+    delete mLeaves;
+    if(mOwnsState)
+    {
+        delete[] mCursors;
+    }
+}
+
+const BehaviorTreeDefinition& BehaviorTreeInstance::getDefinition() const
+{
+    return *mDefinition;
+}
+
+void* BehaviorTreeInstance::getContext() const
+{
+    return mContext;
+}
+
+void BehaviorTreeInstance::setLeaf(uint32_t slot, Behavior* behavior)
+{
+    if(!mLeaves)
+    {
+        mLeaves = new Leaves();
+    }
+
+    if(slot >= mLeaves->behaviors.size())
+    {
+        mLeaves->behaviors.resize(slot + 1, NULL);
+        mLeaves->results.resize(slot + 1, ResultRunning);
+    }
+    mLeaves->behaviors[slot] = behavior;
+    mLeaves->results[slot] = ResultRunning;
+}
+
+Behavior* BehaviorTreeInstance::getLeaf(uint32_t slot) const
+{
+    return mLeaves && slot < mLeaves->behaviors.size() ? mLeaves->behaviors[slot] : NULL;
+}
+
+BehaviorResult BehaviorTreeInstance::getLastResult() const
+{
+    return static_cast<BehaviorResult>(mLastResult);
+}
+
+BehaviorTreeInstance::Leaves::~Leaves()
+{
+    for(std::vector<Behavior*>::iterator it = behaviors.begin(); it != behaviors.end(); ++it)
+    {
+        if(*it)
+        {
+            (*it)->setListener(static_cast<BehaviorListener*>(NULL));
+        }
+    }
+}
+
+void BehaviorTreeInstance::Leaves::onSuccess(Behavior* behavior)
+{
+    setResult(behavior, ResultSuccess);
+}
+
+void BehaviorTreeInstance::Leaves::onFailure(Behavior* behavior)
+{
+    setResult(behavior, ResultFailure);
+}
+
+void BehaviorTreeInstance::Leaves::setResult(Behavior* behavior, BehaviorResult result)
+{
+    std::vector<Behavior*>::const_iterator it = std::find(behaviors.begin(), behaviors.end(), behavior);
+    AI_ASSERT(it != behaviors.end(), "Received a result from an unknown behavior.");
+    results[it - behaviors.begin()] = static_cast<uint8_t>(result);
+}
+
+BehaviorTreeInstancePool::BehaviorTreeInstancePool(const BehaviorTreeDefinition& definition,
+                                                   uint32_t instancesPerChunk) :
+    mDefinition(definition),
+    mInstancesPerChunk(instancesPerChunk),
+    mSize(0)
+{
+    AI_ASSERT(instancesPerChunk > 0, "Chunks must hold at least one instance.");
+
+    // The state directly follows the instance. Round up to keep the next slot aligned.
+    const size_t alignment = std::max(sizeof(void*), sizeof(uint16_t));
+    mSlotSize = sizeof(BehaviorTreeInstance) + definition.getStateSize();
+    mSlotSize = (mSlotSize + alignment - 1) / alignment * alignment;
+}
+
+BehaviorTreeInstancePool::~BehaviorTreeInstancePool()
+{
+    AI_ASSERT(mSize == 0, "Destroyed a pool that still owns instances.");
+    for(std::vector<char*>::iterator it = mChunks.begin(); it != mChunks.end(); ++it)
+    {
+        delete[] *it;
+    }
+}
+
+BehaviorTreeInstance* BehaviorTreeInstancePool::create(void* context)
+{
+    if(mFree.empty())
+    {
+        grow();
+    }
+
+    char* slot = mFree.back();
+    mFree.pop_back();
+    ++mSize;
+
+    uint8_t* state = reinterpret_cast<uint8_t*>(slot + sizeof(BehaviorTreeInstance));
+    return new (slot) BehaviorTreeInstance(mDefinition, context, state);
+}
+
+void BehaviorTreeInstancePool::destroy(BehaviorTreeInstance* instance)
+{
+    if(!instance)
+    {
+        return;
+    }
+
+    AI_ASSERT(mSize > 0, "Destroyed an instance that wasn't created by this pool.");
+    instance->~BehaviorTreeInstance();
+    mFree.push_back(reinterpret_cast<char*>(instance));
+    --mSize;
+}
+
+size_t BehaviorTreeInstancePool::size() const
+{
+    return mSize;
+}
+
+size_t BehaviorTreeInstancePool::getSlotSize() const
+{
+    return mSlotSize;
+}
+
+void BehaviorTreeInstancePool::grow()
+{
+    // operator new[] returns memory aligned for any fundamental type.
+    char* chunk = new char[mSlotSize * mInstancesPerChunk];
+    mChunks.push_back(chunk);
+
+    mFree.reserve(mChunks.size() * mInstancesPerChunk);
+    for(uint32_t i = mInstancesPerChunk; i > 0; --i)
+    {
+        mFree.push_back(chunk + (i - 1) * mSlotSize);
+    }
+}
+
+BehaviorTreeBatch::BehaviorTreeBatch(const BehaviorTreeDefinition& definition) :
+    mDefinition(definition)
+{
+    setName("BehaviorTreeBatch");
+}
+
+BehaviorTreeBatch::~BehaviorTreeBatch()
+{
+    ;
+}
+
+void BehaviorTreeBatch::add(BehaviorTreeInstance* instance)
+{
+    AI_ASSERT(instance && &instance->getDefinition() == &mDefinition,
+              "The instance executes another definition.");
+    mInstances.push_back(instance);
+}
+
+void BehaviorTreeBatch::remove(BehaviorTreeInstance* instance)
+{
+    std::vector<BehaviorTreeInstance*>::iterator it = std::find(mInstances.begin(),
+                                                                mInstances.end(),
+                                                                instance);
+    AI_ASSERT(it != mInstances.end(), "Tried to remove an instance that isn't part of the batch.");
+
+    // The order of the agents doesn't matter.
+    *it = mInstances.back();
+    mInstances.pop_back();
+}
+
+size_t BehaviorTreeBatch::size() const
+{
+    return mInstances.size();
+}
+
+void BehaviorTreeBatch::run()
+{
+    if(!mInstances.empty())
+    {
+        mDefinition.tick(&mInstances[0], mInstances.size());
+    }
+}
+
+END_NS_AILIB
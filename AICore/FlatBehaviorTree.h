@@ -0,0 +1,305 @@
+#ifndef FLATBEHAVIORTREE_H
+#define FLATBEHAVIORTREE_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "BehaviorTree.h"
+#include "Task.h"
+#include <vector>
+
+BEGIN_NS_AILIB
+
+class BehaviorTreeInstance;
+
+enum BehaviorResult
+{
+    ResultRunning = 0,
+    ResultSuccess,
+    ResultFailure
+};
+
+/**
+ * @brief TreeAction is a leaf of a BehaviorTreeDefinition. A single action object serves
+ * all agents executing the definition, per-agent data must be kept in the instance.
+ */
+class TreeAction
+{
+public:
+    virtual ~TreeAction();
+
+    // Called on every tick while the action is running.
+    virtual BehaviorResult execute(BehaviorTreeInstance& instance) = 0;
+    // Called when a running action is interrupted by its parent.
+    virtual void abort(BehaviorTreeInstance& instance);
+};
+
+/**
+ * @brief BehaviorAction executes an existing leaf Behavior from a BehaviorTreeDefinition.
+ * Every instance provides its own behavior object for the slot __leafSlot__
+ * (see BehaviorTreeInstance::setLeaf). The behavior is run directly instead of through a
+ * scheduler. While it waits, or sleeps until its wake time, the action keeps running
+ * without executing it.
+ */
+class BehaviorAction : public TreeAction
+{
+public:
+    explicit BehaviorAction(uint32_t leafSlot);
+
+    virtual BehaviorResult execute(BehaviorTreeInstance& instance);
+    virtual void abort(BehaviorTreeInstance& instance);
+private:
+    uint32_t mLeafSlot;
+};
+
+/**
+ * @brief BehaviorTreeDefinition is a compiled behavior tree: an immutable array of nodes
+ * in depth-first order that is shared by all agents executing the tree.
+ *
+ * The children of a composite node directly follow it. Every node stores the index one past
+ * its subtree, so siblings are found by skipping subtrees and the interpreter walks the array
+ * front to back without chasing pointers. All per-agent state lives in BehaviorTreeInstances.
+ *
+ * Trees are built in depth-first order:
+ * @code
+ * definition.beginSelector();
+ *     definition.beginSequence();
+ *         definition.action(&canSeeEnemy);
+ *         definition.action(&attack);
+ *     definition.end();
+ *     definition.action(&patrol);
+ * definition.end();
+ * @endcode
+ */
+class BehaviorTreeDefinition
+{
+public:
+    enum NodeType
+    {
+        NodeAction = 0,
+        // Runs its children in order until one fails.
+        NodeSequence,
+        // Runs its children in order until one succeeds.
+        NodeSelector,
+        // Runs all children at once. Succeeds once all children succeeded,
+        // fails as soon as one child fails.
+        NodeParallel
+    };
+
+    class Node
+    {
+    public:
+        uint8_t type;
+        // Index of the resume cursor of sequences and selectors in the instance state.
+        uint16_t cursor;
+        // Index one past the last node of this node's subtree.
+        uint32_t end;
+        // The action of action nodes, NULL otherwise.
+        TreeAction* action;
+    };
+
+    BehaviorTreeDefinition();
+
+    // The actions must outlive the definition.
+    void beginSequence();
+    void beginSelector();
+    void beginParallel();
+    void action(TreeAction* action);
+    // Closes the innermost open composite.
+    void end();
+
+    // @returns true if the tree has a root and all composites were closed.
+    bool isComplete() const;
+
+    FORCE_INLINE const Node& getNode(uint32_t idx) const
+    {
+        return mNodes[idx];
+    }
+
+    uint32_t getNumNodes() const;
+
+    /**
+     * @brief getStateSize returns the number of bytes of per-agent state. Every node takes
+     * 2 bits, sequences and selectors additionally 2 bytes for the child they resume at.
+     */
+    size_t getStateSize() const;
+
+    /**
+     * @brief tick executes the tree of __instance__ once. Running nodes are resumed,
+     * finished trees start over.
+     * @return The result of the root node.
+     */
+    BehaviorResult tick(BehaviorTreeInstance& instance) const;
+
+    // Ticks the trees of __count__ agents in a batch.
+    void tick(BehaviorTreeInstance* const* instances, size_t count) const;
+
+    // Interrupts all running nodes of __instance__, so the tree starts over on the next tick.
+    void abort(BehaviorTreeInstance& instance) const;
+private:
+    friend class BehaviorTreeInstance;
+
+    void addNode(NodeType type, TreeAction* action);
+
+    BehaviorResult tickNode(uint32_t idx, BehaviorTreeInstance& instance) const;
+    BehaviorResult tickSequential(uint32_t idx, BehaviorTreeInstance& instance,
+                                  BehaviorResult continueOn) const;
+    BehaviorResult tickParallel(uint32_t idx, BehaviorTreeInstance& instance) const;
+    void abortNode(uint32_t idx, BehaviorTreeInstance& instance) const;
+    void resetChildren(uint32_t idx, BehaviorTreeInstance& instance) const;
+
+    std::vector<Node> mNodes;
+    std::vector<uint32_t> mOpen;
+    uint32_t mNumCursors;
+};
+
+/**
+ * @brief BehaviorTreeInstance is the state of one agent executing a BehaviorTreeDefinition.
+ *
+ * The run state of all nodes is packed into a single block of
+ * BehaviorTreeDefinition::getStateSize bytes, so an agent costs a few dozen bytes no matter
+ * how many agents share the definition. Instances either allocate the block themselves or
+ * are created by a BehaviorTreeInstancePool, which stores it next to the instance.
+ */
+class BehaviorTreeInstance
+{
+public:
+    explicit BehaviorTreeInstance(const BehaviorTreeDefinition& definition,
+                                  void* context = NULL);
+    ~BehaviorTreeInstance();
+
+    const BehaviorTreeDefinition& getDefinition() const;
+
+    // The agent's data, available to the actions.
+    void* getContext() const;
+
+    // Assigns the agent's behavior object to the BehaviorAction leaf slot __slot__.
+    void setLeaf(uint32_t slot, Behavior* behavior);
+    Behavior* getLeaf(uint32_t slot) const;
+
+    BehaviorResult getLastResult() const;
+private:
+    friend class BehaviorTreeDefinition;
+    friend class BehaviorAction;
+    friend class BehaviorTreeInstancePool;
+
+    BehaviorTreeInstance(const BehaviorTreeDefinition& definition,
+                         void* context,
+                         uint8_t* state);
+    BehaviorTreeInstance(const BehaviorTreeInstance&);
+    BehaviorTreeInstance& operator=(const BehaviorTreeInstance&);
+
+    // Node states, 2 bits each.
+    enum NodeState
+    {
+        StateIdle = 0,
+        StateRunning,
+        // The node finished during the current activation of its parallel parent.
+        StateSucceeded,
+        StateFailed
+    };
+
+    // The behavior objects of BehaviorAction leaves. Only allocated for agents that use them.
+    class Leaves : public BehaviorListener
+    {
+    public:
+        virtual ~Leaves();
+        virtual void onSuccess(Behavior* behavior);
+        virtual void onFailure(Behavior* behavior);
+        void setResult(Behavior* behavior, BehaviorResult result);
+
+        std::vector<Behavior*> behaviors;
+        // Results reported by the behaviors, consumed by their BehaviorAction.
+        std::vector<uint8_t> results;
+    };
+
+    FORCE_INLINE uint8_t getState(uint32_t node) const
+    {
+        return (mState[node >> 2] >> ((node & 3) * 2)) & 3;
+    }
+
+    FORCE_INLINE void setState(uint32_t node, uint8_t state)
+    {
+        uint8_t& packed = mState[node >> 2];
+        const uint32_t shift = (node & 3) * 2;
+        packed = static_cast<uint8_t>((packed & ~(3 << shift)) | (state << shift));
+    }
+
+    // Cursors are stored as the offset of the child from its parent.
+    FORCE_INLINE uint32_t getCursor(uint32_t node, const BehaviorTreeDefinition::Node& data) const
+    {
+        return node + mCursors[data.cursor];
+    }
+
+    FORCE_INLINE void setCursor(uint32_t node, const BehaviorTreeDefinition::Node& data,
+                                uint32_t child)
+    {
+        mCursors[data.cursor] = static_cast<uint16_t>(child - node);
+    }
+
+    const BehaviorTreeDefinition* mDefinition;
+    void* mContext;
+    uint16_t* mCursors;
+    uint8_t* mState;
+    Leaves* mLeaves;
+    uint8_t mLastResult;
+    bool mOwnsState;
+};
+
+/**
+ * @brief BehaviorTreeInstancePool creates instances of one definition together with their
+ * state in fixed-size slots. Slots are recycled, so spawning agents doesn't allocate once
+ * the pool has grown to its working size. Not thread-safe.
+ */
+class BehaviorTreeInstancePool
+{
+public:
+    explicit BehaviorTreeInstancePool(const BehaviorTreeDefinition& definition,
+                                      uint32_t instancesPerChunk = 256);
+    ~BehaviorTreeInstancePool();
+
+    BehaviorTreeInstance* create(void* context = NULL);
+    void destroy(BehaviorTreeInstance* instance);
+
+    // @returns The number of live instances.
+    size_t size() const;
+    // @returns The number of bytes each instance occupies, including its state.
+    size_t getSlotSize() const;
+private:
+    BehaviorTreeInstancePool(const BehaviorTreeInstancePool&);
+    BehaviorTreeInstancePool& operator=(const BehaviorTreeInstancePool&);
+
+    void grow();
+
+    const BehaviorTreeDefinition& mDefinition;
+    const uint32_t mInstancesPerChunk;
+    size_t mSlotSize;
+    std::vector<char*> mChunks;
+    std::vector<char*> mFree;
+    size_t mSize;
+};
+
+/**
+ * @brief BehaviorTreeBatch is a task that ticks the behavior trees of many agents sharing
+ * a definition once per run.
+ */
+class BehaviorTreeBatch : public Task
+{
+public:
+    explicit BehaviorTreeBatch(const BehaviorTreeDefinition& definition);
+    virtual ~BehaviorTreeBatch();
+
+    // __instance__ must execute the batch's definition.
+    void add(BehaviorTreeInstance* instance);
+    void remove(BehaviorTreeInstance* instance);
+    size_t size() const;
+
+    virtual void run();
+private:
+    const BehaviorTreeDefinition& mDefinition;
+    std::vector<BehaviorTreeInstance*> mInstances;
+};
+
+END_NS_AILIB
+
+#endif // FLATBEHAVIORTREE_H
@@ -2,9 +2,9 @@
 #define GENETIC_H
 
 #include "ai_global.h"
+#include "Random.h"
 #include <vector>
 #include <sparsehash/sparse_hash_map>
-#include <cstdlib>
 #include <cmath>
 
 BEGIN_NS_AILIB
@@ -21,7 +21,8 @@ struct Hash;
 /**
  * @brief The Genetic class implements a Genetic Algorithm with crossover, mutation and elitism.
  * The problem-specific crossover, mutation, generator and fitness functions must be supplied
- * by the user.
+ * by the user. Selections are drawn from __random__, so runs with equally seeded generators
+ * are reproducible.
  */
 template <typename T, typename HASH_FUN = Hash<T> >
 class Genetic
@@ -74,14 +75,16 @@ public:
             CrossoverFunction cf,
             MutationFunction mf,
             GeneratorFunction gf,
-            uint32_t populationSize) :
+            uint32_t populationSize,
+            const Random& random = Random::unique()) :
         mListener(NULL),
         mPopulation(populationSize),
         mBacking(populationSize),
         mFitness(ff),
         mCrossover(cf),
         mMutation(mf),
-        mGenerator(gf)
+        mGenerator(gf),
+        mRandom(random)
     {
         ;
     }
@@ -91,6 +94,11 @@ public:
         mListener = listener;
     }
 
+    Random& getRandom()
+    {
+        return mRandom;
+    }
+
     void generatePopulation()
     {
         for(size_t i = 0; i < mPopulation.size(); ++i)
@@ -130,7 +138,7 @@ public:
                 uint32_t second = 0;
                 do
                 {
-                    second = randRangeExp(0, mPopulation.size(), 0.4);
+                    second = randRangeExp(0, mPopulation.size() - 1, 0.4);
                 } while(first == second);
 
                 mPopulation[i] = mCrossover(mBacking[first], mBacking[second]);
@@ -158,28 +166,29 @@ public:
 
 private:
     /**
-     * Returns a random number between 0.0 and 1.0.
-     * Uses __rand()__ - seed with __srand()__ to be able to reproduce results.
+     * Returns a random number between 0.0 (inclusive) and 1.0 (exclusive).
+     * Seed the generator (see getRandom()) to be able to reproduce results.
      */
-    FORCE_INLINE real_type randNum() const
+    FORCE_INLINE real_type randNum()
     {
-        return static_cast<float>(rand()) / RAND_MAX;
+        return mRandom.nextFloat();
     }
 
     /**
       Calculates a random integer within the range of low and high (inclusive).
       Uniformly distributed.
       */
-    FORCE_INLINE uint32_t randRange(uint32_t low, uint32_t high) const
+    FORCE_INLINE uint32_t randRange(uint32_t low, uint32_t high)
     {
-        return low + randNum() * (high - low);
+        AI_ASSERT(low <= high && high - low < 0xFFFFFFFF, "Invalid range.");
+        return low + mRandom.nextBelow(high - low + 1);
     }
 
     /**
       Calculates a random integer within the range of low and high (inclusive).
       Exponentially distributed with a parameter mu.
       */
-    uint32_t randRangeExp(uint32_t low, uint32_t high, real_type mu) const
+    uint32_t randRangeExp(uint32_t low, uint32_t high, real_type mu)
     {
         const real_type lowExp = expf(-mu*low);
         const real_type val = (-1./mu) * logf( lowExp - randNum() * (lowExp - expf(-mu*high)) );
@@ -193,6 +202,7 @@ private:
     CrossoverFunction mCrossover;
     MutationFunction mMutation;
     GeneratorFunction mGenerator;
+    Random mRandom;
 };
 
 END_NS_AILIB
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "ai_global.h"
+#include <stddef.h>
 #include <stdint.h>
 #include <vector>
 
@@ -0,0 +1,757 @@
+#include "NavMesh.h"
+#include <LinearMath/btHashMap.h>
+#include <LinearMath/btMinMax.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+BEGIN_NS_AILIB
+
+namespace
+{
+    const btScalar sAreaEpsilon = btScalar(1e-6);
+
+    // Twice the signed area of the triangle (a, b, c) projected onto the XZ plane.
+    // Positive if c lies left of the directed line a -> b.
+    FORCE_INLINE btScalar area2(const btVector3& a, const btVector3& b, const btVector3& c)
+    {
+        return (b.x() - a.x()) * (c.z() - a.z()) - (c.x() - a.x()) * (b.z() - a.z());
+    }
+
+    FORCE_INLINE bool equals2(const btVector3& a, const btVector3& b)
+    {
+        const btScalar dx = a.x() - b.x();
+        const btScalar dz = a.z() - b.z();
+        return dx*dx + dz*dz < sAreaEpsilon * sAreaEpsilon;
+    }
+
+    // Adapter class to enable the use of quantized positions as keys in btHashMap.
+    class HashCell
+    {
+    public:
+        HashCell(int32_t x, int32_t y, int32_t z) :
+            mX(x), mY(y), mZ(z)
+        {
+            ;
+        }
+
+        FORCE_INLINE unsigned int getHash() const
+        {
+            // Large primes as used by common spatial hashing schemes. Unsigned arithmetic
+            // wraps instead of overflowing.
+            return static_cast<unsigned int>(mX) * 73856093u ^
+                   static_cast<unsigned int>(mY) * 19349663u ^
+                   static_cast<unsigned int>(mZ) * 83492791u;
+        }
+
+        FORCE_INLINE bool equals(const HashCell& other) const
+        {
+            return mX == other.mX && mY == other.mY && mZ == other.mZ;
+        }
+    private:
+        int32_t mX, mY, mZ;
+    };
+
+    // Undirected edge key: The smaller vertex index comes first.
+    typedef std::pair<uint32_t, uint32_t> EdgeKey;
+
+    FORCE_INLINE EdgeKey makeEdgeKey(uint32_t a, uint32_t b)
+    {
+        return a < b ? EdgeKey(a, b) : EdgeKey(b, a);
+    }
+
+    // Polygon index and edge index of a polygon edge.
+    typedef std::pair<uint32_t, uint32_t> EdgeRef;
+
+    class EdgeOwners
+    {
+    public:
+        EdgeOwners() :
+            numOwners(0)
+        {
+            ;
+        }
+
+        EdgeRef owners[2];
+        uint32_t numOwners;
+    };
+
+    typedef std::map<EdgeKey, EdgeOwners> EdgeMap;
+
+    void buildEdgeMap(const std::vector<std::vector<uint32_t> >& polygons, EdgeMap& edges)
+    {
+        edges.clear();
+        for(uint32_t i = 0; i < polygons.size(); ++i)
+        {
+            const std::vector<uint32_t>& polygon = polygons[i];
+            for(uint32_t j = 0; j < polygon.size(); ++j)
+            {
+                EdgeOwners& owners = edges[makeEdgeKey(polygon[j], polygon[(j+1) % polygon.size()])];
+
+                // Edges shared by more than two polygons (non-manifold) only connect
+                // the first two polygons.
+                if(owners.numOwners < 2)
+                {
+                    owners.owners[owners.numOwners++] = EdgeRef(i, j);
+                }
+            }
+        }
+    }
+}
+
+NavMesh::BuildParameters::BuildParameters() :
+    weldDistance(btScalar(0.01)),
+    cellSize(0),
+    maxVerticesPerPolygon(NavMeshPolygon::MAX_VERTICES)
+{
+    ;
+}
+
+NavMesh::NavMesh() :
+    mSearch(NULL),
+    mGridMin(0, 0, 0),
+    mInvCellSize(1),
+    mGridWidth(0),
+    mGridHeight(0)
+{
+    ;
+}
+
+NavMesh::~NavMesh()
+{
+    delete mSearch;
+}
+
+bool NavMesh::build(const btAlignedObjectArray<btVector3>& vertices,
+                    const btAlignedObjectArray<uint32_t>& indices,
+                    const BuildParameters& params)
+{
+    AI_ASSERT(indices.size() % 3 == 0, "The index count must be a multiple of three.");
+    AI_ASSERT(params.maxVerticesPerPolygon >= 3 &&
+              params.maxVerticesPerPolygon <= NavMeshPolygon::MAX_VERTICES,
+              "Polygons must have between 3 and MAX_VERTICES vertices.");
+
+    clear();
+
+    std::vector<uint32_t> remap;
+    weldVertices(vertices, params.weldDistance, remap);
+
+    // Collect the non-degenerate triangles in counter-clockwise order.
+    PolygonList polygons;
+    polygons.reserve(indices.size() / 3);
+    for(int i = 0; i + 2 < indices.size(); i += 3)
+    {
+        AI_ASSERT(indices[i]   < static_cast<uint32_t>(vertices.size()) &&
+                  indices[i+1] < static_cast<uint32_t>(vertices.size()) &&
+                  indices[i+2] < static_cast<uint32_t>(vertices.size()),
+                  "Triangle index out of range.");
+
+        uint32_t a = remap[indices[i]];
+        uint32_t b = remap[indices[i+1]];
+        uint32_t c = remap[indices[i+2]];
+
+        const btScalar area = area2(mVertices[a], mVertices[b], mVertices[c]);
+        if(a == b || b == c || a == c || btFabs(area) < sAreaEpsilon)
+        {
+            // Degenerate or vertical triangles are not walkable.
+            continue;
+        }
+
+        if(area < 0)
+        {
+            std::swap(b, c);
+        }
+
+        std::vector<uint32_t> triangle(3);
+        triangle[0] = a;
+        triangle[1] = b;
+        triangle[2] = c;
+        polygons.push_back(triangle);
+    }
+
+    // Merge the triangles into larger convex polygons to reduce the number of search nodes.
+    while(mergePolygons(polygons, params.maxVerticesPerPolygon))
+    {
+        ;
+    }
+
+    AI_ASSERT(polygons.size() < INVALID_POLYGON,
+              "The navigation mesh has too many polygons for 16-bit node indices.");
+    if(polygons.empty() || polygons.size() >= INVALID_POLYGON)
+    {
+        clear();
+        return false;
+    }
+
+    buildGraph(polygons);
+    buildGrid(params.cellSize);
+
+    mSearch = new search_type(mGraph);
+    return true;
+}
+
+uint16_t NavMesh::findPolygon(const btVector3& position,
+                              btScalar maxHeightDistance) const
+{
+    if(mCellStart.empty())
+    {
+        return INVALID_POLYGON;
+    }
+
+    const int32_t x = static_cast<int32_t>(std::floor((position.x() - mGridMin.x()) * mInvCellSize));
+    const int32_t z = static_cast<int32_t>(std::floor((position.z() - mGridMin.z()) * mInvCellSize));
+    if(x < 0 || z < 0 || x >= mGridWidth || z >= mGridHeight)
+    {
+        return INVALID_POLYGON;
+    }
+
+    const uint32_t cell = z * mGridWidth + x;
+
+    uint16_t best = INVALID_POLYGON;
+    btScalar bestDistance = maxHeightDistance;
+    for(uint32_t i = mCellStart[cell]; i < mCellStart[cell+1]; ++i)
+    {
+        const uint16_t idx = mCellPolygons[i];
+        const NavMeshPolygon& polygon = *mGraph.getNode(idx);
+
+        if(!containsPoint(polygon, position))
+        {
+            continue;
+        }
+
+        // The height of the polygon's surface at the query position.
+        const btVector3& plane = polygon.plane;
+        const btScalar height = -(plane.x() * position.x() +
+                                  plane.z() * position.z() +
+                                  plane.w()) / plane.y();
+        const btScalar distance = btFabs(position.y() - height);
+        if(distance <= bestDistance)
+        {
+            bestDistance = distance;
+            best = idx;
+        }
+    }
+
+    return best;
+}
+
+bool NavMesh::findPath(const btVector3& start,
+                       const btVector3& goal,
+                       path_type& path,
+                       btScalar maxHeightDistance) const
+{
+    path.clear();
+
+    const uint16_t startIdx = findPolygon(start, maxHeightDistance);
+    const uint16_t goalIdx  = findPolygon(goal, maxHeightDistance);
+    if(startIdx == INVALID_POLYGON || goalIdx == INVALID_POLYGON)
+    {
+        return false;
+    }
+
+    if(startIdx == goalIdx)
+    {
+        // Polygons are convex: There is a direct connection.
+        path.push_back(start);
+        path.push_back(goal);
+        return true;
+    }
+
+    const search_type::path_type corridor = mSearch->findPath(mGraph.getNode(startIdx),
+                                                              *mGraph.getNode(goalIdx),
+                                                              &centerDistance,
+                                                              &samePolygon);
+    if(corridor.empty())
+    {
+        return false;
+    }
+
+    // Collect the portals along the corridor. The start and goal are degenerate portals.
+    path_type lefts, rights;
+    lefts.reserve(corridor.size() + 1);
+    rights.reserve(corridor.size() + 1);
+
+    lefts.push_back(start);
+    rights.push_back(start);
+
+    const NavMeshPolygon* const first = mGraph.getNodesBegin();
+    for(size_t i = 0; i + 1 < corridor.size(); ++i)
+    {
+        btVector3 left, right;
+        getPortal(static_cast<uint16_t>(corridor[i] - first),
+                  static_cast<uint16_t>(corridor[i+1] - first),
+                  left, right);
+        lefts.push_back(left);
+        rights.push_back(right);
+    }
+
+    lefts.push_back(goal);
+    rights.push_back(goal);
+
+    stringPull(lefts, rights, path);
+    return true;
+}
+
+const NavMesh::graph_type& NavMesh::getGraph() const
+{
+    return mGraph;
+}
+
+const btVector3& NavMesh::getVertex(uint32_t idx) const
+{
+    return mVertices[idx];
+}
+
+size_t NavMesh::getNumPolygons() const
+{
+    return mGraph.getNumNodes();
+}
+
+real_type NavMesh::centerDistance(const NavMeshPolygon& lv,
+                                  const NavMeshPolygon& rv)
+{
+    return lv.center.distance(rv.center);
+}
+
+bool NavMesh::samePolygon(const NavMeshPolygon& lv,
+                          const NavMeshPolygon& rv)
+{
+    return &lv == &rv;
+}
+
+void NavMesh::clear()
+{
+    delete mSearch;
+    mSearch = NULL;
+
+    mVertices.clear();
+    mGraph = graph_type();
+    mCellStart.clear();
+    mCellPolygons.clear();
+    mGridWidth = mGridHeight = 0;
+}
+
+void NavMesh::weldVertices(const btAlignedObjectArray<btVector3>& vertices,
+                           btScalar weldDistance,
+                           std::vector<uint32_t>& remap)
+{
+    remap.resize(vertices.size());
+
+    if(weldDistance <= 0)
+    {
+        mVertices = vertices;
+        for(uint32_t i = 0; i < remap.size(); ++i)
+        {
+            remap[i] = i;
+        }
+        return;
+    }
+
+    // Vertices which fall into the same quantization cell are merged.
+    const btScalar invWeldDistance = btScalar(1.) / weldDistance;
+    btHashMap<HashCell, uint32_t> cells;
+    for(int i = 0; i < vertices.size(); ++i)
+    {
+        const btVector3& v = vertices[i];
+        const HashCell key(static_cast<int32_t>(std::floor(v.x() * invWeldDistance + btScalar(.5))),
+                           static_cast<int32_t>(std::floor(v.y() * invWeldDistance + btScalar(.5))),
+                           static_cast<int32_t>(std::floor(v.z() * invWeldDistance + btScalar(.5))));
+
+        const uint32_t* existing = cells.find(key);
+        if(existing)
+        {
+            remap[i] = *existing;
+        }
+        else
+        {
+            remap[i] = mVertices.size();
+            cells.insert(key, remap[i]);
+            mVertices.push_back(v);
+        }
+    }
+}
+
+bool NavMesh::mergePolygons(PolygonList& polygons, uint32_t maxVertices) const
+{
+    EdgeMap edges;
+    buildEdgeMap(polygons, edges);
+
+    // Polygons merged during this pass. Their entries in the edge map are outdated.
+    std::vector<bool> touched(polygons.size(), false);
+    std::vector<bool> removed(polygons.size(), false);
+    bool anyMerged = false;
+
+    std::vector<uint32_t> merged, bestMerged;
+    for(uint32_t i = 0; i < polygons.size(); ++i)
+    {
+        if(touched[i])
+        {
+            continue;
+        }
+
+        const std::vector<uint32_t>& polygon = polygons[i];
+
+        // Prefer merging across the longest shared edge to obtain well-shaped polygons.
+        uint32_t bestNeighbor = 0;
+        btScalar bestLength = -1;
+        for(uint32_t j = 0; j < polygon.size(); ++j)
+        {
+            const uint32_t a = polygon[j];
+            const uint32_t b = polygon[(j+1) % polygon.size()];
+            const EdgeOwners& owners = edges[makeEdgeKey(a, b)];
+            if(owners.numOwners != 2)
+            {
+                continue;
+            }
+
+            const EdgeRef& other = owners.owners[0].first == i ? owners.owners[1] : owners.owners[0];
+            if(other.first == i || touched[other.first])
+            {
+                continue;
+            }
+
+            const btScalar length = mVertices[a].distance2(mVertices[b]);
+            if(length > bestLength &&
+               tryMerge(polygon, j, polygons[other.first], other.second, maxVertices, merged))
+            {
+                bestLength = length;
+                bestNeighbor = other.first;
+                bestMerged.swap(merged);
+            }
+        }
+
+        if(bestLength >= 0)
+        {
+            polygons[i].swap(bestMerged);
+            touched[i] = touched[bestNeighbor] = true;
+            removed[bestNeighbor] = true;
+            anyMerged = true;
+        }
+    }
+
+    if(anyMerged)
+    {
+        // Compact the polygon list.
+        uint32_t numAlive = 0;
+        for(uint32_t i = 0; i < polygons.size(); ++i)
+        {
+            if(!removed[i])
+            {
+                polygons[numAlive++].swap(polygons[i]);
+            }
+        }
+        polygons.resize(numAlive);
+    }
+
+    return anyMerged;
+}
+
+bool NavMesh::tryMerge(const std::vector<uint32_t>& lv, uint32_t lvEdge,
+                       const std::vector<uint32_t>& rv, uint32_t rvEdge,
+                       uint32_t maxVertices,
+                       std::vector<uint32_t>& merged) const
+{
+    const uint32_t numLeft  = lv.size();
+    const uint32_t numRight = rv.size();
+    if(numLeft + numRight - 2 > maxVertices)
+    {
+        return false;
+    }
+
+    // Both polygons are counter-clockwise, so the shared edge runs in opposite directions.
+    AI_ASSERT(lv[lvEdge] == rv[(rvEdge+1) % numRight] &&
+              lv[(lvEdge+1) % numLeft] == rv[rvEdge],
+              "The merged polygons must share the given edge.");
+
+    // Walk around __lv__ starting after the shared edge, then around __rv__
+    // skipping the shared vertices.
+    merged.clear();
+    for(uint32_t i = 0; i < numLeft; ++i)
+    {
+        merged.push_back(lv[(lvEdge + 1 + i) % numLeft]);
+    }
+    for(uint32_t i = 2; i < numRight; ++i)
+    {
+        merged.push_back(rv[(rvEdge + i) % numRight]);
+    }
+
+    // The merged polygon must remain strictly convex.
+    const uint32_t numMerged = merged.size();
+    for(uint32_t i = 0; i < numMerged; ++i)
+    {
+        const btVector3& a = mVertices[merged[i]];
+        const btVector3& b = mVertices[merged[(i+1) % numMerged]];
+        const btVector3& c = mVertices[merged[(i+2) % numMerged]];
+        if(area2(a, b, c) <= sAreaEpsilon)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void NavMesh::buildGraph(const PolygonList& polygons)
+{
+    for(uint32_t i = 0; i < polygons.size(); ++i)
+    {
+        const std::vector<uint32_t>& vertices = polygons[i];
+
+        NavMeshPolygon polygon;
+        polygon.numVertices = vertices.size();
+
+        // Newell's method gives a robust normal for (nearly) planar polygons.
+        btVector3 normal(0, 0, 0);
+        btVector3 center(0, 0, 0);
+        for(uint32_t j = 0; j < vertices.size(); ++j)
+        {
+            const btVector3& current = mVertices[vertices[j]];
+            const btVector3& next    = mVertices[vertices[(j+1) % vertices.size()]];
+            normal += btVector3((current.y() - next.y()) * (current.z() + next.z()),
+                                (current.z() - next.z()) * (current.x() + next.x()),
+                                (current.x() - next.x()) * (current.y() + next.y()));
+            center += current;
+
+            polygon.vertices[j]  = vertices[j];
+            polygon.neighbors[j] = NavMeshPolygon::NO_NEIGHBOR;
+        }
+
+        center /= btScalar(vertices.size());
+        normal.normalize();
+        if(normal.y() < 0)
+        {
+            normal = -normal;
+        }
+
+        polygon.center = center;
+        polygon.plane = normal;
+        polygon.plane.setW(-normal.dot(center));
+
+        mGraph.addNode(polygon);
+    }
+
+    // Connect polygons that share an edge.
+    EdgeMap edges;
+    buildEdgeMap(polygons, edges);
+    for(EdgeMap::const_iterator it = edges.begin(); it != edges.end(); ++it)
+    {
+        const EdgeOwners& owners = it->second;
+        if(owners.numOwners != 2)
+        {
+            continue;
+        }
+
+        const EdgeRef& lv = owners.owners[0];
+        const EdgeRef& rv = owners.owners[1];
+
+        NavMeshPolygon* left  = mGraph.getNode(lv.first);
+        NavMeshPolygon* right = mGraph.getNode(rv.first);
+        left->neighbors[lv.second]  = rv.first;
+        right->neighbors[rv.second] = lv.first;
+
+        // The path cost is measured through the portal's midpoint.
+        const btVector3 midpoint = (mVertices[it->first.first] + mVertices[it->first.second]) * btScalar(.5);
+        const real_type cost = left->center.distance(midpoint) + midpoint.distance(right->center);
+        mGraph.addEdge(lv.first, rv.first, cost);
+        mGraph.addEdge(rv.first, lv.first, cost);
+    }
+}
+
+void NavMesh::buildGrid(btScalar cellSize)
+{
+    const size_t numPolygons = mGraph.getNumNodes();
+
+    btVector3 meshMin( BT_LARGE_FLOAT,  BT_LARGE_FLOAT,  BT_LARGE_FLOAT);
+    btVector3 meshMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+    btScalar totalArea = 0;
+    for(size_t i = 0; i < numPolygons; ++i)
+    {
+        const NavMeshPolygon& polygon = *mGraph.getNode(i);
+        for(uint32_t j = 0; j < polygon.numVertices; ++j)
+        {
+            meshMin.setMin(mVertices[polygon.vertices[j]]);
+            meshMax.setMax(mVertices[polygon.vertices[j]]);
+        }
+        for(uint32_t j = 2; j < polygon.numVertices; ++j)
+        {
+            totalArea += area2(mVertices[polygon.vertices[0]],
+                               mVertices[polygon.vertices[j-1]],
+                               mVertices[polygon.vertices[j]]) * btScalar(.5);
+        }
+    }
+
+    if(cellSize <= 0)
+    {
+        // Aim for roughly one polygon per cell.
+        cellSize = btSqrt(totalArea / numPolygons);
+    }
+
+    // Limit the grid to a sane size for very thin or sparse meshes.
+    const btScalar maxCells = btScalar(4 * numPolygons + 64);
+    const btScalar extentX = meshMax.x() - meshMin.x();
+    const btScalar extentZ = meshMax.z() - meshMin.z();
+    cellSize = btMax(cellSize, btSqrt(extentX * extentZ / maxCells));
+    cellSize = btMax(cellSize, btScalar(sAreaEpsilon));
+
+    mGridMin = meshMin;
+    mInvCellSize = btScalar(1.) / cellSize;
+    mGridWidth  = static_cast<int32_t>(extentX * mInvCellSize) + 1;
+    mGridHeight = static_cast<int32_t>(extentZ * mInvCellSize) + 1;
+
+    // Two passes: Count the polygons per cell, then fill in the polygon indices.
+    const uint32_t numCells = mGridWidth * mGridHeight;
+    mCellStart.assign(numCells + 1, 0);
+    for(int32_t pass = 0; pass < 2; ++pass)
+    {
+        std::vector<uint32_t> fill;
+        if(pass == 1)
+        {
+            for(uint32_t i = 0; i < numCells; ++i)
+            {
+                mCellStart[i+1] += mCellStart[i];
+            }
+            mCellPolygons.resize(mCellStart[numCells]);
+            fill.assign(mCellStart.begin(), mCellStart.end() - 1);
+        }
+
+        for(size_t i = 0; i < numPolygons; ++i)
+        {
+            const NavMeshPolygon& polygon = *mGraph.getNode(i);
+            btVector3 polyMin = mVertices[polygon.vertices[0]];
+            btVector3 polyMax = polyMin;
+            for(uint32_t j = 1; j < polygon.numVertices; ++j)
+            {
+                polyMin.setMin(mVertices[polygon.vertices[j]]);
+                polyMax.setMax(mVertices[polygon.vertices[j]]);
+            }
+
+            const int32_t x0 = static_cast<int32_t>((polyMin.x() - meshMin.x()) * mInvCellSize);
+            const int32_t z0 = static_cast<int32_t>((polyMin.z() - meshMin.z()) * mInvCellSize);
+            const int32_t x1 = btMin(static_cast<int32_t>((polyMax.x() - meshMin.x()) * mInvCellSize),
+                                     mGridWidth - 1);
+            const int32_t z1 = btMin(static_cast<int32_t>((polyMax.z() - meshMin.z()) * mInvCellSize),
+                                     mGridHeight - 1);
+            for(int32_t z = z0; z <= z1; ++z)
+            {
+                for(int32_t x = x0; x <= x1; ++x)
+                {
+                    const uint32_t cell = z * mGridWidth + x;
+                    if(pass == 0)
+                    {
+                        ++mCellStart[cell+1];
+                    }
+                    else
+                    {
+                        mCellPolygons[fill[cell]++] = static_cast<uint16_t>(i);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool NavMesh::containsPoint(const NavMeshPolygon& polygon, const btVector3& position) const
+{
+    for(uint32_t i = 0; i < polygon.numVertices; ++i)
+    {
+        const btVector3& a = mVertices[polygon.vertices[i]];
+        const btVector3& b = mVertices[polygon.vertices[(i+1) % polygon.numVertices]];
+        if(area2(a, b, position) < -sAreaEpsilon)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void NavMesh::getPortal(uint16_t from, uint16_t to, btVector3& left, btVector3& right) const
+{
+    const NavMeshPolygon& polygon = *mGraph.getNode(from);
+    for(uint32_t i = 0; i < polygon.numVertices; ++i)
+    {
+        if(polygon.neighbors[i] == to)
+        {
+            // Looking from inside the counter-clockwise polygon through edge i,
+            // the edge's end vertex lies to the left.
+            left  = mVertices[polygon.vertices[(i+1) % polygon.numVertices]];
+            right = mVertices[polygon.vertices[i]];
+            return;
+        }
+    }
+
+    AI_ASSERT(false, "Consecutive corridor polygons must be neighbors.");
+}
+
+void NavMesh::stringPull(const path_type& lefts, const path_type& rights, path_type& path) const
+{
+    // CREDITS: Simple Stupid Funnel Algorithm by Mikko Mononen
+    // http://digestingduck.blogspot.com/2010/03/simple-stupid-funnel-algorithm.html
+    AI_ASSERT(lefts.size() == rights.size() && lefts.size() >= 2,
+              "Requires at least the start and goal portals.");
+
+    btVector3 apex  = lefts[0];
+    btVector3 left  = lefts[0];
+    btVector3 right = rights[0];
+    int apexIndex = 0, leftIndex = 0, rightIndex = 0;
+
+    path.push_back(apex);
+
+    for(int i = 1; i < lefts.size(); ++i)
+    {
+        const btVector3& nextLeft  = lefts[i];
+        const btVector3& nextRight = rights[i];
+
+        // Try to narrow the funnel from the right.
+        if(area2(apex, right, nextRight) >= 0)
+        {
+            if(equals2(apex, right) || area2(apex, left, nextRight) < 0)
+            {
+                right = nextRight;
+                rightIndex = i;
+            }
+            else
+            {
+                // The right side crossed over the left side: The left vertex is a corner.
+                apex = left;
+                apexIndex = leftIndex;
+                path.push_back(apex);
+
+                // Restart the scan from the new apex.
+                left = right = apex;
+                leftIndex = rightIndex = apexIndex;
+                i = apexIndex;
+                continue;
+            }
+        }
+
+        // Try to narrow the funnel from the left.
+        if(area2(apex, left, nextLeft) <= 0)
+        {
+            if(equals2(apex, left) || area2(apex, right, nextLeft) > 0)
+            {
+                left = nextLeft;
+                leftIndex = i;
+            }
+            else
+            {
+                // The left side crossed over the right side: The right vertex is a corner.
+                apex = right;
+                apexIndex = rightIndex;
+                path.push_back(apex);
+
+                left = right = apex;
+                leftIndex = rightIndex = apexIndex;
+                i = apexIndex;
+                continue;
+            }
+        }
+    }
+
+    const btVector3& goal = lefts[lefts.size() - 1];
+    if(!equals2(path[path.size() - 1], goal) || path.size() == 1)
+    {
+        path.push_back(goal);
+    }
+}
+
+END_NS_AILIB
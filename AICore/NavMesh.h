@@ -0,0 +1,164 @@
+#ifndef NAVMESH_H
+#define NAVMESH_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "Graph.h"
+#include "AStar.h"
+#include <stdint.h>
+#include <vector>
+#include <LinearMath/btVector3.h>
+#include <LinearMath/btAlignedObjectArray.h>
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief NavMeshPolygon is a convex polygon of a navigation mesh and the node type of the
+ * navigation graph. Its vertices are stored counter-clockwise when seen from above (+Y).
+ * The edge i runs from vertices[i] to vertices[(i+1) % numVertices] and
+ * neighbors[i] is the index of the polygon on the other side of that edge (the portal).
+ */
+class NavMeshPolygon
+{
+public:
+    static const uint32_t MAX_VERTICES = 6;
+    static const uint16_t NO_NEIGHBOR  = 0xffff;
+
+    btVector3 center;
+    btVector3 plane; //< Normal in xyz, plane offset in w.
+    uint32_t vertices[MAX_VERTICES];
+    uint16_t neighbors[MAX_VERTICES];
+    uint8_t numVertices;
+};
+
+/**
+ * @brief The NavMesh class builds a polygonal navigation mesh from a triangle soup and answers
+ * path queries on it.
+ *
+ * Triangles are merged into convex polygons which share edges (portals) with their neighbors.
+ * Path queries run A* over the polygons and straighten the resulting polygon corridor using
+ * the simple stupid funnel algorithm, which yields the shortest path through the corridor.
+ * Positions are mapped to polygons using a uniform grid on the XZ plane.
+ *
+ * The up-axis is assumed to be +Y. The mesh supports at most 65534 polygons, which is the
+ * limit of the graph's 16-bit node indices.
+ *
+ * Path queries reuse the internal A* node cache and are therefore not thread-safe.
+ */
+class NavMesh
+{
+public:
+    typedef Graph<NavMeshPolygon, NavMeshPolygon::MAX_VERTICES> graph_type;
+    typedef AStar<graph_type> search_type;
+    typedef btAlignedObjectArray<btVector3> path_type;
+
+    static const uint16_t INVALID_POLYGON = NavMeshPolygon::NO_NEIGHBOR;
+
+    class BuildParameters
+    {
+    public:
+        BuildParameters();
+
+        // Vertices closer than this distance are welded together. 0 disables welding.
+        btScalar weldDistance;
+        // Side length of the point-location grid cells. 0 chooses a size based on
+        // the average polygon size.
+        btScalar cellSize;
+        // Maximum number of vertices of the merged polygons (3 to MAX_VERTICES).
+        uint32_t maxVerticesPerPolygon;
+    };
+
+    NavMesh();
+    ~NavMesh();
+
+    /**
+     * @brief build creates the navigation mesh from an indexed triangle soup.
+     * Previously built data is discarded. Degenerate and vertical triangles are ignored.
+     *
+     * @param vertices The triangle vertices.
+     * @param indices Three consecutive indices into __vertices__ form one triangle.
+     * @param params Optional. Welding, merging and grid settings.
+     *
+     * @return false if no walkable polygons could be built.
+     */
+    bool build(const btAlignedObjectArray<btVector3>& vertices,
+               const btAlignedObjectArray<uint32_t>& indices,
+               const BuildParameters& params = BuildParameters());
+
+    /**
+     * @brief findPolygon maps a position to the polygon below or above it.
+     *
+     * @param position The query position.
+     * @param maxHeightDistance The maximum vertical distance between __position__ and
+     *                          the polygon's surface.
+     *
+     * @return The index of the polygon closest in height, or INVALID_POLYGON.
+     */
+    uint16_t findPolygon(const btVector3& position,
+                         btScalar maxHeightDistance = btScalar(2.)) const;
+
+    /**
+     * @brief findPath computes a shortest path between __start__ and __goal__.
+     *
+     * @param start The start position. Must be on (or within __maxHeightDistance__ of) the mesh.
+     * @param goal The goal position. Must be on (or within __maxHeightDistance__ of) the mesh.
+     * @param path Output. The sequence of waypoints, beginning with __start__ and ending
+     *             with __goal__. Intermediate waypoints are polygon corners.
+     * @param maxHeightDistance See __findPolygon__.
+     *
+     * @return false if either position isn't on the mesh or no path exists.
+     */
+    bool findPath(const btVector3& start,
+                  const btVector3& goal,
+                  path_type& /* out */ path,
+                  btScalar maxHeightDistance = btScalar(2.)) const;
+
+    const graph_type& getGraph() const;
+    const btVector3& getVertex(uint32_t idx) const;
+    size_t getNumPolygons() const;
+
+    // Heuristic and comparator used for the A* search.
+    static real_type centerDistance(const NavMeshPolygon& lv,
+                                    const NavMeshPolygon& rv);
+    static bool samePolygon(const NavMeshPolygon& lv,
+                            const NavMeshPolygon& rv);
+private:
+    NavMesh(const NavMesh&);
+    NavMesh& operator=(const NavMesh&);
+
+    typedef std::vector<std::vector<uint32_t> > PolygonList;
+
+    void clear();
+    void weldVertices(const btAlignedObjectArray<btVector3>& vertices,
+                      btScalar weldDistance,
+                      std::vector<uint32_t>& /* out */ remap);
+    bool mergePolygons(PolygonList& polygons, uint32_t maxVertices) const;
+    bool tryMerge(const std::vector<uint32_t>& lv, uint32_t lvEdge,
+                  const std::vector<uint32_t>& rv, uint32_t rvEdge,
+                  uint32_t maxVertices,
+                  std::vector<uint32_t>& /* out */ merged) const;
+    void buildGraph(const PolygonList& polygons);
+    void buildGrid(btScalar cellSize);
+
+    bool containsPoint(const NavMeshPolygon& polygon, const btVector3& position) const;
+    void getPortal(uint16_t from, uint16_t to,
+                   btVector3& /* out */ left, btVector3& /* out */ right) const;
+    void stringPull(const path_type& lefts, const path_type& rights, path_type& path) const;
+
+    btAlignedObjectArray<btVector3> mVertices;
+    graph_type mGraph;
+    search_type* mSearch;
+
+    // Point-location grid. Cell (x, z) lists the polygons overlapping it in
+    // mCellPolygons[mCellStart[z*mGridWidth+x]] to mCellPolygons[mCellStart[z*mGridWidth+x+1]].
+    btVector3 mGridMin;
+    btScalar mInvCellSize;
+    int32_t mGridWidth, mGridHeight;
+    std::vector<uint32_t> mCellStart;
+    std::vector<uint16_t> mCellPolygons;
+};
+
+END_NS_AILIB
+
+#endif // NAVMESH_H
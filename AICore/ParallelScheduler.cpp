@@ -0,0 +1,306 @@
+#include "ParallelScheduler.h"
+#include <algorithm>
+
+BEGIN_NS_AILIB
+
+namespace
+{
+
+// Starts at 1, empty cache entries have owner 0.
+std::atomic<uint32_t> gNextSchedulerId(1);
+
+// Direct-mapped cache of the strands each thread enqueued to, which saves the locked lookup
+// when tasks are enqueued with the same key again. Strands live as long as their scheduler,
+// and scheduler ids are never reused, so entries never dangle.
+struct CachedStrand
+{
+    uint32_t owner;
+    uint32_t key;
+    void* strand;
+};
+
+const uint32_t STRAND_CACHE_SIZE = 64;
+
+thread_local CachedStrand gStrandCache[STRAND_CACHE_SIZE];
+
+} // namespace
+
+ParallelScheduler::ParallelScheduler(uint32_t numThreads) :
+    mId(gNextSchedulerId.fetch_add(1, std::memory_order_relaxed)),
+    mFrame(0),
+    mNumHelpers(0),
+    mNumBusy(0),
+    mShutdown(false),
+    mDeadline(0),
+    mSliceRuntime(500),
+    mDt(0),
+    mTracer(NULL)
+{
+    if(numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for(uint32_t i = 0; i < numThreads; ++i)
+    {
+        mQueues.push_back(new WorkerQueue());
+    }
+
+    // The thread calling __update__ acts as worker 0.
+    for(uint32_t i = 1; i < numThreads; ++i)
+    {
+        mThreads.push_back(std::thread(&ParallelScheduler::workerMain, this, i));
+    }
+}
+
+ParallelScheduler::~ParallelScheduler()
+{
+    {
+        std::lock_guard<std::mutex> guard(mFrameLock);
+        mShutdown = true;
+    }
+    mFrameStart.notify_all();
+
+    for(std::vector<std::thread>::iterator it = mThreads.begin(); it != mThreads.end(); ++it)
+    {
+        it->join();
+    }
+
+    for(std::vector<WorkerQueue*>::iterator it = mQueues.begin(); it != mQueues.end(); ++it)
+    {
+        delete *it;
+    }
+
+    for(int i = 0; i < mStrands.size(); ++i)
+    {
+        delete *mStrands.getAtIndex(i);
+    }
+}
+
+Scheduler& ParallelScheduler::getScheduler(AffinityKey key)
+{
+    return findStrand(key)->scheduler;
+}
+
+void ParallelScheduler::enqueue(Task* task, AffinityKey key)
+{
+    AI_ASSERT(task, "Enqueued tasks may not be NULL.");
+
+    CachedStrand& cached = gStrandCache[key % STRAND_CACHE_SIZE];
+    if(cached.owner != mId || cached.key != key)
+    {
+        cached.strand = findStrand(key);
+        cached.owner = mId;
+        cached.key = key;
+    }
+
+    static_cast<Strand*>(cached.strand)->scheduler.post(task);
+}
+
+void ParallelScheduler::clear()
+{
+    std::lock_guard<std::mutex> guard(mStrandLock);
+    for(int i = 0; i < mStrands.size(); ++i)
+    {
+        (*mStrands.getAtIndex(i))->scheduler.clear();
+    }
+}
+
+void ParallelScheduler::setTracer(SchedulerTracer* tracer)
+{
+    std::lock_guard<std::mutex> guard(mStrandLock);
+    mTracer = tracer;
+    for(int i = 0; i < mStrands.size(); ++i)
+    {
+        (*mStrands.getAtIndex(i))->scheduler.setTracer(tracer);
+    }
+}
+
+void ParallelScheduler::setSliceRuntime(HighResolutionTime::Timestamp sliceRuntime)
+{
+    mSliceRuntime = sliceRuntime;
+}
+
+uint32_t ParallelScheduler::getNumThreads() const
+{
+    return mQueues.size();
+}
+
+HighResolutionTime::Timestamp ParallelScheduler::update(HighResolutionTime::Timestamp maxRuntime,
+                                                        float dt)
+{
+    using namespace HighResolutionTime;
+
+    const Timestamp start = now();
+
+    // Distribute the strands with pending work round-robin over the workers.
+    // No worker is running yet, so the strands' schedulers may be accessed directly.
+    uint32_t numQueued = 0;
+    {
+        std::lock_guard<std::mutex> guard(mStrandLock);
+        for(int i = 0; i < mStrands.size(); ++i)
+        {
+            Strand* strand = *mStrands.getAtIndex(i);
+            strand->scheduler.drainInbox();
+            strand->scheduler.wakeSleepingTasks(start);
+
+            if(strand->scheduler.hasRunningTasks())
+            {
+                mQueues[numQueued++ % mQueues.size()]->strands.push_back(strand);
+            }
+        }
+    }
+
+    if(numQueued == 0)
+    {
+        return now() - start;
+    }
+
+    // Wake up the workers. Only as many as there are strands to run.
+    const uint32_t numHelpers = std::min<uint32_t>(mThreads.size(), numQueued - 1);
+    {
+        std::lock_guard<std::mutex> guard(mFrameLock);
+        mDeadline = start + maxRuntime;
+        mDt = dt;
+        mNumHelpers = mNumBusy = numHelpers;
+        ++mFrame;
+    }
+    if(numHelpers > 0)
+    {
+        mFrameStart.notify_all();
+    }
+
+    work(0);
+
+    // Wait until all workers have returned their strands.
+    {
+        std::unique_lock<std::mutex> lock(mFrameLock);
+        while(mNumBusy > 0)
+        {
+            mFrameEnd.wait(lock);
+        }
+    }
+
+    // Strands left over once the budget is spent are picked up again next frame.
+    for(std::vector<WorkerQueue*>::iterator it = mQueues.begin(); it != mQueues.end(); ++it)
+    {
+        (*it)->strands.clear();
+    }
+
+    return now() - start;
+}
+
+ParallelScheduler::Strand* ParallelScheduler::findStrand(AffinityKey key)
+{
+    std::lock_guard<std::mutex> guard(mStrandLock);
+
+    Strand** existing = mStrands.find(btHashInt(key));
+    if(existing)
+    {
+        return *existing;
+    }
+
+    Strand* strand = new Strand();
+    strand->scheduler.setTracer(mTracer);
+    mStrands.insert(btHashInt(key), strand);
+    return strand;
+}
+
+ParallelScheduler::Strand* ParallelScheduler::popStrand(uint32_t worker)
+{
+    // Take the oldest strand of our own queue first.
+    {
+        WorkerQueue* own = mQueues[worker];
+        std::lock_guard<std::mutex> guard(own->lock);
+        if(!own->strands.empty())
+        {
+            Strand* strand = own->strands.front();
+            own->strands.pop_front();
+            return strand;
+        }
+    }
+
+    // Steal the youngest strand of another worker.
+    for(uint32_t i = 1; i < mQueues.size(); ++i)
+    {
+        WorkerQueue* victim = mQueues[(worker + i) % mQueues.size()];
+        std::lock_guard<std::mutex> guard(victim->lock);
+        if(!victim->strands.empty())
+        {
+            Strand* strand = victim->strands.back();
+            victim->strands.pop_back();
+            return strand;
+        }
+    }
+
+    return NULL;
+}
+
+void ParallelScheduler::pushStrand(uint32_t worker, Strand* strand)
+{
+    WorkerQueue* own = mQueues[worker];
+    std::lock_guard<std::mutex> guard(own->lock);
+    own->strands.push_back(strand);
+}
+
+void ParallelScheduler::work(uint32_t worker)
+{
+    using namespace HighResolutionTime;
+
+    Timestamp current = now();
+    while(current < mDeadline)
+    {
+        Strand* strand = popStrand(worker);
+        if(!strand)
+        {
+            // Strands are only re-queued by the worker that runs them, so
+            // no new work can appear for this worker anymore.
+            break;
+        }
+
+        strand->scheduler.update(std::min(mSliceRuntime, mDeadline - current), mDt);
+
+        if(strand->scheduler.hasRunningTasks())
+        {
+            pushStrand(worker, strand);
+        }
+
+        current = now();
+    }
+}
+
+void ParallelScheduler::workerMain(uint32_t worker)
+{
+    uint32_t lastFrame = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mFrameLock);
+            while(!mShutdown && (mFrame == lastFrame || worker > mNumHelpers))
+            {
+                if(mFrame != lastFrame)
+                {
+                    // This worker isn't needed during this frame.
+                    lastFrame = mFrame;
+                }
+                mFrameStart.wait(lock);
+            }
+
+            if(mShutdown)
+            {
+                return;
+            }
+            lastFrame = mFrame;
+        }
+
+        work(worker);
+
+        {
+            std::lock_guard<std::mutex> guard(mFrameLock);
+            --mNumBusy;
+        }
+        mFrameEnd.notify_one();
+    }
+}
+
+END_NS_AILIB
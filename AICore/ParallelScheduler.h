@@ -0,0 +1,114 @@
+#ifndef PARALLELSCHEDULER_H
+#define PARALLELSCHEDULER_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "Scheduler.h"
+#include "HighResolutionTime.h"
+#include <LinearMath/btHashMap.h>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief The ParallelScheduler executes tasks on multiple threads under a shared time budget.
+ *
+ * Tasks are grouped into strands by an affinity key. Every strand owns a Scheduler and the tasks
+ * of a strand never run concurrently. Tasks that share state (e.g. all behaviors of one agent)
+ * must therefore use the same key. Behaviors are constructed with the strand's scheduler
+ * (see __getScheduler__), so they can enqueue children and change their status from the worker
+ * thread that runs them without any locking.
+ *
+ * During __update__, the strands with running tasks are distributed over per-worker deques.
+ * Workers execute strands for a time slice and re-queue them while they have work left.
+ * Idle workers steal strands from the other workers' deques.
+ */
+class ParallelScheduler
+{
+public:
+    typedef uint32_t AffinityKey;
+
+    // __numThreads__ includes the calling thread. 0 uses the hardware concurrency.
+    explicit ParallelScheduler(uint32_t numThreads = 0);
+    ~ParallelScheduler();
+
+    /**
+     * @brief getScheduler returns the scheduler of the strand __key__ and creates the
+     * strand if necessary. Strands should be created outside of __update__.
+     */
+    Scheduler& getScheduler(AffinityKey key);
+
+    /**
+     * @brief enqueue schedules __task__ on the strand __key__. Thread-safe.
+     * The task is posted to the strand scheduler's lock-free inbox (see Scheduler::post).
+     * Every thread caches the strands it enqueued to, so repeated keys skip the locked lookup.
+     * Tasks enqueued into other strands during __update__ are started on the next update.
+     */
+    void enqueue(Task* task, AffinityKey key);
+
+    void clear();
+
+    // Sets the tracer of all strands, including strands created later. See Scheduler::setTracer.
+    void setTracer(SchedulerTracer* tracer);
+
+    // The maximum time a strand is executed before a worker moves on to the next strand.
+    void setSliceRuntime(HighResolutionTime::Timestamp sliceRuntime);
+    uint32_t getNumThreads() const;
+
+    // @returns Number of microseconds (wall-clock time) spent computing during this call.
+    HighResolutionTime::Timestamp update(HighResolutionTime::Timestamp maxRuntime, float dt);
+private:
+    ParallelScheduler(const ParallelScheduler&);
+    ParallelScheduler& operator=(const ParallelScheduler&);
+
+    class Strand
+    {
+    public:
+        Scheduler scheduler;
+    };
+
+    class WorkerQueue
+    {
+    public:
+        std::mutex lock;
+        std::deque<Strand*> strands;
+    };
+
+    Strand* findStrand(AffinityKey key);
+    Strand* popStrand(uint32_t worker);
+    void pushStrand(uint32_t worker, Strand* strand);
+    void work(uint32_t worker);
+    void workerMain(uint32_t worker);
+
+    std::vector<std::thread> mThreads;
+    std::vector<WorkerQueue*> mQueues;
+
+    // Identifies the scheduler in the strands cached by threads, never reused.
+    const uint32_t mId;
+    std::mutex mStrandLock;
+    btHashMap<btHashInt, Strand*> mStrands;
+
+    // Frame synchronization with the worker threads.
+    std::mutex mFrameLock;
+    std::condition_variable mFrameStart;
+    std::condition_variable mFrameEnd;
+    uint32_t mFrame;
+    uint32_t mNumHelpers;
+    uint32_t mNumBusy;
+    bool mShutdown;
+
+    HighResolutionTime::Timestamp mDeadline;
+    HighResolutionTime::Timestamp mSliceRuntime;
+    float mDt;
+    SchedulerTracer* mTracer;
+};
+
+END_NS_AILIB
+
+#endif // PARALLELSCHEDULER_H
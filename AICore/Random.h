@@ -0,0 +1,95 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#pragma once
+
+#include "ai_global.h"
+#include <atomic>
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief Random is a small and fast pseudo-random number generator (PCG32, see pcg-random.org)
+ * with 16 bytes of state.
+ *
+ * Unlike rand(), every instance has its own state, so generators can be used from multiple
+ * threads and sequences don't depend on what other systems draw. Generators with the same
+ * __seed__ and __stream__ produce the same sequence. Different streams of one seed are
+ * independent, e.g. one stream per agent keeps a simulation replayable regardless of the
+ * order in which agents are updated.
+ *
+ * Components that own a generator default to unique(), so instances that weren't given one
+ * explicitly don't repeat each other's choices.
+ */
+class Random
+{
+public:
+    static const uint64_t DEFAULT_SEED = 0x853C49E6748FEA9BULL;
+
+    explicit Random(uint64_t seed = DEFAULT_SEED, uint64_t stream = 0)
+    {
+        setSeed(seed, stream);
+    }
+
+    // @returns A generator of the default seed on a stream that no other call returned.
+    // The streams are numbered in the order of the calls.
+    static Random unique()
+    {
+        static std::atomic<uint64_t> sNextStream(1);
+        return Random(DEFAULT_SEED, sNextStream.fetch_add(1, std::memory_order_relaxed));
+    }
+
+    void setSeed(uint64_t seed, uint64_t stream = 0)
+    {
+        mState = 0;
+        // The increment selects the stream and must be odd.
+        mIncrement = (stream << 1) | 1;
+        next();
+        mState += seed;
+        next();
+    }
+
+    // @returns A uniformly distributed 32 bit number.
+    FORCE_INLINE uint32_t next()
+    {
+        const uint64_t old = mState;
+        mState = old * 6364136223846793005ULL + mIncrement;
+        const uint32_t xorShifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        const uint32_t rotation = static_cast<uint32_t>(old >> 59);
+        return (xorShifted >> rotation) | (xorShifted << ((~rotation + 1) & 31));
+    }
+
+    // @returns A uniformly distributed number in [0, __bound__). __bound__ mustn't be 0.
+    FORCE_INLINE uint32_t nextBelow(uint32_t bound)
+    {
+        AI_ASSERT(bound > 0, "The bound must be positive.");
+
+        // Lemire's multiply-shift method. Rejects the few values that would bias the result.
+        uint64_t product = static_cast<uint64_t>(next()) * bound;
+        uint32_t low = static_cast<uint32_t>(product);
+        if(low < bound)
+        {
+            const uint32_t threshold = (~bound + 1) % bound;
+            while(low < threshold)
+            {
+                product = static_cast<uint64_t>(next()) * bound;
+                low = static_cast<uint32_t>(product);
+            }
+        }
+        return static_cast<uint32_t>(product >> 32);
+    }
+
+    // @returns A uniformly distributed number in [0, 1).
+    FORCE_INLINE float nextFloat()
+    {
+        // The upper 24 bits fit into the mantissa exactly.
+        return (next() >> 8) * (1.0f / 16777216.0f);
+    }
+private:
+    uint64_t mState;
+    uint64_t mIncrement;
+};
+
+END_NS_AILIB
+
+#endif // RANDOM_H
@@ -1,48 +1,133 @@
 #include "Scheduler.h"
 #include "HighResolutionTime.h"
 #include <algorithm>
-#include <queue>
+#include <cstring>
 
 BEGIN_NS_AILIB
 
+SchedulerStatistics::SchedulerStatistics() :
+    overloadedUpdates(0)
+{
+    std::memset(admitted, 0, sizeof(admitted));
+    std::memset(runs, 0, sizeof(runs));
+    std::memset(deadlineMisses, 0, sizeof(deadlineMisses));
+}
+
 Scheduler::Scheduler() :
-    mListener(NULL)
+    mPolicy(&mDefaultPolicy),
+    mListener(NULL),
+    mRuntimeHalfLife(DEFAULT_RUNTIME_HALF_LIFE),
+    mLastDecay(HighResolutionTime::now()),
+    mRuntimeEpoch(0),
+    mTimers(NULL),
+    mBudget(NULL),
+    mTracer(NULL),
+    mCurrent(NULL),
+    mCurrentRequest(CurrentContinue),
+    mValidating(false),
+    mUpdateStamp(0),
+    mNumRanQueued(0)
 {
     ;
 }
 
+Scheduler::Scheduler(SchedulingPolicy* policy) :
+    mPolicy(policy),
+    mListener(NULL),
+    mRuntimeHalfLife(DEFAULT_RUNTIME_HALF_LIFE),
+    mLastDecay(HighResolutionTime::now()),
+    mRuntimeEpoch(0),
+    mTimers(NULL),
+    mBudget(NULL),
+    mTracer(NULL),
+    mCurrent(NULL),
+    mCurrentRequest(CurrentContinue),
+    mValidating(false),
+    mUpdateStamp(0),
+    mNumRanQueued(0)
+{
+    AI_ASSERT(mPolicy, "The scheduling policy may not be NULL.");
+}
+
+Scheduler::~Scheduler()
+{
+    delete mTimers;
+}
+
 void Scheduler::setListener(SchedulerListener* listener)
 {
     mListener = listener;
 }
 
+void Scheduler::setTracer(SchedulerTracer* tracer)
+{
+    mTracer = tracer;
+}
+
 void Scheduler::clear()
 {
-    while(!mTasks.empty())
+    drainInbox();
+
+    while(!mPolicy->empty())
     {
-        Task* current = *mTasks.begin();
+        Task* current = mPolicy->top();
         current->setStatus(StatusTerminated);
     }
     while(!mWaiting.empty())
     {
-        Task* current = *mWaiting.begin();
+        Task* current = mWaiting.front();
         current->setStatus(StatusTerminated);
     }
+    if(mTimers)
+    {
+        TaskQueue sleeping;
+        mTimers->removeAll(sleeping);
+        while(!sleeping.empty())
+        {
+            sleeping.popFront()->setStatus(StatusTerminated);
+        }
+    }
 }
 
 void Scheduler::enqueue(Task* task)
 {
     AI_ASSERT(task, "Enqueued tasks may not be NULL.");
 
+    if(task == mCurrent)
+    {
+        // The executing task isn't part of any set. Decide once it returns.
+        mCurrentRequest = CurrentRestart;
+        return;
+    }
+
     if(task->getStatus() == StatusWaiting)
     {
-        mWaiting.insert(task);
+        mWaiting.pushBack(task);
+    }
+    else if(task->getStatus() == StatusSleeping)
+    {
+        if(!mTimers)
+        {
+            // Most schedulers never see a sleeping task. Don't pay for the wheel up-front.
+            mTimers = new TimerWheel(HighResolutionTime::now());
+        }
+        mTimers->insert(task);
     }
     else
     {
-        task->setStatus(StatusRunning);
-        task->resetRuntime();
-        mTasks.insert(task);
+        // Newly started tasks begin without runtime. Tasks that keep running
+        // (or resume after waiting) keep their decayed runtime to remain fair.
+        if(task->getStatus() != StatusRunning)
+        {
+            // Dormant tasks still listen to this scheduler. Detach them first, so
+            // the status change doesn't insert them a second time.
+            task->setListener(NULL);
+            task->setStatus(StatusRunning);
+            task->resetRuntime();
+            activate(task);
+        }
+        task->decayRuntime(mRuntimeEpoch);
+        mPolicy->push(task);
     }
     task->setListener(this);
 
@@ -56,6 +141,12 @@ void Scheduler::dequeue(Task* task)
 {
     AI_ASSERT(task, "Dequeued tasks may not be NULL.");
 
+    if(task == mCurrent)
+    {
+        mCurrentRequest = CurrentRemove;
+        return;
+    }
+
     const Status status = task->getStatus();
     if(status == StatusWaiting)
     {
@@ -65,67 +156,295 @@ void Scheduler::dequeue(Task* task)
     {
         removeRunning(task);
     }
+    else if(status == StatusSleeping)
+    {
+        removeSleeping(task);
+    }
     else
     {
-        AI_ASSERT(false, "Only waiting or running tasks may be removed.");
+        AI_ASSERT(false, "Only waiting, running or sleeping tasks may be removed.");
     }
 }
 
+bool Scheduler::hasRunningTasks() const
+{
+    return !mPolicy->empty();
+}
+
+void Scheduler::post(Task* task)
+{
+    mInbox.post(task, TaskInbox::RequestEnqueue);
+}
+
+void Scheduler::postStatus(Task* task, Status status)
+{
+    AI_ASSERT(status != StatusSleeping, "Tasks can't be put to sleep from other threads.");
+    mInbox.post(task, static_cast<uint8_t>(TaskInbox::RequestStatus + status));
+}
+
+namespace
+{
+    struct ApplyRequest
+    {
+        explicit ApplyRequest(Scheduler* scheduler) :
+            scheduler(scheduler)
+        {
+            ;
+        }
+
+        void operator()(Task* task, uint8_t request)
+        {
+            if(request == TaskInbox::RequestEnqueue)
+            {
+                scheduler->enqueue(task);
+            }
+            else
+            {
+                task->setStatus(static_cast<Status>(request - TaskInbox::RequestStatus));
+            }
+        }
+
+        Scheduler* scheduler;
+    };
+}
+
+void Scheduler::drainInbox()
+{
+    if(mInbox.empty())
+    {
+        return;
+    }
+
+    ApplyRequest apply(this);
+    mInbox.drain(apply);
+}
+
+void Scheduler::wakeSleepingTasks(HighResolutionTime::Timestamp time)
+{
+    if(!mTimers || mTimers->empty())
+    {
+        return;
+    }
+
+    TaskQueue expired;
+    mTimers->advance(time, expired);
+    while(!expired.empty())
+    {
+        // The listener (this scheduler) moves the task into the running tasks.
+        expired.popFront()->setStatus(StatusRunning);
+    }
+}
+
+void Scheduler::setRuntimeHalfLife(HighResolutionTime::Timestamp halfLife)
+{
+    AI_ASSERT(halfLife >= 0, "The half-life may not be negative.");
+    mRuntimeHalfLife = halfLife;
+    mLastDecay = HighResolutionTime::now();
+}
+
+void Scheduler::setBudgetController(BudgetController* controller)
+{
+    mBudget = controller;
+}
+
 HighResolutionTime::Timestamp Scheduler::update(HighResolutionTime::Timestamp maxRuntime, float dt)
 {
-    UNUSED(dt);
     using namespace HighResolutionTime;
 
+    AI_ASSERT(!mCurrent, "Scheduler::update may not be called recursively.");
+    AI_ASSERT(!mValidating || validate(), "The scheduler's task sets are inconsistent.");
+
+    drainInbox();
+
+    const Timestamp time = now();
+    advanceRuntimeEpoch(time);
+    wakeSleepingTasks(time);
+
+    if(mBudget)
+    {
+        maxRuntime = mBudget->beginFrame(maxRuntime, dt);
+    }
+
+    // 0 marks tasks that didn't run and be queued again in any update.
+    if(++mUpdateStamp == 0)
+    {
+        mUpdateStamp = 1;
+    }
+    mNumRanQueued = 0;
+
     Timestamp currentRuntime = 0;
-    while(!mTasks.empty() && currentRuntime <= maxRuntime)
+    while(!mPolicy->empty() && currentRuntime <= maxRuntime)
     {
-        Timestamp start = now();
+        // Take the task the policy deems most important (by default the lowest runtime to date).
+        Task* current = mPolicy->top();
+
+        // Don't start a task that would likely overrun the budget. The first task always runs,
+        // so expensive tasks can't starve.
+        if(mBudget && currentRuntime > 0 && !mBudget->fits(current, maxRuntime - currentRuntime))
+        {
+            break;
+        }
 
-        // Take tasks from the end (lowest runtime to date).
-        Task* current = *mTasks.begin();
+        const Timestamp start = now();
 
         if(mListener)
         {
             mListener->onBeginRunTask(current);
         }
 
-        // Ignore changes to the status of this task during its execution time.
-        current->setListener(NULL);
-
         AI_ASSERT(current->getStatus() == StatusRunning,
                   "All tasks in the task queue must be running.");
 
         dequeue(current);
 
+        // The executing task is part of no set and has no listener. Its status changes
+        // are ignored during its execution, requests to enqueue or dequeue it are deferred.
+        // Its status after returning decides where it goes.
+        mCurrent = current;
+        mCurrentRequest = CurrentContinue;
+
         // Execute the current task.
         current->run();
 
-        Timestamp duration = now() - start;
+        mCurrent = NULL;
+
+        const Timestamp duration = now() - start;
         currentRuntime += duration;
 
-        // Add the granted computation time to the tasks runtime if it isn't done yet.
-        if(current->getStatus() == StatusRunning ||
-           current->getStatus() == StatusWaiting)
-        {
-            // Re-insert it at the appropiate position in the task queue
-            current->addRuntime(duration);
-            enqueue(current);
-        }
+        finishCurrent(current, start, duration);
+    }
+
+    // Tasks that ran and keep running are queued again. Only the others were left out.
+    if(mPolicy->size() > mNumRanQueued)
+    {
+        ++mStatistics.overloadedUpdates;
+        countOverdueTasks(now());
+    }
+
+    if(mBudget)
+    {
+        mBudget->endFrame(currentRuntime);
+    }
+
+    AI_TRACE(mTracer, recordUpdate(time, now() - time, maxRuntime));
+    AI_ASSERT(!mValidating || validate(), "The scheduler's task sets are inconsistent.");
 
-        if(current->getStatus() != StatusTerminated)
+    return currentRuntime;
+}
+
+void Scheduler::finishCurrent(Task* task,
+                              HighResolutionTime::Timestamp start,
+                              HighResolutionTime::Timestamp duration)
+{
+    const Status status = task->getStatus();
+
+    AI_TRACE(mTracer, recordRun(task, start, duration));
+    if(status != StatusRunning)
+    {
+        AI_TRACE(mTracer, recordStatusChange(task, StatusRunning, status));
+    }
+
+    if(mListener)
+    {
+        mListener->onEndRunTask(task, duration);
+    }
+
+    const Priority priority = task->getPriority();
+    ++mStatistics.runs[priority];
+
+    if(mBudget)
+    {
+        mBudget->record(task, duration);
+    }
+
+    // An activation is complete once the task stops running.
+    if(status != StatusRunning &&
+       task->getDeadline() != 0 &&
+       start + duration > task->getDeadline() &&
+       !task->mDeadlineMissed)
+    {
+        task->mDeadlineMissed = true;
+        ++mStatistics.deadlineMisses[priority];
+    }
+
+    if(mCurrentRequest == CurrentRemove || status == StatusTerminated)
+    {
+        // Removed or done for good. The task was already detached when it started executing.
+        return;
+    }
+
+    if(status == StatusRunning ||
+       status == StatusWaiting ||
+       status == StatusSleeping)
+    {
+        // Add the granted computation time to the task's runtime and re-insert it
+        // at the appropiate position.
+        task->decayRuntime(mRuntimeEpoch);
+        task->addRuntime(duration);
+        enqueue(task);
+        markRanQueued(task);
+    }
+    else if(mCurrentRequest == CurrentRestart)
+    {
+        // The task completed (became dormant) and was enqueued again, e.g. by a parent
+        // repeating it. Start a new activation.
+        enqueue(task);
+        markRanQueued(task);
+    }
+    else
+    {
+        // Dormant tasks keep listening to this scheduler, so changing their status to
+        // running starts them again.
+        task->setListener(this);
+    }
+}
+
+void Scheduler::markRanQueued(Task* task)
+{
+    // Only tasks in the policy are counted, not waiting or sleeping ones.
+    if(task->getStatus() == StatusRunning && task->getListener() == this)
+    {
+        task->mUpdateStamp = mUpdateStamp;
+        ++mNumRanQueued;
+    }
+}
+
+void Scheduler::countOverdueTasks(HighResolutionTime::Timestamp time)
+{
+    mOverdue.clear();
+    mPolicy->getOverdue(time, mOverdue);
+    for(std::vector<Task*>::iterator it = mOverdue.begin(); it != mOverdue.end(); ++it)
+    {
+        Task* task = *it;
+        if(!task->mDeadlineMissed)
         {
-            current->setListener(this);
+            task->mDeadlineMissed = true;
+            ++mStatistics.deadlineMisses[task->getPriority()];
         }
     }
+}
 
-    return currentRuntime;
+void Scheduler::advanceRuntimeEpoch(HighResolutionTime::Timestamp time)
+{
+    if(mRuntimeHalfLife <= 0 || time - mLastDecay < mRuntimeHalfLife)
+    {
+        return;
+    }
+
+    const HighResolutionTime::Timestamp halvings = (time - mLastDecay) / mRuntimeHalfLife;
+    mLastDecay += halvings * mRuntimeHalfLife;
+
+    // Queued tasks are moved by the policy. Their own counters are decayed lazily.
+    const uint32_t clamped = static_cast<uint32_t>(std::min<HighResolutionTime::Timestamp>(halvings, 32));
+    mRuntimeEpoch += clamped;
+    mPolicy->decay(clamped);
 }
 
 void Scheduler::onStatusChanged(Task* task, Status from)
 {
-    // TODO: Some tasks get lost during status changes
-    //       (probably from changing to running / waiting when they are not being executed)
-    //       Allow this to happen by checking for the currently executed task here explicitly.
+    AI_ASSERT(task != mCurrent, "The executing task has no listener.");
+    AI_TRACE(mTracer, recordStatusChange(task, from, task->getStatus()));
+
     if(from == StatusWaiting)
     {
         removeWaiting(task);
@@ -134,9 +453,19 @@ void Scheduler::onStatusChanged(Task* task, Status from)
     {
         removeRunning(task);
     }
+    else if(from == StatusSleeping)
+    {
+        removeSleeping(task);
+    }
 
     const Status to = task->getStatus();
-    if(to == StatusRunning || to == StatusWaiting)
+    if(to == StatusRunning && from != StatusRunning)
+    {
+        // Resumed tasks start a new activation.
+        activate(task);
+    }
+
+    if(to == StatusRunning || to == StatusWaiting || to == StatusSleeping)
     {
         enqueue(task);
     }
@@ -146,20 +475,107 @@ void Scheduler::onStatusChanged(Task* task, Status from)
     }
 }
 
+const SchedulerStatistics& Scheduler::getStatistics() const
+{
+    return mStatistics;
+}
+
+void Scheduler::resetStatistics()
+{
+    mStatistics = SchedulerStatistics();
+}
+
+void Scheduler::activate(Task* task)
+{
+    ++mStatistics.admitted[task->getPriority()];
+    task->mDeadlineMissed = false;
+
+    if(task->getPeriod() > 0)
+    {
+        task->setDeadline(HighResolutionTime::now() + task->getPeriod());
+    }
+}
+
+bool Scheduler::validate() const
+{
+    std::vector<Task*> running;
+    if(!mPolicy->getTasks(running) || running.size() != mPolicy->size())
+    {
+        return false;
+    }
+
+    std::vector<Task*> waiting;
+    mWaiting.getTasks(waiting);
+
+    std::vector<Task*> sleeping;
+    if(mTimers)
+    {
+        mTimers->getTasks(sleeping);
+        if(sleeping.size() != mTimers->size())
+        {
+            return false;
+        }
+    }
+
+    const Status statuses[] = { StatusRunning, StatusWaiting, StatusSleeping };
+    const std::vector<Task*>* sets[] = { &running, &waiting, &sleeping };
+
+    std::vector<Task*> all;
+    for(uint32_t i = 0; i < 3; ++i)
+    {
+        for(std::vector<Task*>::const_iterator it = sets[i]->begin(); it != sets[i]->end(); ++it)
+        {
+            Task* task = *it;
+            if(task == mCurrent ||
+               task->getStatus() != statuses[i] ||
+               task->getListener() != this)
+            {
+                return false;
+            }
+            all.push_back(task);
+        }
+    }
+
+    // No task may be part of more than one set, or be part of a set twice.
+    std::sort(all.begin(), all.end());
+    return std::adjacent_find(all.begin(), all.end()) == all.end();
+}
+
+void Scheduler::setValidating(bool validating)
+{
+    mValidating = validating;
+}
+
 void Scheduler::removeWaiting(Task* task)
 {
-    removeFrom(mWaiting, task);
+    AI_ASSERT(TaskQueue::isQueued(task), "Couldn't find task to erase.");
+    TaskQueue::remove(task);
+    notifyRemoved(task);
 }
 
 void Scheduler::removeRunning(Task* task)
 {
-    removeFrom(mTasks, task);
+    if(task->mUpdateStamp == mUpdateStamp)
+    {
+        task->mUpdateStamp = 0;
+        --mNumRanQueued;
+    }
+    mPolicy->remove(task);
+    notifyRemoved(task);
+}
+
+void Scheduler::removeSleeping(Task* task)
+{
+    // Tasks woken by the timer wheel have already been removed from it.
+    if(TaskQueue::isQueued(task))
+    {
+        mTimers->remove(task);
+    }
+    notifyRemoved(task);
 }
 
-void Scheduler::removeFrom(TaskList& list, Task* task)
+void Scheduler::notifyRemoved(Task* task)
 {
-    size_t numRemoved = list.erase(task);
-    AI_ASSERT(numRemoved == 1, "Couldn't find task to erase.");
     task->setListener(NULL);
 
     if(mListener)
@@ -5,24 +5,14 @@
 
 #include "ai_global.h"
 #include "Task.h"
-#include <set>
+#include "SchedulingPolicy.h"
+#include "TimerWheel.h"
+#include "BudgetController.h"
+#include "TaskInbox.h"
+#include "SchedulerTracer.h"
 
 BEGIN_NS_AILIB
 
-class TaskComparator
-{
-public:
-    FORCE_INLINE bool operator() (const Task* lv, const Task* rv) const
-    {
-        if(lv->getRuntime() == rv->getRuntime())
-        {
-            return lv > rv;
-        }
-
-        return lv->getRuntime() < rv->getRuntime();
-    }
-};
-
 class SchedulerListener
 {
 public:
@@ -41,32 +31,177 @@ public:
     {
         UNUSED(task)
     }
+
+    // __duration__ is the time the task took to run, in microseconds.
+    virtual void onEndRunTask(Task* task, HighResolutionTime::Timestamp duration)
+    {
+        UNUSED(task)
+        UNUSED(duration)
+    }
+};
+
+/**
+ * @brief SchedulerStatistics counts admissions, executions and missed deadlines
+ * per priority class.
+ */
+class SchedulerStatistics
+{
+public:
+    SchedulerStatistics();
+
+    // Number of tasks that became runnable.
+    uint32_t admitted[NUM_PRIORITIES];
+    // Number of task executions.
+    uint32_t runs[NUM_PRIORITIES];
+    /**
+     * Number of activations that missed their deadline: they completed (stopped running)
+     * after it, or were still queued past it at the end of an overloaded update.
+     * Every activation is counted at most once.
+     */
+    uint32_t deadlineMisses[NUM_PRIORITIES];
+    // Number of updates that ended with running tasks that didn't get to run in that update.
+    uint32_t overloadedUpdates;
 };
 
-// TODO: Add a SchedulingPolicy template parameter.
+/**
+ * @brief The Scheduler executes running tasks cooperatively until a time budget is spent.
+ * The execution order of the running tasks is determined by a SchedulingPolicy.
+ * By default, the task with the least accumulated runtime is executed first (FairSharePolicy).
+ * Priority classes and deadlines are honored when using a DeadlinePolicy.
+ */
 class Scheduler : private TaskListener
 {
 public:
-    typedef std::set<Task*, TaskComparator> TaskList;
+    static const HighResolutionTime::Timestamp DEFAULT_RUNTIME_HALF_LIFE = 500000;
 
     Scheduler();
+    // The __policy__ must outlive the scheduler.
+    explicit Scheduler(SchedulingPolicy* policy);
+    virtual ~Scheduler();
 
     void setListener(SchedulerListener* listener);
+
+    // Records task executions, status changes and budget overruns into __tracer__.
+    // NULL disables tracing. The __tracer__ must outlive the scheduler.
+    void setTracer(SchedulerTracer* tracer);
+
     void clear();
+    /**
+     * @brief enqueue adds __task__ to the tasks of the scheduler based on its status.
+     * Dormant tasks are started. The task that is currently being executed may be enqueued
+     * from within its own execution (e.g. by a parent restarting it). It is then started again
+     * after it returns, unless it terminated.
+     */
     void enqueue(Task* task);
+
+    /**
+     * @brief dequeue removes __task__ from the scheduler without changing its status.
+     * The task that is currently being executed isn't re-inserted after it returns.
+     */
     void dequeue(Task* task);
+    bool hasRunningTasks() const;
+
+    /**
+     * @brief post requests __enqueue__(__task__) from another thread. Thread-safe and lock-free.
+     * The request is applied when the scheduler drains its inbox at the start of __update__.
+     * The task mustn't be accessed by other threads until then.
+     */
+    void post(Task* task);
+
+    /**
+     * @brief postStatus requests __task__->setStatus(__status__) from another thread.
+     * Thread-safe and lock-free. If a task is posted multiple times before the inbox is
+     * drained, only the last request is applied. Tasks can't be put to sleep this way,
+     * because their wake time would be shared between threads.
+     */
+    void postStatus(Task* task, Status status);
+
+    // Applies the posted requests. Called by __update__ and __clear__.
+    void drainInbox();
+
+    // Moves sleeping tasks that are due at __time__ to the running tasks.
+    // Called by __update__.
+    void wakeSleepingTasks(HighResolutionTime::Timestamp time);
+
+    /**
+     * @brief setRuntimeHalfLife sets the time after which the accumulated runtime of tasks
+     * is halved. Without decay, a task that was busy once would stay behind all other tasks
+     * indefinitely. 0 disables the decay.
+     */
+    void setRuntimeHalfLife(HighResolutionTime::Timestamp halfLife);
+
+    /**
+     * @brief setBudgetController lets __controller__ decide the budget of each update based on
+     * __dt__. Tasks that are predicted not to fit into the remaining budget are deferred to the
+     * next update, unless no task was executed yet. NULL restores the fixed budget.
+     * The __controller__ must outlive the scheduler.
+     */
+    void setBudgetController(BudgetController* controller);
 
     // @returns Number of microseconds spent computing during this call.
     HighResolutionTime::Timestamp update(HighResolutionTime::Timestamp maxRuntime, float dt);
     virtual void onStatusChanged(Task* task, Status from);
+
+    const SchedulerStatistics& getStatistics() const;
+    void resetStatistics();
+
+    /**
+     * @brief validate checks that every task is part of exactly the set matching its status
+     * (running, waiting or sleeping) and is listened to by this scheduler.
+     * Costs O(number of tasks).
+     * @return false if the state is inconsistent or the policy can't enumerate its tasks.
+     */
+    bool validate() const;
+
+    // Validates the state before and after every update. Failures trigger an assertion.
+    void setValidating(bool validating);
 private:
+    Scheduler(const Scheduler&);
+    Scheduler& operator=(const Scheduler&);
+
     void removeWaiting(Task* task);
     void removeRunning(Task* task);
-    void removeFrom(TaskList& list, Task* task);
+    void removeSleeping(Task* task);
+    void notifyRemoved(Task* task);
+    void advanceRuntimeEpoch(HighResolutionTime::Timestamp time);
+    void activate(Task* task);
+    // Counts @param task__ as queued again after it ran in the current update.
+    void markRanQueued(Task* task);
+    // Counts the missed deadlines of the queued tasks that are overdue at @param time__.
+    void countOverdueTasks(HighResolutionTime::Timestamp time);
+    void finishCurrent(Task* task,
+                       HighResolutionTime::Timestamp start,
+                       HighResolutionTime::Timestamp duration);
+
+    // What happens to the executing task after it returns.
+    enum CurrentRequest
+    {
+        CurrentContinue = 0,
+        CurrentRestart,
+        CurrentRemove
+    };
 
-    TaskList mTasks;
-    TaskList mWaiting;
+    FairSharePolicy mDefaultPolicy;
+    SchedulingPolicy* mPolicy;
+    TaskQueue mWaiting;
     SchedulerListener* mListener;
+    HighResolutionTime::Timestamp mRuntimeHalfLife;
+    HighResolutionTime::Timestamp mLastDecay;
+    uint32_t mRuntimeEpoch;
+    TimerWheel* mTimers;
+    BudgetController* mBudget;
+    SchedulerTracer* mTracer;
+    Task* mCurrent;
+    uint8_t mCurrentRequest;
+    bool mValidating;
+    SchedulerStatistics mStatistics;
+    // Identifies the current update. Tasks that ran in it and were queued again carry it.
+    uint32_t mUpdateStamp;
+    // The number of queued tasks that already ran in the current update.
+    size_t mNumRanQueued;
+    // Scratch space for the overdue tasks of an overloaded update.
+    std::vector<Task*> mOverdue;
+    TaskInbox mInbox;
 };
 
 END_NS_AILIB
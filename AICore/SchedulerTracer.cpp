@@ -0,0 +1,256 @@
+#include "SchedulerTracer.h"
+#include <fstream>
+
+BEGIN_NS_AILIB
+
+namespace
+{
+    // Tracers are identified by a unique id rather than their address, so a thread's cached
+    // buffer is never mistaken for a buffer of a new tracer at the same address.
+    std::atomic<uint64_t> sNextTracerId(1);
+
+    struct CachedBuffer
+    {
+        uint64_t tracerId;
+        void* buffer;
+    };
+
+    thread_local CachedBuffer sCachedBuffer = { 0, NULL };
+
+    const char* statusName(uint8_t status)
+    {
+        static const char* const names[] = { "Dormant", "Running", "Waiting", "Terminated", "Sleeping" };
+        return status < sizeof(names) / sizeof(names[0]) ? names[status] : "Unknown";
+    }
+
+    void writeString(std::ostream& stream, const char* str)
+    {
+        stream << '"';
+        for(; str && *str; ++str)
+        {
+            const char c = *str;
+            if(c == '"' || c == '\\')
+            {
+                stream << '\\' << c;
+            }
+            else if(static_cast<unsigned char>(c) < 0x20)
+            {
+                stream << ' ';
+            }
+            else
+            {
+                stream << c;
+            }
+        }
+        stream << '"';
+    }
+}
+
+SchedulerTracer::Buffer::Buffer(uint32_t capacity, uint32_t threadIndex) :
+    events(capacity),
+    numWritten(0),
+    threadIndex(threadIndex),
+    thread(std::this_thread::get_id())
+{
+    ;
+}
+
+SchedulerTracer::SchedulerTracer(uint32_t capacity) :
+    mCapacity(capacity),
+    mId(sNextTracerId++),
+    mEnabled(true)
+{
+    AI_ASSERT(capacity > 0, "The trace buffers must hold at least one event.");
+}
+
+SchedulerTracer::~SchedulerTracer()
+{
+    for(std::vector<Buffer*>::iterator it = mBuffers.begin(); it != mBuffers.end(); ++it)
+    {
+        delete *it;
+    }
+}
+
+void SchedulerTracer::setEnabled(bool enabled)
+{
+    mEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool SchedulerTracer::isEnabled() const
+{
+    return mEnabled.load(std::memory_order_relaxed);
+}
+
+void SchedulerTracer::recordRun(const Task* task,
+                                HighResolutionTime::Timestamp start,
+                                HighResolutionTime::Timestamp duration)
+{
+    Event* event = allocate();
+    if(event)
+    {
+        event->time = start;
+        event->duration = duration;
+        event->task = task;
+        event->name = task->getName();
+        event->type = EventRun;
+    }
+}
+
+void SchedulerTracer::recordStatusChange(const Task* task, Status from, Status to)
+{
+    Event* event = allocate();
+    if(event)
+    {
+        event->time = HighResolutionTime::now();
+        event->duration = 0;
+        event->task = task;
+        event->name = task->getName();
+        event->type = EventStatusChange;
+        event->from = static_cast<uint8_t>(from);
+        event->to = static_cast<uint8_t>(to);
+    }
+}
+
+void SchedulerTracer::recordUpdate(HighResolutionTime::Timestamp start,
+                                   HighResolutionTime::Timestamp duration,
+                                   HighResolutionTime::Timestamp budget)
+{
+    Event* event = allocate();
+    if(!event)
+    {
+        return;
+    }
+
+    event->time = start;
+    event->duration = duration;
+    event->task = NULL;
+    event->name = "Scheduler::update";
+    event->type = EventUpdate;
+
+    if(duration > budget && (event = allocate()) != NULL)
+    {
+        event->time = start + duration;
+        event->duration = duration - budget;
+        event->task = NULL;
+        event->name = "Budget exceeded";
+        event->type = EventBudgetExceeded;
+    }
+}
+
+void SchedulerTracer::write(std::ostream& stream) const
+{
+    std::lock_guard<std::mutex> guard(mBufferLock);
+
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for(std::vector<Buffer*>::const_iterator it = mBuffers.begin(); it != mBuffers.end(); ++it)
+    {
+        const Buffer& buffer = **it;
+
+        // Oldest event first.
+        const uint64_t begin = buffer.numWritten > mCapacity ? buffer.numWritten - mCapacity : 0;
+        for(uint64_t i = begin; i < buffer.numWritten; ++i)
+        {
+            if(!first)
+            {
+                stream << ',';
+            }
+            first = false;
+            writeEvent(stream, buffer.events[i % mCapacity], buffer.threadIndex);
+        }
+    }
+    stream << "]}\n";
+}
+
+bool SchedulerTracer::write(const char* path) const
+{
+    std::ofstream file(path);
+    if(!file)
+    {
+        return false;
+    }
+    write(file);
+    return file.good();
+}
+
+void SchedulerTracer::clear()
+{
+    std::lock_guard<std::mutex> guard(mBufferLock);
+    for(std::vector<Buffer*>::iterator it = mBuffers.begin(); it != mBuffers.end(); ++it)
+    {
+        (*it)->numWritten = 0;
+    }
+}
+
+SchedulerTracer::Event* SchedulerTracer::allocate()
+{
+    if(!isEnabled())
+    {
+        return NULL;
+    }
+
+    Buffer* buffer = getBuffer();
+    return &buffer->events[buffer->numWritten++ % mCapacity];
+}
+
+SchedulerTracer::Buffer* SchedulerTracer::getBuffer()
+{
+    if(LIKELY(sCachedBuffer.tracerId == mId))
+    {
+        return static_cast<Buffer*>(sCachedBuffer.buffer);
+    }
+
+    // Slow path, taken when a thread switches between tracers.
+    std::lock_guard<std::mutex> guard(mBufferLock);
+
+    const std::thread::id thread = std::this_thread::get_id();
+    Buffer* buffer = NULL;
+    for(std::vector<Buffer*>::const_iterator it = mBuffers.begin(); it != mBuffers.end(); ++it)
+    {
+        if((*it)->thread == thread)
+        {
+            buffer = *it;
+            break;
+        }
+    }
+
+    if(!buffer)
+    {
+        buffer = new Buffer(mCapacity, static_cast<uint32_t>(mBuffers.size()));
+        mBuffers.push_back(buffer);
+    }
+
+    sCachedBuffer.tracerId = mId;
+    sCachedBuffer.buffer = buffer;
+    return buffer;
+}
+
+void SchedulerTracer::writeEvent(std::ostream& stream, const Event& event, uint32_t threadIndex)
+{
+    stream << "{\"pid\":0,\"tid\":" << threadIndex << ",\"ts\":" << event.time << ",\"name\":";
+    writeString(stream, event.name);
+
+    switch(event.type)
+    {
+    case EventRun:
+        stream << ",\"cat\":\"task\",\"ph\":\"X\",\"dur\":" << event.duration
+               << ",\"args\":{\"task\":\"" << event.task << "\"}";
+        break;
+    case EventStatusChange:
+        stream << ",\"cat\":\"status\",\"ph\":\"i\",\"s\":\"t\""
+               << ",\"args\":{\"task\":\"" << event.task << "\""
+               << ",\"from\":\"" << statusName(event.from) << "\""
+               << ",\"to\":\"" << statusName(event.to) << "\"}";
+        break;
+    case EventUpdate:
+        stream << ",\"cat\":\"scheduler\",\"ph\":\"X\",\"dur\":" << event.duration;
+        break;
+    case EventBudgetExceeded:
+        stream << ",\"cat\":\"scheduler\",\"ph\":\"i\",\"s\":\"p\""
+               << ",\"args\":{\"overrun\":" << event.duration << "}";
+        break;
+    }
+    stream << '}';
+}
+
+END_NS_AILIB
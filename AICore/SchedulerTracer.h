@@ -0,0 +1,110 @@
+#ifndef SCHEDULERTRACER_H
+#define SCHEDULERTRACER_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "Task.h"
+#include "HighResolutionTime.h"
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// Defining AI_DISABLE_TRACING removes all tracing calls from the schedulers.
+#ifdef AI_DISABLE_TRACING
+    #define AI_TRACE(tracer__, call__) do { } while(0)
+#else
+    #define AI_TRACE(tracer__, call__) \
+        do { if(UNLIKELY((tracer__) != NULL)) { (tracer__)->call__; } } while(0)
+#endif
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief SchedulerTracer records what the schedulers spend their time on and writes it in the
+ * Chrome trace event format, which can be viewed in chrome://tracing or ui.perfetto.dev.
+ *
+ * Every thread records into its own fixed-size ring buffer without locking. When a buffer is
+ * full, the oldest events are overwritten. The buffers must only be written out or cleared
+ * while no scheduler is updating.
+ *
+ * Task names are taken from Task::getName and must remain valid until the trace is written.
+ */
+class SchedulerTracer
+{
+public:
+    static const uint32_t DEFAULT_CAPACITY = 1 << 16;
+
+    // __capacity__ is the number of events each thread's buffer can hold.
+    explicit SchedulerTracer(uint32_t capacity = DEFAULT_CAPACITY);
+    ~SchedulerTracer();
+
+    // Disabled tracers drop all events.
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    void recordRun(const Task* task,
+                   HighResolutionTime::Timestamp start,
+                   HighResolutionTime::Timestamp duration);
+    void recordStatusChange(const Task* task, Status from, Status to);
+    void recordUpdate(HighResolutionTime::Timestamp start,
+                      HighResolutionTime::Timestamp duration,
+                      HighResolutionTime::Timestamp budget);
+
+    // Writes all recorded events as a Chrome trace JSON object.
+    void write(std::ostream& stream) const;
+    // @returns false if the file couldn't be written.
+    bool write(const char* path) const;
+    void clear();
+private:
+    SchedulerTracer(const SchedulerTracer&);
+    SchedulerTracer& operator=(const SchedulerTracer&);
+
+    enum EventType
+    {
+        EventRun = 0,
+        EventStatusChange,
+        EventUpdate,
+        EventBudgetExceeded
+    };
+
+    class Event
+    {
+    public:
+        HighResolutionTime::Timestamp time;
+        HighResolutionTime::Timestamp duration;
+        const void* task;
+        const char* name;
+        uint8_t type;
+        uint8_t from;
+        uint8_t to;
+    };
+
+    class Buffer
+    {
+    public:
+        Buffer(uint32_t capacity, uint32_t threadIndex);
+
+        std::vector<Event> events;
+        uint64_t numWritten;
+        uint32_t threadIndex;
+        std::thread::id thread;
+    };
+
+    Event* allocate();
+    Buffer* getBuffer();
+    static void writeEvent(std::ostream& stream, const Event& event, uint32_t threadIndex);
+
+    const uint32_t mCapacity;
+    const uint64_t mId;
+    std::atomic<bool> mEnabled;
+
+    mutable std::mutex mBufferLock;
+    std::vector<Buffer*> mBuffers;
+};
+
+END_NS_AILIB
+
+#endif // SCHEDULERTRACER_H
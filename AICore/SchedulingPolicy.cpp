@@ -0,0 +1,323 @@
+#include "SchedulingPolicy.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+BEGIN_NS_AILIB
+
+SchedulingPolicy::~SchedulingPolicy()
+{
+    ;
+}
+
+void SchedulingPolicy::decay(uint32_t halvings)
+{
+    UNUSED(halvings);
+}
+
+bool SchedulingPolicy::getTasks(std::vector<Task*>& tasks) const
+{
+    UNUSED(tasks);
+    return false;
+}
+
+void SchedulingPolicy::getOverdue(HighResolutionTime::Timestamp time,
+                                  std::vector<Task*>& tasks) const
+{
+    const size_t first = tasks.size();
+    getTasks(tasks);
+
+    size_t kept = first;
+    for(size_t i = first; i < tasks.size(); ++i)
+    {
+        if(tasks[i]->getDeadline() != 0 && tasks[i]->getDeadline() < time)
+        {
+            tasks[kept++] = tasks[i];
+        }
+    }
+    tasks.resize(kept);
+}
+
+FairSharePolicy::FairSharePolicy() :
+    mSize(0)
+{
+    std::memset(mOccupied, 0, sizeof(mOccupied));
+}
+
+FairSharePolicy::~FairSharePolicy()
+{
+    ;
+}
+
+void FairSharePolicy::push(Task* task)
+{
+    const uint32_t bucket = bucketOf(task->getRuntime());
+    mBuckets[bucket].pushBack(task);
+    mOccupied[bucket / 64] |= uint64_t(1) << (bucket % 64);
+    ++mSize;
+}
+
+void FairSharePolicy::remove(Task* task)
+{
+    AI_ASSERT(mSize > 0, "Tried to remove a task from an empty policy.");
+    AI_ASSERT(TaskQueue::isQueued(task), "Couldn't find task to erase.");
+
+    TaskQueue* emptied = TaskQueue::remove(task);
+    if(emptied)
+    {
+        const uint32_t bucket = static_cast<uint32_t>(emptied - mBuckets);
+        AI_ASSERT(bucket < NUM_BUCKETS, "The task wasn't part of this policy.");
+        mOccupied[bucket / 64] &= ~(uint64_t(1) << (bucket % 64));
+    }
+    --mSize;
+}
+
+Task* FairSharePolicy::top() const
+{
+    for(uint32_t i = 0; i < NUM_WORDS; ++i)
+    {
+        if(mOccupied[i])
+        {
+            return mBuckets[i * 64 + findFirstSet(mOccupied[i])].front();
+        }
+    }
+    return NULL;
+}
+
+size_t FairSharePolicy::size() const
+{
+    return mSize;
+}
+
+void FairSharePolicy::decay(uint32_t halvings)
+{
+    // Every runtime reaches zero after 32 halvings.
+    halvings = std::min(halvings, 32u);
+
+    for(uint32_t h = 0; h < halvings; ++h)
+    {
+        // Buckets only move downwards, so a snapshot of each word's bits is sufficient.
+        for(uint32_t i = 0; i < NUM_WORDS; ++i)
+        {
+            uint64_t occupied = mOccupied[i];
+            while(occupied)
+            {
+                const uint32_t bucket = i * 64 + findFirstSet(occupied);
+                occupied &= occupied - 1;
+
+                if(bucket == 0)
+                {
+                    continue;
+                }
+
+                // See bucketOf: Values below 8 map to themselves, above that halving
+                // decreases the octave by one.
+                const uint32_t target = bucket < 8 ? bucket / 2 : bucket - 4;
+                mBuckets[target].splice(mBuckets[bucket]);
+                mOccupied[i] &= ~(uint64_t(1) << (bucket % 64));
+                mOccupied[target / 64] |= uint64_t(1) << (target % 64);
+            }
+        }
+    }
+}
+
+bool FairSharePolicy::getTasks(std::vector<Task*>& tasks) const
+{
+    for(uint32_t i = 0; i < NUM_BUCKETS; ++i)
+    {
+        mBuckets[i].getTasks(tasks);
+    }
+    return true;
+}
+
+uint32_t FairSharePolicy::bucketOf(HighResolutionTime::Timestamp runtime)
+{
+    if(runtime < 4)
+    {
+        return runtime < 0 ? 0 : static_cast<uint32_t>(runtime);
+    }
+
+    const uint64_t value = static_cast<uint64_t>(std::min<HighResolutionTime::Timestamp>(
+                                runtime, std::numeric_limits<uint32_t>::max()));
+
+    // The two bits below the most significant bit select one of four buckets per octave.
+    const uint32_t msb = findLastSet(value);
+    return (msb - 1) * 4 + static_cast<uint32_t>((value >> (msb - 2)) & 3);
+}
+
+DeadlinePolicy::DeadlinePolicy() :
+    mSize(0)
+{
+    ;
+}
+
+DeadlinePolicy::~DeadlinePolicy()
+{
+    ;
+}
+
+void DeadlinePolicy::push(Task* task)
+{
+    const Priority priority = task->getPriority();
+    if(task->getDeadline() != 0)
+    {
+        DeadlineHeap& heap = mDeadlines[priority];
+        heap.push_back(task);
+        task->setQueueIndex(heap.size() - 1);
+        siftUp(heap, heap.size() - 1);
+    }
+    else
+    {
+        mFairShare[priority].push(task);
+    }
+    ++mSize;
+}
+
+void DeadlinePolicy::remove(Task* task)
+{
+    AI_ASSERT(mSize > 0, "Tried to remove a task from an empty policy.");
+
+    const Priority priority = task->getPriority();
+    if(task->getDeadline() != 0)
+    {
+        DeadlineHeap& heap = mDeadlines[priority];
+        const uint32_t idx = task->getQueueIndex();
+        AI_ASSERT(idx < heap.size() && heap[idx] == task,
+                  "The task's deadline or priority changed while it was queued.");
+
+        Task* last = heap.back();
+        heap.pop_back();
+        if(last != task)
+        {
+            place(heap, idx, last);
+            siftUp(heap, idx);
+            siftDown(heap, last->getQueueIndex());
+        }
+    }
+    else
+    {
+        mFairShare[priority].remove(task);
+    }
+    --mSize;
+}
+
+Task* DeadlinePolicy::top() const
+{
+    for(uint32_t i = 0; i < NUM_PRIORITIES; ++i)
+    {
+        if(!mDeadlines[i].empty())
+        {
+            return mDeadlines[i].front();
+        }
+
+        if(!mFairShare[i].empty())
+        {
+            return mFairShare[i].top();
+        }
+    }
+    return NULL;
+}
+
+size_t DeadlinePolicy::size() const
+{
+    return mSize;
+}
+
+size_t DeadlinePolicy::size(Priority priority) const
+{
+    return mDeadlines[priority].size() + mFairShare[priority].size();
+}
+
+void DeadlinePolicy::decay(uint32_t halvings)
+{
+    for(uint32_t i = 0; i < NUM_PRIORITIES; ++i)
+    {
+        mFairShare[i].decay(halvings);
+    }
+}
+
+bool DeadlinePolicy::getTasks(std::vector<Task*>& tasks) const
+{
+    for(uint32_t i = 0; i < NUM_PRIORITIES; ++i)
+    {
+        tasks.insert(tasks.end(), mDeadlines[i].begin(), mDeadlines[i].end());
+        mFairShare[i].getTasks(tasks);
+    }
+    return true;
+}
+
+void DeadlinePolicy::getOverdue(HighResolutionTime::Timestamp time,
+                                std::vector<Task*>& tasks) const
+{
+    // Tasks without a deadline are in the fair-share queues.
+    for(uint32_t i = 0; i < NUM_PRIORITIES; ++i)
+    {
+        appendOverdue(mDeadlines[i], 0, time, tasks);
+    }
+}
+
+void DeadlinePolicy::appendOverdue(const DeadlineHeap& heap,
+                                   uint32_t idx,
+                                   HighResolutionTime::Timestamp time,
+                                   std::vector<Task*>& tasks)
+{
+    // The children of a task that isn't overdue aren't overdue either.
+    if(idx >= heap.size() || heap[idx]->getDeadline() >= time)
+    {
+        return;
+    }
+    tasks.push_back(heap[idx]);
+    appendOverdue(heap, 2 * idx + 1, time, tasks);
+    appendOverdue(heap, 2 * idx + 2, time, tasks);
+}
+
+void DeadlinePolicy::siftUp(DeadlineHeap& heap, uint32_t idx)
+{
+    Task* task = heap[idx];
+    while(idx > 0)
+    {
+        const uint32_t parent = (idx - 1) / 2;
+        if(heap[parent]->getDeadline() <= task->getDeadline())
+        {
+            break;
+        }
+        place(heap, idx, heap[parent]);
+        idx = parent;
+    }
+    place(heap, idx, task);
+}
+
+void DeadlinePolicy::siftDown(DeadlineHeap& heap, uint32_t idx)
+{
+    Task* task = heap[idx];
+    const uint32_t size = heap.size();
+    for(;;)
+    {
+        uint32_t child = 2 * idx + 1;
+        if(child >= size)
+        {
+            break;
+        }
+
+        if(child + 1 < size && heap[child + 1]->getDeadline() < heap[child]->getDeadline())
+        {
+            ++child;
+        }
+
+        if(task->getDeadline() <= heap[child]->getDeadline())
+        {
+            break;
+        }
+        place(heap, idx, heap[child]);
+        idx = child;
+    }
+    place(heap, idx, task);
+}
+
+void DeadlinePolicy::place(DeadlineHeap& heap, uint32_t idx, Task* task)
+{
+    heap[idx] = task;
+    task->setQueueIndex(idx);
+}
+
+END_NS_AILIB
@@ -0,0 +1,133 @@
+#ifndef SCHEDULINGPOLICY_H
+#define SCHEDULINGPOLICY_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "Task.h"
+#include <stddef.h>
+#include <vector>
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief SchedulingPolicy decides in which order the Scheduler executes its running tasks.
+ * The scheduler pushes every task that becomes runnable and removes it again before the
+ * task is executed, terminated or put to wait.
+ */
+class SchedulingPolicy
+{
+public:
+    virtual ~SchedulingPolicy();
+
+    virtual void push(Task* task) = 0;
+    virtual void remove(Task* task) = 0;
+
+    // @returns The task that should be executed next. NULL if the policy is empty.
+    virtual Task* top() const = 0;
+    virtual size_t size() const = 0;
+
+    // Called when the scheduler halves the runtime of all tasks __halvings__ times.
+    // Queued tasks are decayed lazily when they are pushed the next time.
+    virtual void decay(uint32_t halvings);
+
+    /**
+     * @brief getTasks appends all queued tasks to __tasks__, in no particular order.
+     * Used to validate the scheduler's state.
+     * @return false if the policy doesn't support enumerating its tasks.
+     */
+    virtual bool getTasks(std::vector<Task*>& /* out */ tasks) const;
+
+    /**
+     * @brief getOverdue appends the queued tasks whose deadline is before __time__ to
+     * __tasks__. By default, all tasks are enumerated with getTasks.
+     */
+    virtual void getOverdue(HighResolutionTime::Timestamp time,
+                            std::vector<Task*>& /* out */ tasks) const;
+
+    FORCE_INLINE bool empty() const
+    {
+        return size() == 0;
+    }
+};
+
+/**
+ * @brief FairSharePolicy executes the task with the least accumulated runtime first.
+ *
+ * Tasks are kept in a calendar queue of intrusive FIFO buckets indexed by their runtime on a
+ * log-linear scale (4 buckets per power of two). Tasks with similar runtimes share a bucket
+ * and are executed round-robin. A bitmap of the non-empty buckets finds the
+ * next task in constant time. Pushing and removing tasks never allocates.
+ * Halving all runtimes moves every bucket down by one octave (4 buckets), so decaying
+ * the queued tasks costs O(NUM_BUCKETS) regardless of the number of tasks.
+ */
+class FairSharePolicy : public SchedulingPolicy
+{
+public:
+    static const uint32_t NUM_BUCKETS = 128;
+
+    FairSharePolicy();
+    virtual ~FairSharePolicy();
+
+    virtual void push(Task* task);
+    virtual void remove(Task* task);
+    virtual Task* top() const;
+    virtual size_t size() const;
+    virtual void decay(uint32_t halvings);
+    virtual bool getTasks(std::vector<Task*>& /* out */ tasks) const;
+
+    static uint32_t bucketOf(HighResolutionTime::Timestamp runtime);
+private:
+    static const uint32_t NUM_WORDS = NUM_BUCKETS / 64;
+
+    TaskQueue mBuckets[NUM_BUCKETS];
+    uint64_t mOccupied[NUM_WORDS];
+    size_t mSize;
+};
+
+/**
+ * @brief DeadlinePolicy executes tasks by strict priority class. Within a class, tasks with
+ * a deadline are executed earliest-deadline-first, followed by the remaining tasks in
+ * fair-share order.
+ *
+ * Lower classes only run once all higher classes are idle. When the scheduler's budget is
+ * exhausted under overload, the least important work is therefore shed first instead of
+ * delaying every task.
+ */
+class DeadlinePolicy : public SchedulingPolicy
+{
+public:
+    DeadlinePolicy();
+    virtual ~DeadlinePolicy();
+
+    virtual void push(Task* task);
+    virtual void remove(Task* task);
+    virtual Task* top() const;
+    virtual size_t size() const;
+    virtual void decay(uint32_t halvings);
+    virtual bool getTasks(std::vector<Task*>& /* out */ tasks) const;
+    // Only visits the overdue part of the deadline heaps.
+    virtual void getOverdue(HighResolutionTime::Timestamp time,
+                            std::vector<Task*>& /* out */ tasks) const;
+
+    size_t size(Priority priority) const;
+private:
+    typedef std::vector<Task*> DeadlineHeap;
+
+    // Binary min-heap on the deadline. Tasks store their heap position as queue index.
+    void siftUp(DeadlineHeap& heap, uint32_t idx);
+    void siftDown(DeadlineHeap& heap, uint32_t idx);
+    void place(DeadlineHeap& heap, uint32_t idx, Task* task);
+    static void appendOverdue(const DeadlineHeap& heap,
+                              uint32_t idx,
+                              HighResolutionTime::Timestamp time,
+                              std::vector<Task*>& /* out */ tasks);
+
+    DeadlineHeap mDeadlines[NUM_PRIORITIES];
+    FairSharePolicy mFairShare[NUM_PRIORITIES];
+    size_t mSize;
+};
+
+END_NS_AILIB
+
+#endif // SCHEDULINGPOLICY_H
@@ -1,4 +1,6 @@
 #include "Task.h"
+#include <algorithm>
+#include <limits>
 
 BEGIN_NS_AILIB
 
@@ -7,17 +9,79 @@ TaskListener::~TaskListener()
 
 }
 
+TaskHook::TaskHook() :
+    mNext(this),
+    mPrev(this)
+{
+    ;
+}
+
+TaskHook::TaskHook(const TaskHook& other) :
+    mNext(this),
+    mPrev(this)
+{
+    UNUSED(other);
+}
+
+TaskHook& TaskHook::operator=(const TaskHook& other)
+{
+    // Keep the current links. Queue membership is not part of a task's value.
+    UNUSED(other);
+    return *this;
+}
+
+TaskInboxHook::TaskInboxHook() :
+    mInboxNext(NULL),
+    mInboxRequest(0),
+    mInboxQueued(false)
+{
+    ;
+}
+
+TaskInboxHook::TaskInboxHook(const TaskInboxHook& other) :
+    mInboxNext(NULL),
+    mInboxRequest(0),
+    mInboxQueued(false)
+{
+    UNUSED(other);
+}
+
+TaskInboxHook& TaskInboxHook::operator=(const TaskInboxHook& other)
+{
+    // Pending requests belong to the task's identity, not to its value.
+    UNUSED(other);
+    return *this;
+}
+
 Task::Task() :
     mListener(0),
+    mName("Task"),
+    mWakeTime(0),
+    mDeadline(0),
+    mPeriod(0),
+    mQueueIndex(0),
+    mRunEstimate(0),
+    mRunDeviation(0),
     mRuntime(0),
-    mStatus(StatusDormant)
+    mRuntimeEpoch(0),
+    mStatus(StatusDormant),
+    mPriority(PriorityNormal),
+    mNumRunSamples(0),
+    mDeadlineMissed(false),
+    mUpdateStamp(0)
 {
     ;
 }
 
 Task::~Task()
 {
-    ;
+    AI_ASSERT(!TaskQueue::isQueued(this), "Destroyed a task that is still queued.");
+}
+
+void Task::setName(const char* name)
+{
+    AI_ASSERT(name, "Tasks must have a name.");
+    mName = name;
 }
 
 void Task::setListener(TaskListener* listener)
@@ -25,14 +89,19 @@ void Task::setListener(TaskListener* listener)
     mListener = listener;
 }
 
+TaskListener* Task::getListener() const
+{
+    return mListener;
+}
+
 Status Task::getStatus() const
 {
-    return mStatus;
+    return static_cast<Status>(mStatus);
 }
 
 void Task::setStatus(Status status)
 {
-    Status before = mStatus;
+    Status before = getStatus();
     if(status != before)
     {
         mStatus = status;
@@ -46,16 +115,14 @@ void Task::setStatus(Status status)
 
 void Task::addRuntime(const HighResolutionTime::Timestamp& runtime)
 {
-    // TODO: We could improve this by changing the runtime scale towards longer computation times.
-
-    // The runtime counter overflows after 2^16 microseconds (which is approx. 65 ms).
-    // This is fine for our purposes, since the 65 ms represent actual computation time.
-    // The only penalty for overflowing is that this task may get execution priority over other
-    // tasks. We accept this penalty in order to save (up to) 6 bytes per task over the maximum
-    // resolution (uint64_t).
-    // Note that most longer running tasks will be blocking (eg. waiting for other systems' inputs).
-    // This wait time is not counted towards runtime, which further alleviates this issue.
-    mRuntime += runtime;
+    // The runtime counter saturates after 2^32 microseconds (approx. 71 minutes of pure
+    // computation time). A wrapping counter would give long-running tasks execution priority
+    // over all other tasks. The scheduler's runtime decay keeps the counter well below the
+    // limit in practice.
+    const HighResolutionTime::Timestamp total = static_cast<HighResolutionTime::Timestamp>(mRuntime) +
+                                                std::max<HighResolutionTime::Timestamp>(runtime, 0);
+    mRuntime = static_cast<uint32_t>(std::min<HighResolutionTime::Timestamp>(
+                                         total, std::numeric_limits<uint32_t>::max()));
 }
 
 void Task::resetRuntime()
@@ -68,4 +135,142 @@ HighResolutionTime::Timestamp Task::getRuntime() const
     return mRuntime;
 }
 
+void Task::decayRuntime(uint32_t epoch)
+{
+    // 32 bit epochs only wrap around after 2^32 half-lives (68 years at the default
+    // half-life), so a task that was idle for long is never mistaken for a current one.
+    const uint32_t elapsed = epoch - mRuntimeEpoch;
+    mRuntime = elapsed >= 32 ? 0 : mRuntime >> elapsed;
+    mRuntimeEpoch = epoch;
+}
+
+namespace
+{
+    const uint32_t RUN_SAMPLE_FRACTION_BITS = 4;
+    // The averages move by 1/2^RUN_SAMPLE_WEIGHT_BITS of the error per sample.
+    const uint32_t RUN_SAMPLE_WEIGHT_BITS = 3;
+}
+
+void Task::addRunSample(HighResolutionTime::Timestamp duration)
+{
+    // Samples are clamped to 2^27 microseconds, so the fixed-point values fit into 32 bits.
+    const int64_t sample = std::min<int64_t>(std::max<int64_t>(duration, 0), int64_t(1) << 27)
+                           << RUN_SAMPLE_FRACTION_BITS;
+
+    if(mNumRunSamples == 0)
+    {
+        // Seed the average with the first sample, instead of approaching it from zero.
+        mRunEstimate = static_cast<uint32_t>(sample);
+        mRunDeviation = static_cast<uint32_t>(sample / 2);
+    }
+    else
+    {
+        const int64_t error = sample - mRunEstimate;
+        const int64_t deviation = (error < 0 ? -error : error) - mRunDeviation;
+        mRunEstimate = static_cast<uint32_t>(mRunEstimate + (error >> RUN_SAMPLE_WEIGHT_BITS));
+        mRunDeviation = static_cast<uint32_t>(mRunDeviation + (deviation >> RUN_SAMPLE_WEIGHT_BITS));
+    }
+
+    if(mNumRunSamples < std::numeric_limits<uint8_t>::max())
+    {
+        ++mNumRunSamples;
+    }
+}
+
+HighResolutionTime::Timestamp Task::getRunEstimate() const
+{
+    return mRunEstimate >> RUN_SAMPLE_FRACTION_BITS;
+}
+
+HighResolutionTime::Timestamp Task::getRunDeviation() const
+{
+    return mRunDeviation >> RUN_SAMPLE_FRACTION_BITS;
+}
+
+uint32_t Task::getNumRunSamples() const
+{
+    return mNumRunSamples;
+}
+
+TaskQueue::TaskQueue()
+{
+    ;
+}
+
+TaskQueue::~TaskQueue()
+{
+    // Unlink the remaining tasks, so they can be queued elsewhere.
+    while(!empty())
+    {
+        popFront();
+    }
+}
+
+void TaskQueue::getTasks(std::vector<Task*>& tasks) const
+{
+    for(const TaskHook* hook = mHead.mNext; hook != &mHead; hook = hook->mNext)
+    {
+        tasks.push_back(static_cast<Task*>(const_cast<TaskHook*>(hook)));
+    }
+}
+
+void Task::sleepUntil(HighResolutionTime::Timestamp time)
+{
+    if(getStatus() == StatusSleeping)
+    {
+        // Wake up first, so the listener re-inserts the task with its new wake time.
+        setStatus(StatusRunning);
+    }
+
+    mWakeTime = time;
+    setStatus(StatusSleeping);
+}
+
+void Task::sleepFor(HighResolutionTime::Timestamp duration)
+{
+    sleepUntil(HighResolutionTime::now() + duration);
+}
+
+HighResolutionTime::Timestamp Task::getWakeTime() const
+{
+    return mWakeTime;
+}
+
+void Task::setPriority(Priority priority)
+{
+    AI_ASSERT(static_cast<uint32_t>(priority) < NUM_PRIORITIES, "Invalid priority class.");
+    // Attached running tasks are part of the scheduler's policy, which is keyed by priority.
+    // The executing task has no listener.
+    AI_ASSERT(priority == mPriority || !mListener || mStatus != StatusRunning,
+              "Tried to change the priority of a queued task.");
+    mPriority = priority;
+}
+
+Priority Task::getPriority() const
+{
+    return static_cast<Priority>(mPriority);
+}
+
+void Task::setDeadline(HighResolutionTime::Timestamp deadline)
+{
+    mDeadline = deadline;
+}
+
+HighResolutionTime::Timestamp Task::getDeadline() const
+{
+    return mDeadline;
+}
+
+void Task::setPeriod(HighResolutionTime::Timestamp period)
+{
+    AI_ASSERT(period >= 0 && period <= std::numeric_limits<uint32_t>::max(),
+              "The period must fit into 32 bits of microseconds.");
+    mPeriod = static_cast<uint32_t>(period);
+}
+
+HighResolutionTime::Timestamp Task::getPeriod() const
+{
+    return mPeriod;
+}
+
 END_NS_AILIB
@@ -5,6 +5,9 @@
 
 #include "ai_global.h"
 #include "HighResolutionTime.h"
+#include <stddef.h>
+#include <atomic>
+#include <vector>
 
 BEGIN_NS_AILIB
 
@@ -15,9 +18,22 @@ enum Status
     StatusDormant = 0,
     StatusRunning,
     StatusWaiting,
-    StatusTerminated
+    StatusTerminated,
+    StatusSleeping
 };
 
+// Priority classes, from most to least important.
+enum Priority
+{
+    PriorityCritical = 0,
+    PriorityHigh,
+    PriorityNormal,
+    PriorityLow,
+    PriorityIdle
+};
+
+const uint32_t NUM_PRIORITIES = PriorityIdle + 1;
+
 class TaskListener
 {
 public:
@@ -25,24 +41,249 @@ public:
     virtual void onStatusChanged(Task* task, Status from) = 0;
 };
 
-class Task
+/**
+ * @brief TaskHook is the link of an intrusive, circular doubly-linked list.
+ * Embedding the links in the tasks allows the scheduler's queues to insert and remove
+ * tasks in constant time without allocating.
+ */
+class TaskHook
+{
+public:
+    TaskHook();
+    // Copies are never linked into the original's list.
+    TaskHook(const TaskHook& other);
+    TaskHook& operator=(const TaskHook& other);
+
+    FORCE_INLINE bool isLinked() const
+    {
+        return mNext != this;
+    }
+private:
+    friend class TaskQueue;
+
+    TaskHook* mNext;
+    TaskHook* mPrev;
+};
+
+/**
+ * @brief TaskInboxHook is the link of a TaskInbox, a lock-free list of pending
+ * requests from other threads. Only the last request per task is kept.
+ */
+class TaskInboxHook
 {
+public:
+    TaskInboxHook();
+    // Copies have no pending request.
+    TaskInboxHook(const TaskInboxHook& other);
+    TaskInboxHook& operator=(const TaskInboxHook& other);
+private:
+    friend class TaskInbox;
+
+    std::atomic<TaskInboxHook*> mInboxNext;
+    std::atomic<uint8_t> mInboxRequest;
+    std::atomic<bool> mInboxQueued;
+};
+
+class Task : private TaskHook, private TaskInboxHook
+{
+    friend class TaskQueue;
+    friend class TaskInbox;
+    friend class Scheduler;
 public:
     Task();
     virtual ~Task();
 
     virtual void run() = 0;
 
+    /**
+     * @brief setName sets a human readable name for diagnostics (e.g. tracing and profiling).
+     * The name isn't copied and must remain valid while it is in use, e.g. a string literal.
+     * Defaults to "Task", the built-in tasks and behaviors are named after their type.
+     */
+    void setName(const char* name);
+
+    FORCE_INLINE const char* getName() const
+    {
+        return mName;
+    }
+
     void setListener(TaskListener* listener);
+    TaskListener* getListener() const;
     Status getStatus() const;
     void setStatus(Status status);
     void addRuntime(const HighResolutionTime::Timestamp& runtime);
     void resetRuntime();
     HighResolutionTime::Timestamp getRuntime() const;
+
+    /**
+     * @brief decayRuntime halves the runtime once per decay epoch that passed since the last
+     * call. The scheduler advances its epoch every runtime half-life, so a task's past
+     * computation time weighs less the longer ago it happened.
+     */
+    void decayRuntime(uint32_t epoch);
+
+    /**
+     * @brief sleepUntil suspends the task until __time__ (see HighResolutionTime::now()).
+     * Sleeping tasks are kept in the scheduler's timer wheel and cost nothing until they are
+     * due. Once due, they continue running. Setting another status wakes them early.
+     */
+    void sleepUntil(HighResolutionTime::Timestamp time);
+    void sleepFor(HighResolutionTime::Timestamp duration);
+    HighResolutionTime::Timestamp getWakeTime() const;
+
+    /**
+     * @brief setPriority sets the priority class, PriorityNormal by default. Only honored by
+     * priority-aware policies (see DeadlinePolicy).
+     * Mustn't be changed while the task is part of a scheduler's running tasks. The executing
+     * task may change its own priority, or dequeue the task, change it and enqueue it again.
+     */
+    void setPriority(Priority priority);
+    Priority getPriority() const;
+
+    /**
+     * @brief setDeadline sets the absolute time by which the task should have completed
+     * its current activation. 0 means the task has no deadline.
+     * Mustn't be changed while the task is part of a scheduler's running tasks.
+     */
+    void setDeadline(HighResolutionTime::Timestamp deadline);
+    HighResolutionTime::Timestamp getDeadline() const;
+
+    /**
+     * @brief setPeriod gives the task a relative deadline. Whenever the task becomes
+     * runnable, the scheduler sets its deadline to the current time plus __period__.
+     * 0 disables the periodic deadline.
+     */
+    void setPeriod(HighResolutionTime::Timestamp period);
+    HighResolutionTime::Timestamp getPeriod() const;
+
+    /**
+     * @brief addRunSample updates the moving averages of the duration and of the deviation
+     * of a single execution of __run__. Used to predict the cost of the next execution.
+     */
+    void addRunSample(HighResolutionTime::Timestamp duration);
+    // @returns The exponentially weighted average duration of one execution, in microseconds.
+    HighResolutionTime::Timestamp getRunEstimate() const;
+    // @returns The exponentially weighted mean absolute deviation of __getRunEstimate__.
+    HighResolutionTime::Timestamp getRunDeviation() const;
+    // @returns The number of recorded executions, saturating at 255.
+    uint32_t getNumRunSamples() const;
+
+    // Reserved for the scheduling policy the task is queued in.
+    FORCE_INLINE uint32_t getQueueIndex() const
+    {
+        return mQueueIndex;
+    }
+
+    FORCE_INLINE void setQueueIndex(uint32_t index)
+    {
+        mQueueIndex = index;
+    }
 private:
     TaskListener* mListener;
-    uint16_t mRuntime; //< in microseconds
-    Status mStatus;
+    const char* mName;
+    HighResolutionTime::Timestamp mWakeTime;
+    HighResolutionTime::Timestamp mDeadline;
+    uint32_t mPeriod;
+    uint32_t mQueueIndex;
+    uint32_t mRunEstimate;  //< fixed-point, RUN_SAMPLE_FRACTION_BITS fraction bits
+    uint32_t mRunDeviation; //< fixed-point, RUN_SAMPLE_FRACTION_BITS fraction bits
+    uint32_t mRuntime; //< in microseconds, saturating
+    uint32_t mRuntimeEpoch;
+    uint8_t mStatus;
+    uint8_t mPriority;
+    uint8_t mNumRunSamples;
+    // Scheduler state: whether the current activation's missed deadline was counted, and the
+    // update in which the task last ran and was queued again.
+    bool mDeadlineMissed;
+    uint32_t mUpdateStamp;
+};
+
+/**
+ * @brief TaskQueue is an intrusive FIFO queue of tasks. A task can only be part of
+ * one queue at a time.
+ */
+class TaskQueue
+{
+public:
+    TaskQueue();
+    ~TaskQueue();
+
+    FORCE_INLINE bool empty() const
+    {
+        return !mHead.isLinked();
+    }
+
+    FORCE_INLINE Task* front() const
+    {
+        AI_ASSERT(!empty(), "The queue is empty.");
+        return static_cast<Task*>(mHead.mNext);
+    }
+
+    FORCE_INLINE void pushBack(Task* task)
+    {
+        AI_ASSERT(!isQueued(task), "The task is already part of a queue.");
+        TaskHook* hook = task;
+        hook->mNext = &mHead;
+        hook->mPrev = mHead.mPrev;
+        mHead.mPrev->mNext = hook;
+        mHead.mPrev = hook;
+    }
+
+    // Moves all tasks of __other__ to the back of this queue.
+    FORCE_INLINE void splice(TaskQueue& other)
+    {
+        if(other.empty())
+        {
+            return;
+        }
+
+        TaskHook* const first = other.mHead.mNext;
+        TaskHook* const last  = other.mHead.mPrev;
+        first->mPrev = mHead.mPrev;
+        mHead.mPrev->mNext = first;
+        last->mNext = &mHead;
+        mHead.mPrev = last;
+        other.mHead.mNext = other.mHead.mPrev = &other.mHead;
+    }
+
+    FORCE_INLINE Task* popFront()
+    {
+        Task* task = front();
+        remove(task);
+        return task;
+    }
+
+    /**
+     * @brief remove unlinks __task__ from the queue that contains it.
+     * @return The queue, if it became empty by removing __task__. NULL otherwise.
+     */
+    FORCE_INLINE static TaskQueue* remove(Task* task)
+    {
+        AI_ASSERT(isQueued(task), "The task isn't part of a queue.");
+        TaskHook* hook = task;
+        TaskHook* const prev = hook->mPrev;
+        TaskHook* const next = hook->mNext;
+        prev->mNext = next;
+        next->mPrev = prev;
+        hook->mNext = hook->mPrev = hook;
+
+        // Only a queue's head can remain as a single element ring.
+        // The head is the first member of the queue.
+        return prev == next ? reinterpret_cast<TaskQueue*>(prev) : NULL;
+    }
+
+    FORCE_INLINE static bool isQueued(const Task* task)
+    {
+        return static_cast<const TaskHook*>(task)->isLinked();
+    }
+
+    // Appends all tasks of the queue to __tasks__, front to back.
+    void getTasks(std::vector<Task*>& /* out */ tasks) const;
+private:
+    TaskQueue(const TaskQueue&);
+    TaskQueue& operator=(const TaskQueue&);
+
+    TaskHook mHead;
 };
 
 END_NS_AILIB
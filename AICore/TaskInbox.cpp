@@ -0,0 +1,63 @@
+#include "TaskInbox.h"
+
+BEGIN_NS_AILIB
+
+TaskInbox::TaskInbox() :
+    mHead(NULL)
+{
+    ;
+}
+
+namespace
+{
+    struct DiscardRequest
+    {
+        void operator()(Task* task, uint8_t request)
+        {
+            UNUSED(task);
+            UNUSED(request);
+        }
+    };
+}
+
+TaskInbox::~TaskInbox()
+{
+    // Unlink the pending tasks, so they can be posted elsewhere.
+    DiscardRequest discard;
+    drain(discard);
+}
+
+void TaskInbox::post(Task* task, uint8_t request)
+{
+    AI_ASSERT(task, "Posted tasks may not be NULL.");
+    AI_ASSERT(request != RequestNone, "Posted an empty request.");
+
+    TaskInboxHook* hook = task;
+    hook->mInboxRequest.store(request);
+    if(hook->mInboxQueued.exchange(true))
+    {
+        // Still pending. The consumer will see the new request.
+        return;
+    }
+
+    TaskInboxHook* head = mHead.load(std::memory_order_relaxed);
+    do
+    {
+        hook->mInboxNext.store(head, std::memory_order_relaxed);
+    }
+    while(!mHead.compare_exchange_weak(head, hook,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed));
+}
+
+bool TaskInbox::empty() const
+{
+    return mHead.load(std::memory_order_acquire) == NULL;
+}
+
+Task* TaskInbox::toTask(TaskInboxHook* hook)
+{
+    return static_cast<Task*>(hook);
+}
+
+END_NS_AILIB
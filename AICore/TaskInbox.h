@@ -0,0 +1,87 @@
+#ifndef TASKINBOX_H
+#define TASKINBOX_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "Task.h"
+#include <atomic>
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief TaskInbox collects requests for a scheduler from other threads.
+ *
+ * Any number of threads may post requests concurrently. Posting is lock-free and never
+ * allocates: the task is pushed onto an intrusive stack using its TaskInboxHook, unless it
+ * is already part of the inbox. The thread owning the scheduler takes all pending tasks
+ * at once and applies their requests in posting order.
+ *
+ * Each task holds a single pending request. When a task is posted again before the inbox
+ * is drained, the last request wins.
+ */
+class TaskInbox
+{
+public:
+    enum Request
+    {
+        RequestNone = 0,
+        RequestEnqueue,
+        // RequestStatus + status sets the task's status.
+        RequestStatus
+    };
+
+    TaskInbox();
+    ~TaskInbox();
+
+    // Thread-safe. __request__ is RequestEnqueue or RequestStatus + status.
+    void post(Task* task, uint8_t request);
+
+    /**
+     * @brief drain removes all pending tasks and calls __function__(task, request) for each,
+     * in posting order. Only the consuming thread may call it.
+     */
+    template <typename Function>
+    void drain(Function& function)
+    {
+        // Pushing prepends, reverse the list to restore the posting order.
+        TaskInboxHook* current = mHead.exchange(NULL, std::memory_order_acquire);
+        TaskInboxHook* reversed = NULL;
+        while(current)
+        {
+            TaskInboxHook* next = current->mInboxNext.load(std::memory_order_relaxed);
+            current->mInboxNext.store(reversed, std::memory_order_relaxed);
+            reversed = current;
+            current = next;
+        }
+
+        while(reversed)
+        {
+            // Read the link before the task may be posted (and linked) again.
+            TaskInboxHook* next = reversed->mInboxNext.load(std::memory_order_relaxed);
+
+            // Clear the flag before taking the request. A request posted in between
+            // re-queues the task and is handled by this or the next drain.
+            reversed->mInboxQueued.store(false);
+            const uint8_t request = reversed->mInboxRequest.exchange(RequestNone);
+            if(request != RequestNone)
+            {
+                function(toTask(reversed), request);
+            }
+            reversed = next;
+        }
+    }
+
+    bool empty() const;
+private:
+    TaskInbox(const TaskInbox&);
+    TaskInbox& operator=(const TaskInbox&);
+
+    static Task* toTask(TaskInboxHook* hook);
+
+    std::atomic<TaskInboxHook*> mHead;
+};
+
+END_NS_AILIB
+
+#endif // TASKINBOX_H
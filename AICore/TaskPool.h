@@ -0,0 +1,138 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "Task.h"
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief TaskPool allocates tasks of type T from chunks of CHUNK_SIZE preallocated slots.
+ *
+ * Destroyed tasks return their slot to a free list, so creating and destroying tasks at a
+ * high rate doesn't touch the global allocator once the pool has grown to its working size.
+ * Chunks are only released when the pool is destroyed. Combined with the intrusive task
+ * queues of the scheduler, a task can be created, scheduled and destroyed without any
+ * heap allocation.
+ *
+ * The pool is not thread-safe. All tasks must be destroyed before the pool.
+ */
+template <typename T, uint32_t CHUNK_SIZE = 64>
+class TaskPool
+{
+    STATIC_ASSERT((std::is_base_of<Task, T>::value))
+public:
+    typedef T value_type;
+
+    TaskPool() :
+        mFree(NULL),
+        mSize(0)
+    {
+        ;
+    }
+
+    ~TaskPool()
+    {
+        AI_ASSERT(mSize == 0, "Destroyed a task pool that still owns tasks.");
+        for(typename ChunkList::iterator it = mChunks.begin(); it != mChunks.end(); ++it)
+        {
+            delete[] *it;
+        }
+    }
+
+    // Constructs a task with the given constructor arguments.
+    template <typename... Args>
+    T* create(Args&&... args)
+    {
+        if(!mFree)
+        {
+            grow();
+        }
+
+        Slot* slot = mFree;
+        mFree = slot->next;
+        ++mSize;
+        return new (slot->storage()) T(std::forward<Args>(args)...);
+    }
+
+    // __task__ must have been created by this pool and mustn't be queued anymore.
+    void destroy(T* task)
+    {
+        if(!task)
+        {
+            return;
+        }
+
+        AI_ASSERT(mSize > 0, "Destroyed a task that wasn't created by this pool.");
+        task->~T();
+
+        Slot* slot = reinterpret_cast<Slot*>(task);
+        slot->next = mFree;
+        mFree = slot;
+        --mSize;
+    }
+
+    // Preallocates slots for at least __capacity__ tasks.
+    void reserve(size_t capacity)
+    {
+        while(getCapacity() < capacity)
+        {
+            grow();
+        }
+    }
+
+    // @returns The number of live tasks.
+    size_t size() const
+    {
+        return mSize;
+    }
+
+    size_t getCapacity() const
+    {
+        return mChunks.size() * CHUNK_SIZE;
+    }
+private:
+    TaskPool(const TaskPool&);
+    TaskPool& operator=(const TaskPool&);
+
+    // A free slot stores the link to the next free slot in the task's storage.
+    union Slot
+    {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+        Slot* next;
+
+        void* storage()
+        {
+            return &data;
+        }
+    };
+
+    typedef std::vector<Slot*> ChunkList;
+
+    void grow()
+    {
+        Slot* chunk = new Slot[CHUNK_SIZE];
+        mChunks.push_back(chunk);
+
+        // Link the slots in order, so consecutive creations use consecutive memory.
+        for(uint32_t i = CHUNK_SIZE; i > 0; --i)
+        {
+            chunk[i - 1].next = mFree;
+            mFree = &chunk[i - 1];
+        }
+    }
+
+    ChunkList mChunks;
+    Slot* mFree;
+    size_t mSize;
+};
+
+END_NS_AILIB
+
+#endif // TASKPOOL_H
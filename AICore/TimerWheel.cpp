@@ -0,0 +1,163 @@
+#include "TimerWheel.h"
+#include <algorithm>
+
+BEGIN_NS_AILIB
+
+TimerWheel::TimerWheel(HighResolutionTime::Timestamp start,
+                       HighResolutionTime::Timestamp resolution) :
+    mStart(start),
+    mResolution(resolution),
+    mCurrentTick(0),
+    mSize(0)
+{
+    AI_ASSERT(mResolution > 0, "The timer resolution must be positive.");
+}
+
+void TimerWheel::insert(Task* task)
+{
+    const HighResolutionTime::Timestamp offset = task->getWakeTime() - mStart;
+
+    // Round up, so tasks are never woken before their wake time.
+    const uint64_t tick = offset <= 0 ? 0 : (offset + mResolution - 1) / mResolution;
+    ++mSize;
+
+    if(tick <= mCurrentTick)
+    {
+        mDue.pushBack(task);
+        return;
+    }
+
+    // Pick the lowest level whose range covers the delay. The slot is determined by the
+    // absolute tick, so that the task is cascaded down at the right time.
+    const uint64_t delta = tick - mCurrentTick;
+    const uint32_t level = findLastSet(delta) / SLOT_BITS;
+    if(level >= NUM_LEVELS)
+    {
+        mOverflow.pushBack(task);
+        return;
+    }
+
+    const uint32_t slot = (tick >> (level * SLOT_BITS)) & (NUM_SLOTS - 1);
+    mSlots[level][slot].pushBack(task);
+}
+
+void TimerWheel::remove(Task* task)
+{
+    AI_ASSERT(mSize > 0, "Tried to remove a task from an empty timer wheel.");
+    TaskQueue::remove(task);
+    --mSize;
+}
+
+void TimerWheel::advance(HighResolutionTime::Timestamp time, TaskQueue& expired)
+{
+    const HighResolutionTime::Timestamp offset = time - mStart;
+    const uint64_t target = offset <= 0 ? 0 : offset / mResolution;
+
+    while(!mDue.empty())
+    {
+        expired.pushBack(mDue.popFront());
+        --mSize;
+    }
+
+    if(mSize == 0)
+    {
+        // Nothing to expire. Skip the idle ticks.
+        mCurrentTick = std::max(mCurrentTick, target);
+        return;
+    }
+
+    while(mCurrentTick < target)
+    {
+        const uint64_t tick = ++mCurrentTick;
+
+        // Whenever a level completes a revolution, the next slot of the level above is
+        // distributed over the levels below.
+        uint32_t level = 0;
+        while(level + 1 < NUM_LEVELS &&
+              ((tick >> (level * SLOT_BITS)) & (NUM_SLOTS - 1)) == 0)
+        {
+            ++level;
+        }
+        for(; level > 0; --level)
+        {
+            cascade(level);
+        }
+
+        TaskQueue& slot = mSlots[0][tick & (NUM_SLOTS - 1)];
+        while(!slot.empty())
+        {
+            expired.pushBack(slot.popFront());
+            --mSize;
+        }
+
+        // Tasks may have been cascaded into the due queue.
+        while(!mDue.empty())
+        {
+            expired.pushBack(mDue.popFront());
+            --mSize;
+        }
+
+        if(mSize == 0)
+        {
+            mCurrentTick = target;
+        }
+    }
+}
+
+void TimerWheel::removeAll(TaskQueue& removed)
+{
+    for(uint32_t level = 0; level < NUM_LEVELS; ++level)
+    {
+        for(uint32_t slot = 0; slot < NUM_SLOTS; ++slot)
+        {
+            removed.splice(mSlots[level][slot]);
+        }
+    }
+    removed.splice(mDue);
+    removed.splice(mOverflow);
+    mSize = 0;
+}
+
+void TimerWheel::getTasks(std::vector<Task*>& tasks) const
+{
+    for(uint32_t level = 0; level < NUM_LEVELS; ++level)
+    {
+        for(uint32_t slot = 0; slot < NUM_SLOTS; ++slot)
+        {
+            mSlots[level][slot].getTasks(tasks);
+        }
+    }
+    mDue.getTasks(tasks);
+    mOverflow.getTasks(tasks);
+}
+
+size_t TimerWheel::size() const
+{
+    return mSize;
+}
+
+bool TimerWheel::empty() const
+{
+    return mSize == 0;
+}
+
+void TimerWheel::cascade(uint32_t level)
+{
+    TaskQueue pending;
+    pending.splice(mSlots[level][(mCurrentTick >> (level * SLOT_BITS)) & (NUM_SLOTS - 1)]);
+
+    if(level == NUM_LEVELS - 1)
+    {
+        // Overflowing tasks may have come into range.
+        pending.splice(mOverflow);
+    }
+
+    while(!pending.empty())
+    {
+        Task* task = pending.popFront();
+        --mSize;
+        insert(task);
+    }
+}
+
+END_NS_AILIB
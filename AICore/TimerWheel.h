@@ -0,0 +1,66 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "Task.h"
+#include "HighResolutionTime.h"
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief The TimerWheel class keeps sleeping tasks ordered by their wake time.
+ *
+ * It is a hierarchical timing wheel with NUM_LEVELS levels of NUM_SLOTS intrusive task queues.
+ * Level 0 has one slot per tick, each level above covers NUM_SLOTS times the range of the
+ * level below. Tasks move down a level whenever the wheel below completes a revolution,
+ * so inserting, removing and expiring a task is O(1). Wake times beyond the range of the wheel
+ * (2^24 ticks) are kept in an overflow queue that is re-examined every top-level slot.
+ *
+ * Tasks never wake up early. They wake up at most one tick late.
+ */
+class TimerWheel
+{
+public:
+    static const uint32_t NUM_LEVELS = 4;
+    static const uint32_t SLOT_BITS  = 6;
+    static const uint32_t NUM_SLOTS  = 1 << SLOT_BITS;
+
+    // The resolution is the duration of one tick, in microseconds.
+    TimerWheel(HighResolutionTime::Timestamp start,
+               HighResolutionTime::Timestamp resolution = 1000);
+
+    // Inserts __task__ based on its wake time.
+    void insert(Task* task);
+    void remove(Task* task);
+
+    // Moves all tasks with a wake time up to __time__ to __expired__.
+    void advance(HighResolutionTime::Timestamp time, TaskQueue& /* out */ expired);
+
+    // Moves all tasks to __removed__, regardless of their wake time.
+    void removeAll(TaskQueue& /* out */ removed);
+
+    // Appends all sleeping tasks to __tasks__, in no particular order.
+    void getTasks(std::vector<Task*>& /* out */ tasks) const;
+
+    size_t size() const;
+    bool empty() const;
+private:
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+
+    void cascade(uint32_t level);
+
+    TaskQueue mSlots[NUM_LEVELS][NUM_SLOTS];
+    TaskQueue mDue;
+    TaskQueue mOverflow;
+    HighResolutionTime::Timestamp mStart;
+    HighResolutionTime::Timestamp mResolution;
+    uint64_t mCurrentTick; //< The last processed tick.
+    size_t mSize;
+};
+
+END_NS_AILIB
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,458 @@
+#include "UtilitySelector.h"
+#include <limits>
+
+#if defined(BT_USE_SSE)
+#include <emmintrin.h>
+#elif defined(BT_USE_NEON)
+#include <arm_neon.h>
+#endif
+
+BEGIN_NS_AILIB
+
+namespace
+{
+
+// Four lanes of floats, one per agent. Without SIMD support the lanes are processed in plain
+// loops, which compilers are free to vectorize.
+#if defined(BT_USE_SSE)
+
+typedef btSimdFloat4 Float4;
+typedef btSimdFloat4 Mask4;
+
+FORCE_INLINE Float4 splat(float x) { return _mm_set1_ps(x); }
+FORCE_INLINE Float4 load(const float* ptr) { return _mm_load_ps(ptr); }
+FORCE_INLINE void store(float* ptr, Float4 x) { _mm_store_ps(ptr, x); }
+FORCE_INLINE Float4 add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+FORCE_INLINE Float4 sub(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+FORCE_INLINE Float4 mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+FORCE_INLINE Float4 minimum(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+FORCE_INLINE Float4 maximum(Float4 a, Float4 b) { return _mm_max_ps(a, b); }
+FORCE_INLINE Mask4 greaterEqual(Float4 a, Float4 b) { return _mm_cmpge_ps(a, b); }
+FORCE_INLINE Mask4 greater(Float4 a, Float4 b) { return _mm_cmpgt_ps(a, b); }
+// @returns The lanes of __a__ where __mask__ is set, the lanes of __b__ elsewhere.
+FORCE_INLINE Float4 blend(Mask4 mask, Float4 a, Float4 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+#elif defined(BT_USE_NEON)
+
+typedef btSimdFloat4 Float4;
+typedef uint32x4_t Mask4;
+
+FORCE_INLINE Float4 splat(float x) { return vdupq_n_f32(x); }
+FORCE_INLINE Float4 load(const float* ptr) { return vld1q_f32(ptr); }
+FORCE_INLINE void store(float* ptr, Float4 x) { vst1q_f32(ptr, x); }
+FORCE_INLINE Float4 add(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+FORCE_INLINE Float4 sub(Float4 a, Float4 b) { return vsubq_f32(a, b); }
+FORCE_INLINE Float4 mul(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+FORCE_INLINE Float4 minimum(Float4 a, Float4 b) { return vminq_f32(a, b); }
+FORCE_INLINE Float4 maximum(Float4 a, Float4 b) { return vmaxq_f32(a, b); }
+FORCE_INLINE Mask4 greaterEqual(Float4 a, Float4 b) { return vcgeq_f32(a, b); }
+FORCE_INLINE Mask4 greater(Float4 a, Float4 b) { return vcgtq_f32(a, b); }
+FORCE_INLINE Float4 blend(Mask4 mask, Float4 a, Float4 b) { return vbslq_f32(mask, a, b); }
+
+#else
+
+struct Float4
+{
+    float v[4];
+};
+
+struct Mask4
+{
+    bool v[4];
+};
+
+#define AI_FOR_EACH_LANE(expr) \
+    for(uint32_t i = 0; i < 4; ++i) { expr; }
+
+FORCE_INLINE Float4 splat(float x) { Float4 r; AI_FOR_EACH_LANE(r.v[i] = x) return r; }
+FORCE_INLINE Float4 load(const float* ptr) { Float4 r; AI_FOR_EACH_LANE(r.v[i] = ptr[i]) return r; }
+FORCE_INLINE void store(float* ptr, Float4 x) { AI_FOR_EACH_LANE(ptr[i] = x.v[i]) }
+FORCE_INLINE Float4 add(Float4 a, Float4 b) { AI_FOR_EACH_LANE(a.v[i] += b.v[i]) return a; }
+FORCE_INLINE Float4 sub(Float4 a, Float4 b) { AI_FOR_EACH_LANE(a.v[i] -= b.v[i]) return a; }
+FORCE_INLINE Float4 mul(Float4 a, Float4 b) { AI_FOR_EACH_LANE(a.v[i] *= b.v[i]) return a; }
+FORCE_INLINE Float4 minimum(Float4 a, Float4 b) { AI_FOR_EACH_LANE(a.v[i] = b.v[i] < a.v[i] ? b.v[i] : a.v[i]) return a; }
+FORCE_INLINE Float4 maximum(Float4 a, Float4 b) { AI_FOR_EACH_LANE(a.v[i] = b.v[i] > a.v[i] ? b.v[i] : a.v[i]) return a; }
+FORCE_INLINE Mask4 greaterEqual(Float4 a, Float4 b) { Mask4 r; AI_FOR_EACH_LANE(r.v[i] = a.v[i] >= b.v[i]) return r; }
+FORCE_INLINE Mask4 greater(Float4 a, Float4 b) { Mask4 r; AI_FOR_EACH_LANE(r.v[i] = a.v[i] > b.v[i]) return r; }
+FORCE_INLINE Float4 blend(Mask4 mask, Float4 a, Float4 b) { AI_FOR_EACH_LANE(a.v[i] = mask.v[i] ? a.v[i] : b.v[i]) return a; }
+
+#undef AI_FOR_EACH_LANE
+
+#endif
+
+FORCE_INLINE Float4 saturate(Float4 x)
+{
+    return minimum(maximum(x, splat(0.0f)), splat(1.0f));
+}
+
+FORCE_INLINE float saturate(float x)
+{
+    return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+// Must match ResponseCurve::evaluate.
+FORCE_INLINE Float4 evaluateCurve(const ResponseCurve& curve, Float4 x)
+{
+    const Float4 t = sub(x, splat(curve.shift));
+    Float4 y = t;
+    switch(curve.type)
+    {
+    case ResponseCurve::CurveLinear:
+        break;
+    case ResponseCurve::CurvePolynomial:
+        y = splat(1.0f);
+        for(uint32_t i = 0; i < curve.exponent; ++i)
+        {
+            y = mul(y, t);
+        }
+        break;
+    case ResponseCurve::CurveSmoothstep:
+    {
+        const Float4 s = saturate(t);
+        y = mul(mul(s, s), sub(splat(3.0f), add(s, s)));
+        break;
+    }
+    case ResponseCurve::CurveStep:
+        y = blend(greaterEqual(t, splat(0.0f)), splat(1.0f), splat(0.0f));
+        break;
+    }
+    return saturate(add(mul(y, splat(curve.slope)), splat(curve.offset)));
+}
+
+} // namespace
+
+ResponseCurve::ResponseCurve(Type type, float slope, float shift, float offset, uint32_t exponent) :
+    type(type),
+    slope(slope),
+    shift(shift),
+    offset(offset),
+    exponent(exponent)
+{
+    ;
+}
+
+float ResponseCurve::evaluate(float x) const
+{
+    const float t = x - shift;
+    float y = t;
+    switch(type)
+    {
+    case CurveLinear:
+        break;
+    case CurvePolynomial:
+        y = 1.0f;
+        for(uint32_t i = 0; i < exponent; ++i)
+        {
+            y *= t;
+        }
+        break;
+    case CurveSmoothstep:
+    {
+        const float s = saturate(t);
+        y = s * s * (3.0f - (s + s));
+        break;
+    }
+    case CurveStep:
+        y = t >= 0.0f ? 1.0f : 0.0f;
+        break;
+    }
+    return saturate(y * slope + offset);
+}
+
+UtilityTable::UtilityTable() :
+    mNumRows(0),
+    mNumAgents(0),
+    mStride(0)
+{
+    ;
+}
+
+void UtilityTable::resize(uint32_t numRows, uint32_t numAgents)
+{
+    mNumRows = numRows;
+    mNumAgents = numAgents;
+    mStride = (numAgents + 3) & ~3u;
+
+    // Padding lanes are processed too, so they have to hold valid numbers.
+    mValues.resize(static_cast<int>(numRows * mStride));
+    for(int i = 0; i < mValues.size(); ++i)
+    {
+        mValues[i] = 0.0f;
+    }
+}
+
+UtilityModel::UtilityModel(uint32_t numInputs) :
+    mNumInputs(numInputs)
+{
+    ;
+}
+
+uint32_t UtilityModel::addOption(float weight)
+{
+    AI_ASSERT(mOptions.size() < std::numeric_limits<uint16_t>::max(), "Too many options.");
+
+    Option option;
+    option.weight = weight;
+    mOptions.push_back(option);
+    return static_cast<uint32_t>(mOptions.size() - 1);
+}
+
+void UtilityModel::addConsideration(uint32_t option,
+                                    uint32_t input,
+                                    const ResponseCurve& curve,
+                                    float min,
+                                    float max)
+{
+    AI_ASSERT(option < mOptions.size(), "Invalid option.");
+    AI_ASSERT(input < mNumInputs, "Invalid input.");
+    AI_ASSERT(min < max, "The input range is empty.");
+
+    Consideration consideration;
+    consideration.input = input;
+    consideration.min = min;
+    consideration.invRange = 1.0f / (max - min);
+    consideration.curve = curve;
+    mOptions[option].considerations.push_back(consideration);
+}
+
+float UtilityModel::score(uint32_t option, const float* inputs) const
+{
+    AI_ASSERT(option < mOptions.size(), "Invalid option.");
+
+    const Option& opt = mOptions[option];
+    float score = opt.weight;
+    for(std::vector<Consideration>::const_iterator it = opt.considerations.begin();
+        it != opt.considerations.end(); ++it)
+    {
+        const float x = saturate((inputs[it->input] - it->min) * it->invRange);
+        score *= it->curve.evaluate(x);
+    }
+    return score;
+}
+
+void UtilityModel::evaluate(const UtilityTable& inputs, UtilityTable& scores) const
+{
+    AI_ASSERT(inputs.getNumRows() == mNumInputs, "The inputs don't match the model.");
+
+    if(scores.getNumRows() != getNumOptions() || scores.getNumAgents() != inputs.getNumAgents())
+    {
+        scores.resize(getNumOptions(), inputs.getNumAgents());
+    }
+
+    const uint32_t stride = inputs.getStride();
+    for(uint32_t o = 0; o < mOptions.size(); ++o)
+    {
+        const Option& option = mOptions[o];
+        float* row = scores.getRow(o);
+
+        // Four agents at a time. The padding of the rows covers the last agents.
+        for(uint32_t i = 0; i < stride; i += 4)
+        {
+            Float4 score = splat(option.weight);
+            for(std::vector<Consideration>::const_iterator it = option.considerations.begin();
+                it != option.considerations.end(); ++it)
+            {
+                const Float4 value = load(inputs.getRow(it->input) + i);
+                const Float4 x = saturate(mul(sub(value, splat(it->min)), splat(it->invRange)));
+                score = mul(score, evaluateCurve(it->curve, x));
+            }
+            store(row + i, score);
+        }
+    }
+}
+
+void UtilityModel::selectBest(const UtilityTable& scores, std::vector<uint16_t>& best)
+{
+    const uint32_t numAgents = scores.getNumAgents();
+    best.assign(numAgents, 0);
+    if(scores.getNumRows() == 0)
+    {
+        return;
+    }
+
+    ATTRIBUTE_ALIGNED16(float lanes[4]);
+    for(uint32_t i = 0; i < scores.getStride(); i += 4)
+    {
+        Float4 bestScore = load(scores.getRow(0) + i);
+        // Option indices are exact in floats, which saves integer SIMD.
+        Float4 bestOption = splat(0.0f);
+        for(uint32_t o = 1; o < scores.getNumRows(); ++o)
+        {
+            const Float4 score = load(scores.getRow(o) + i);
+            const Mask4 better = greater(score, bestScore);
+            bestScore = blend(better, score, bestScore);
+            bestOption = blend(better, splat(static_cast<float>(o)), bestOption);
+        }
+
+        store(lanes, bestOption);
+        for(uint32_t lane = 0; lane < 4 && i + lane < numAgents; ++lane)
+        {
+            best[i + lane] = static_cast<uint16_t>(lanes[lane]);
+        }
+    }
+}
+
+UtilitySelector::UtilitySelector(Scheduler& scheduler,
+                                 const Composite::BehaviorList& children,
+                                 const UtilityTable& scores,
+                                 uint32_t agent) :
+    Composite(scheduler, children),
+    mScores(scores),
+    mAgent(agent),
+    mRanking(children.size()),
+    mNumRanked(0),
+    mCurrent(0)
+{
+    setName("UtilitySelector");
+    AI_ASSERT(children.size() <= std::numeric_limits<uint16_t>::max(),
+              "This node parents too many children - integer overflow.");
+}
+
+UtilitySelector::~UtilitySelector()
+{
+    ;
+}
+
+void UtilitySelector::run()
+{
+    // Every activation starts over. Children of the previous one may still be observing.
+    terminateFromRank(0);
+    rank();
+
+    // No child is worth running.
+    if(mNumRanked == 0)
+    {
+        notifyFailure();
+    }
+    // Start with the best child.
+    else
+    {
+        mScheduler.enqueue(getChildren()[mRanking[0]]);
+        setStatus(StatusWaiting);
+    }
+}
+
+void UtilitySelector::terminate()
+{
+    terminateFromRank(0);
+    mNumRanked = 0;
+    Behavior::terminate();
+}
+
+void UtilitySelector::onSuccess(Behavior* behavior)
+{
+    const uint32_t pos = rankOf(behavior);
+    if(pos != mCurrent)
+    {
+        terminateFromRank(pos + 1);
+    }
+    notifySuccess();
+}
+
+void UtilitySelector::onFailure(Behavior* behavior)
+{
+    const uint32_t pos = rankOf(behavior);
+    if(pos != mCurrent)
+    {
+        terminateFromRank(pos + 1);
+    }
+
+    // The failed behavior was the least useful one.
+    if(mCurrent + 1 == mNumRanked)
+    {
+        notifyFailure();
+    }
+    // Fall back to the next best behavior.
+    else
+    {
+        mScheduler.enqueue(getChildren()[mRanking[++mCurrent]]);
+    }
+}
+
+void UtilitySelector::onReset(Behavior* behavior)
+{
+    const uint32_t pos = rankOf(behavior);
+    AI_ASSERT(pos <= mCurrent,
+              "A behavior running after the current behavior should not be reseting this node.");
+
+    // Terminate all behaviors ranked below this one.
+    terminateFromRank(pos + 1);
+
+    // A finished node is waiting for the reset child's new result.
+    if(getStatus() == StatusDormant)
+    {
+        setStatus(StatusWaiting);
+    }
+    notifyReset();
+}
+
+void UtilitySelector::setAgent(uint32_t agent)
+{
+    mAgent = agent;
+}
+
+uint32_t UtilitySelector::getAgent() const
+{
+    return mAgent;
+}
+
+void UtilitySelector::rank()
+{
+    AI_ASSERT(mScores.getNumRows() == getChildren().size(),
+              "The scores need one row per child.");
+    AI_ASSERT(mAgent < mScores.getNumAgents(), "The agent has no scores.");
+
+    mNumRanked = 0;
+    mCurrent = 0;
+    for(uint16_t i = 0; i < getChildren().size(); ++i)
+    {
+        const float score = mScores.get(i, mAgent);
+        if(!(score > 0.0f))
+        {
+            continue;
+        }
+
+        // Insertion sort, equally scored children keep their order.
+        uint16_t pos = mNumRanked;
+        while(pos > 0 && mScores.get(mRanking[pos - 1], mAgent) < score)
+        {
+            mRanking[pos] = mRanking[pos - 1];
+            --pos;
+        }
+        mRanking[pos] = i;
+        ++mNumRanked;
+    }
+}
+
+uint32_t UtilitySelector::rankOf(const Behavior* child) const
+{
+    const uint32_t idx = indexOf(child);
+    for(uint32_t pos = 0; pos < mNumRanked; ++pos)
+    {
+        if(mRanking[pos] == idx)
+        {
+            return pos;
+        }
+    }
+    AI_ASSERT(false, "The child wasn't ranked.");
+    return 0;
+}
+
+void UtilitySelector::terminateFromRank(uint32_t pos)
+{
+    if(pos <= mCurrent && pos < mNumRanked)
+    {
+        // Terminate all behaviors ranked at or below __pos__ that were started.
+        for(uint32_t i = pos; i <= mCurrent; ++i)
+        {
+            getChildren()[mRanking[i]]->terminate();
+        }
+
+        mCurrent = pos == 0 ? 0 : pos - 1;
+    }
+}
+
+END_NS_AILIB
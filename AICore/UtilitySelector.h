@@ -0,0 +1,326 @@
+#ifndef UTILITYSELECTOR_H
+#define UTILITYSELECTOR_H
+
+#pragma once
+
+#include "ai_global.h"
+#include "BehaviorTree.h"
+#include "Blackboard.h"
+#include <LinearMath/btAlignedObjectArray.h>
+#include <utility>
+#include <vector>
+
+BEGIN_NS_AILIB
+
+/**
+ * @brief ResponseCurve maps a normalized input x in [0, 1] to a utility in [0, 1].
+ * __slope__ scales the curve, __shift__ moves it along x and __offset__ moves it along y.
+ */
+class ResponseCurve
+{
+public:
+    enum Type
+    {
+        // slope * (x - shift) + offset
+        CurveLinear = 0,
+        // slope * (x - shift)^exponent + offset
+        CurvePolynomial,
+        // slope * smoothstep(x - shift) + offset, an S-shaped curve.
+        CurveSmoothstep,
+        // offset, plus slope once x reaches shift.
+        CurveStep
+    };
+
+    ResponseCurve(Type type = CurveLinear,
+                  float slope = 1.0f,
+                  float shift = 0.0f,
+                  float offset = 0.0f,
+                  uint32_t exponent = 1);
+
+    // @returns The utility of __x__, clamped to [0, 1].
+    float evaluate(float x) const;
+
+    Type type;
+    float slope;
+    float shift;
+    float offset;
+    uint32_t exponent;
+};
+
+/**
+ * @brief UtilityTable stores one float per row and agent in structure-of-arrays layout.
+ * Rows are 16-byte aligned and padded to a multiple of four agents, so that they can be
+ * processed four agents at a time.
+ */
+class UtilityTable
+{
+public:
+    UtilityTable();
+
+    // Clears all values.
+    void resize(uint32_t numRows, uint32_t numAgents);
+
+    FORCE_INLINE float* getRow(uint32_t row)
+    {
+        AI_ASSERT(row < mNumRows, "Invalid row.");
+        return mStride == 0 ? NULL : &mValues[row * mStride];
+    }
+
+    FORCE_INLINE const float* getRow(uint32_t row) const
+    {
+        AI_ASSERT(row < mNumRows, "Invalid row.");
+        return mStride == 0 ? NULL : &mValues[row * mStride];
+    }
+
+    FORCE_INLINE float get(uint32_t row, uint32_t agent) const
+    {
+        AI_ASSERT(agent < mNumAgents, "Invalid agent.");
+        return getRow(row)[agent];
+    }
+
+    FORCE_INLINE void set(uint32_t row, uint32_t agent, float value)
+    {
+        AI_ASSERT(agent < mNumAgents, "Invalid agent.");
+        getRow(row)[agent] = value;
+    }
+
+    FORCE_INLINE uint32_t getNumRows() const
+    {
+        return mNumRows;
+    }
+
+    FORCE_INLINE uint32_t getNumAgents() const
+    {
+        return mNumAgents;
+    }
+
+    // The number of floats per row, a multiple of four.
+    FORCE_INLINE uint32_t getStride() const
+    {
+        return mStride;
+    }
+private:
+    btAlignedObjectArray<float> mValues;
+    uint32_t mNumRows;
+    uint32_t mNumAgents;
+    uint32_t mStride;
+};
+
+/**
+ * @brief UtilityModel describes how the options of a UtilitySelector are scored.
+ *
+ * Every option (one per child of the selector, in the same order) has a weight and a number of
+ * considerations. A consideration normalizes one input to [0, 1] and maps it through a
+ * response curve. The score of an option is its weight multiplied by the utilities of all its
+ * considerations, so any consideration can veto an option by returning 0.
+ *
+ * Models are shared by all agents that use them. Scores are computed for many agents at once,
+ * four agents per SIMD operation when LinearMath is built with SSE or NEON.
+ */
+class UtilityModel
+{
+public:
+    explicit UtilityModel(uint32_t numInputs);
+
+    // @returns The index of the new option.
+    uint32_t addOption(float weight = 1.0f);
+
+    // Scores __option__ by __input__, normalized from [__min__, __max__].
+    void addConsideration(uint32_t option,
+                          uint32_t input,
+                          const ResponseCurve& curve,
+                          float min = 0.0f,
+                          float max = 1.0f);
+
+    FORCE_INLINE uint32_t getNumInputs() const
+    {
+        return mNumInputs;
+    }
+
+    FORCE_INLINE uint32_t getNumOptions() const
+    {
+        return static_cast<uint32_t>(mOptions.size());
+    }
+
+    // Scores all options of a single agent. __inputs__ holds one value per input.
+    float score(uint32_t option, const float* inputs) const;
+
+    /**
+     * @brief evaluate scores all options of all agents in __inputs__ (one row per input) and
+     * writes them to __scores__ (one row per option).
+     */
+    void evaluate(const UtilityTable& inputs, UtilityTable& /* out */ scores) const;
+
+    /**
+     * @brief selectBest writes the index of the highest scoring option of every agent in
+     * __scores__ to __best__. Ties go to the earlier option.
+     */
+    static void selectBest(const UtilityTable& scores, std::vector<uint16_t>& /* out */ best);
+private:
+    struct Consideration
+    {
+        uint32_t input;
+        float min;
+        float invRange;
+        ResponseCurve curve;
+    };
+
+    struct Option
+    {
+        float weight;
+        std::vector<Consideration> considerations;
+    };
+
+    uint32_t mNumInputs;
+    std::vector<Option> mOptions;
+};
+
+/**
+ * @brief UtilitySelector runs its children in the order of their utility for the agent.
+ *
+ * When the node starts, the children are ranked by their scores in a UtilityTable, which is
+ * typically filled by a UtilityBatch for all agents at once. The highest scoring child runs
+ * first. If it fails, the next best child runs, like in a Selector. Children scoring 0 or less
+ * are never run. The node fails if no child succeeded.
+ *
+ * The ranking is kept for the whole activation. Re-evaluate the scores and restart the node to
+ * react to changed utilities.
+ */
+class UtilitySelector : public Composite
+{
+public:
+    // __scores__ must outlive the node. Column __agent__ holds the scores of the children.
+    UtilitySelector(Scheduler& scheduler,
+                    const Composite::BehaviorList& children,
+                    const UtilityTable& scores,
+                    uint32_t agent);
+    virtual ~UtilitySelector();
+
+    virtual void run();
+    virtual void terminate();
+    virtual void onSuccess(Behavior* behavior);
+    virtual void onFailure(Behavior* behavior);
+    virtual void onReset(Behavior* behavior);
+
+    void setAgent(uint32_t agent);
+    uint32_t getAgent() const;
+private:
+    // Orders the children with a positive score, best first.
+    void rank();
+    // @returns The position of __child__ in the ranking.
+    uint32_t rankOf(const Behavior* child) const;
+    // Terminates the ranked children starting at position __pos__.
+    void terminateFromRank(uint32_t pos);
+
+    const UtilityTable& mScores;
+    uint32_t mAgent;
+    std::vector<uint16_t> mRanking;
+    uint16_t mNumRanked;
+    uint16_t mCurrent;
+};
+
+/**
+ * @brief UtilityBatch gathers the inputs of a UtilityModel from the blackboards of many agents
+ * and scores them in one pass.
+ *
+ * Inputs are read as floats from the keys passed to setInput. Missing keys read as 0.
+ * Evaluate the batch before the scheduler update the selectors run in, or from a task.
+ */
+template <typename KEY>
+class UtilityBatch
+{
+public:
+    // __model__ must outlive the batch.
+    explicit UtilityBatch(const UtilityModel& model) :
+        mModel(model)
+    {
+        ;
+    }
+
+    void setInput(uint32_t input, const KEY& key)
+    {
+        AI_ASSERT(input < mModel.getNumInputs(), "Invalid input.");
+        for(typename InputList::iterator it = mKeys.begin(); it != mKeys.end(); ++it)
+        {
+            if(it->first == input)
+            {
+                it->second = key;
+                return;
+            }
+        }
+        mKeys.push_back(std::make_pair(input, key));
+    }
+
+    // @returns The agent's column in getScores(). Columns of removed agents are reused.
+    uint32_t add(const Blackboard<KEY>& blackboard)
+    {
+        if(!mFree.empty())
+        {
+            const uint32_t agent = mFree.back();
+            mFree.pop_back();
+            mBlackboards[agent] = &blackboard;
+            return agent;
+        }
+        mBlackboards.push_back(&blackboard);
+        return static_cast<uint32_t>(mBlackboards.size() - 1);
+    }
+
+    void remove(uint32_t agent)
+    {
+        AI_ASSERT(agent < mBlackboards.size() && mBlackboards[agent],
+                  "Tried to remove an inexistant agent.");
+        mBlackboards[agent] = NULL;
+        mFree.push_back(agent);
+    }
+
+    // Reads the inputs of all agents and computes their scores.
+    void evaluate()
+    {
+        const uint32_t numAgents = static_cast<uint32_t>(mBlackboards.size());
+        if(mInputs.getNumRows() != mModel.getNumInputs() || mInputs.getNumAgents() != numAgents)
+        {
+            mInputs.resize(mModel.getNumInputs(), numAgents);
+        }
+
+        // Inputs without a key keep reading 0.
+        for(typename InputList::const_iterator it = mKeys.begin(); it != mKeys.end(); ++it)
+        {
+            float* row = mInputs.getRow(it->first);
+            for(uint32_t agent = 0; agent < numAgents; ++agent)
+            {
+                const Blackboard<KEY>* blackboard = mBlackboards[agent];
+                row[agent] = blackboard && blackboard->has(it->second) ?
+                                 blackboard->template get<float>(it->second) : 0.0f;
+            }
+        }
+
+        mModel.evaluate(mInputs, mScores);
+        UtilityModel::selectBest(mScores, mBest);
+    }
+
+    FORCE_INLINE const UtilityTable& getScores() const
+    {
+        return mScores;
+    }
+
+    // @returns The highest scoring option of __agent__ at the last evaluation.
+    FORCE_INLINE uint16_t getBest(uint32_t agent) const
+    {
+        AI_ASSERT(agent < mBest.size(), "The agent wasn't evaluated yet.");
+        return mBest[agent];
+    }
+private:
+    typedef std::vector<std::pair<uint32_t, KEY> > InputList;
+
+    const UtilityModel& mModel;
+    InputList mKeys;
+    std::vector<const Blackboard<KEY>*> mBlackboards;
+    std::vector<uint32_t> mFree;
+    UtilityTable mInputs;
+    UtilityTable mScores;
+    std::vector<uint16_t> mBest;
+};
+
+END_NS_AILIB
+
+#endif // UTILITYSELECTOR_H
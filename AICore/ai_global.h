@@ -97,8 +97,40 @@ template<int> struct static_assert_test{};
 #define BEGIN_NS_AILIB namespace ailib {
 #define END_NS_AILIB }
 
+#include <stdint.h>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
 BEGIN_NS_AILIB
 typedef float real_type;
+
+// Index of the lowest set bit. __x__ mustn't be zero.
+FORCE_INLINE uint32_t findFirstSet(uint64_t x)
+{
+    AI_ASSERT(x != 0, "No bit is set.");
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, x);
+    return idx;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// Index of the highest set bit. __x__ mustn't be zero.
+FORCE_INLINE uint32_t findLastSet(uint64_t x)
+{
+    AI_ASSERT(x != 0, "No bit is set.");
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, x);
+    return idx;
+#else
+    return 63 - __builtin_clzll(x);
+#endif
+}
 END_NS_AILIB
 
 #endif // AI_GLOBAL_H
@@ -16,7 +16,8 @@ namespace HighResolutionTime {
 
     Timestamp now()
     {
-        return mach_absolute_time() * sInfo.numer / sInfo.denom;
+        // The timebase converts to nanoseconds.
+        return mach_absolute_time() * sInfo.numer / sInfo.denom / 1000;
     }
 }
 
@@ -17,7 +17,7 @@ namespace HighResolutionTime {
     {
         LARGE_INTEGER retVal;
         QueryPerformanceCounter(&retVal);
-        retVal.QuadPart *= 1000000000; // multiply first to prevent precision-loss
+        retVal.QuadPart *= 1000000; // multiply first to prevent precision-loss
         retVal.QuadPart /= sFrequency.QuadPart;
         return retVal.QuadPart;
     }
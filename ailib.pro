@@ -1,5 +1,6 @@
 TEMPLATE = subdirs
 SUBDIRS = LinearMath \
-          AICore
+          AICore \
+          tests
 
 CONFIG += ordered
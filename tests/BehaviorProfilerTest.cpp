@@ -0,0 +1,53 @@
+#include "Test.h"
+#include "BehaviorProfiler.h"
+#include "Scheduler.h"
+
+using namespace ailib;
+
+AI_TEST(BehaviorProfilerRecordsAttachedNodesOnly)
+{
+    int failures = 0;
+
+    Scheduler scheduler;
+    BehaviorProfiler profiler;
+    scheduler.setListener(&profiler);
+
+    Sequence leaf(scheduler, Composite::BehaviorList());
+    Sequence root(scheduler, Composite::BehaviorList(1, &leaf));
+    profiler.attach(&root, "tree");
+
+    scheduler.enqueue(&root);
+    for(int i = 0; i < 4; ++i)
+    {
+        scheduler.update(1000, 0.016f);
+    }
+
+    const std::deque<NodeProfile>* profiles = profiler.getProfiles("tree");
+    AI_CHECK(profiles && profiles->size() == 2);
+    if(!profiles || profiles->size() != 2)
+    {
+        return failures;
+    }
+    AI_CHECK((*profiles)[0].runs == 1);
+    AI_CHECK((*profiles)[1].runs == 1);
+    AI_CHECK((*profiles)[1].parent == 0);
+    if(BehaviorProfiler::recordsResults())
+    {
+        AI_CHECK((*profiles)[0].successes == 1);
+        AI_CHECK((*profiles)[1].successes == 1);
+    }
+
+    // Detached nodes aren't recorded anymore.
+    profiler.detach(&root);
+    scheduler.enqueue(&root);
+    for(int i = 0; i < 4; ++i)
+    {
+        scheduler.update(1000, 0.016f);
+    }
+    AI_CHECK((*profiles)[0].runs == 1);
+    AI_CHECK((*profiles)[1].runs == 1);
+
+    scheduler.setListener(NULL);
+    scheduler.clear();
+    return failures;
+}
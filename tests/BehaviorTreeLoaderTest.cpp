@@ -0,0 +1,105 @@
+#include "Test.h"
+#include "BehaviorTreeLoader.h"
+#include "Scheduler.h"
+#include <string>
+
+using namespace ailib;
+
+namespace
+{
+
+// The number of "Budgeted" nodes that can still be created. Fails the build once exhausted.
+int gBudget = 0;
+
+Behavior* createBudgeted(NodeContext& context)
+{
+    if(gBudget <= 0)
+    {
+        return NULL;
+    }
+    --gBudget;
+    return context.create<Sequence>(context.getScheduler(), context.getChildren());
+}
+
+void describe(BehaviorTreeDescription& description, uint32_t numChildren)
+{
+    description.clear();
+    description.beginNode("Sequence");
+    for(uint32_t i = 0; i < numChildren; ++i)
+    {
+        description.beginNode("Budgeted");
+        description.endNode();
+    }
+    description.endNode();
+}
+
+} // namespace
+
+AI_TEST(BehaviorTreeLibraryKeepsDefinitionIfAReloadFails)
+{
+    int failures = 0;
+
+    NodeRegistry registry;
+    registry.add("Budgeted", &createBudgeted);
+    BehaviorTreeLibrary library(registry);
+    Scheduler scheduler;
+
+    BehaviorTreeDescription original;
+    describe(original, 1);
+    gBudget = 2;
+    AI_CHECK(library.load("tree", original));
+    BehaviorTree* first = library.create("tree", scheduler);
+    BehaviorTree* second = library.create("tree", scheduler);
+    AI_CHECK(first && second);
+    if(!first || !second)
+    {
+        return failures;
+    }
+    first->start();
+    Behavior* const firstRoot = first->getRoot();
+    Behavior* const secondRoot = second->getRoot();
+
+    // Enough budget for the first tree only, the second tree fails to build.
+    BehaviorTreeDescription reloaded;
+    describe(reloaded, 2);
+    gBudget = 2;
+    AI_CHECK(!library.load("tree", reloaded));
+    AI_CHECK(!library.getError().empty());
+    AI_CHECK(library.find("tree")->getNumNodes() == original.getNumNodes());
+    AI_CHECK(first->getRoot() == firstRoot);
+    AI_CHECK(second->getRoot() == secondRoot);
+    AI_CHECK(firstRoot->getStatus() == StatusRunning);
+
+    gBudget = 4;
+    AI_CHECK(library.load("tree", reloaded));
+    AI_CHECK(library.find("tree")->getNumNodes() == reloaded.getNumNodes());
+    AI_CHECK(first->getRoot() != firstRoot);
+    AI_CHECK(first->getRoot()->getStatus() == StatusRunning);
+
+    library.destroy(first);
+    library.destroy(second);
+    scheduler.clear();
+    return failures;
+}
+
+AI_TEST(BehaviorTreeDescriptionRejectsLongJsonStrings)
+{
+    int failures = 0;
+
+    const std::string longString(70000, 'x');
+    const std::string documents[] =
+    {
+        "{\"type\": \"" + longString + "\"}",
+        "{\"type\": \"Sequence\", \"" + longString + "\": 1}",
+        "{\"type\": \"Sequence\", \"name\": \"" + longString + "\"}"
+    };
+
+    for(size_t i = 0; i < sizeof(documents) / sizeof(documents[0]); ++i)
+    {
+        BehaviorTreeDescription description;
+        AI_CHECK(!description.readJson(documents[i].data(), documents[i].size()));
+        AI_CHECK(description.getError().find("too long") != std::string::npos);
+        AI_CHECK(description.getNumNodes() == 0);
+    }
+    return failures;
+}
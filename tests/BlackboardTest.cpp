@@ -0,0 +1,118 @@
+#include "Test.h"
+#include "Blackboard.h"
+#include "Scheduler.h"
+#include <btHashMap.h>
+
+using namespace ailib;
+
+namespace
+{
+
+typedef Blackboard<btHashInt> IntBlackboard;
+
+class CountingListener : public BlackboardListener<btHashInt>
+{
+public:
+    CountingListener() :
+        mCount(0),
+        mSum(0),
+        mLast(0)
+    {
+        ;
+    }
+
+    virtual void onValueChanged(const btHashInt& key, const ailib::hold_any& value)
+    {
+        UNUSED(key);
+        ++mCount;
+        mLast = ailib::any_cast<int>(value);
+        mSum += mLast;
+    }
+
+    int mCount;
+    int mSum;
+    int mLast;
+};
+
+} // namespace
+
+AI_TEST(BlackboardDispatcherFlushesAfterSchedulerClear)
+{
+    int failures = 0;
+
+    Scheduler scheduler;
+    BlackboardDispatcher dispatcher(scheduler);
+    IntBlackboard blackboard;
+    blackboard.setDispatch(DispatchDeferred, &dispatcher);
+
+    CountingListener listener;
+    blackboard.subscribe(btHashInt(1), &listener);
+
+    blackboard.set(btHashInt(1), 1);
+    scheduler.clear();
+    AI_CHECK(dispatcher.getStatus() == StatusTerminated);
+
+    // The key is still pending, writing it again has to wake the terminated dispatcher.
+    blackboard.set(btHashInt(1), 2);
+    scheduler.update(1000, 0.016f);
+    AI_CHECK(listener.mCount == 1);
+    AI_CHECK(listener.mLast == 2);
+
+    // Scheduling another blackboard flushes all pending ones.
+    IntBlackboard other;
+    CountingListener otherListener;
+    other.setDispatch(DispatchDeferred, &dispatcher);
+    other.addListener(&otherListener);
+    blackboard.set(btHashInt(1), 3);
+    scheduler.clear();
+    other.set(btHashInt(2), 4);
+    scheduler.update(1000, 0.016f);
+    AI_CHECK(listener.mCount == 2);
+    AI_CHECK(listener.mLast == 3);
+    AI_CHECK(otherListener.mCount == 1);
+    AI_CHECK(otherListener.mLast == 4);
+    AI_CHECK(dispatcher.getStatus() == StatusDormant);
+
+    scheduler.clear();
+    return failures;
+}
+
+AI_TEST(BlackboardNotifiesListenersOfAllKeysOncePerKey)
+{
+    int failures = 0;
+    const int NUM_KEYS = 100;
+
+    IntBlackboard blackboard;
+    CountingListener listener;
+    blackboard.addListener(&listener);
+
+    for(int i = 0; i < NUM_KEYS; ++i)
+    {
+        blackboard.set(btHashInt(i), 0);
+    }
+    AI_CHECK(listener.mCount == NUM_KEYS);
+
+    blackboard.setDispatch(DispatchDeferred);
+    for(int round = 1; round <= 2; ++round)
+    {
+        for(int i = 0; i < NUM_KEYS; ++i)
+        {
+            blackboard.set(btHashInt(i), round);
+        }
+    }
+    AI_CHECK(listener.mCount == NUM_KEYS);
+
+    blackboard.flush();
+    AI_CHECK(listener.mCount == 2 * NUM_KEYS);
+    AI_CHECK(listener.mSum == 2 * NUM_KEYS);
+
+    // A key subscribed to after it changed is reported to its new listener as well.
+    CountingListener subscriber;
+    blackboard.set(btHashInt(0), 5);
+    blackboard.subscribe(btHashInt(0), &subscriber);
+    blackboard.flush();
+    AI_CHECK(subscriber.mCount == 1);
+    AI_CHECK(subscriber.mLast == 5);
+    AI_CHECK(listener.mCount == 2 * NUM_KEYS + 1);
+    return failures;
+}
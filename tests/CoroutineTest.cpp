@@ -0,0 +1,99 @@
+#include "Test.h"
+#include "Coroutine.h"
+#include "Scheduler.h"
+#include <btHashMap.h>
+
+// Coroutine tasks require C++20, see Coroutine.h.
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+using namespace ailib;
+
+namespace
+{
+
+typedef Blackboard<btHashInt> IntBlackboard;
+
+// Completes once the key is set, so the test decides when waiters are woken.
+Coroutine waitForKey(IntBlackboard& blackboard)
+{
+    co_await waitForChange(blackboard, btHashInt(1));
+}
+
+Coroutine waitAndMark(CoroutineTask& other, bool& resumed)
+{
+    co_await waitFor(other);
+    resumed = true;
+}
+
+} // namespace
+
+AI_TEST(CoroutineWaiterTerminatedBeforeAwaitedTaskCompletes)
+{
+    int failures = 0;
+
+    Scheduler scheduler;
+    IntBlackboard blackboard;
+    bool resumed = false;
+    CoroutineTask worker(waitForKey(blackboard));
+    CoroutineTask waiter(waitAndMark(worker, resumed));
+    scheduler.enqueue(&worker);
+    scheduler.enqueue(&waiter);
+
+    scheduler.update(1000, 0.016f);
+    AI_CHECK(waiter.getStatus() == StatusWaiting);
+
+    // The completing worker mustn't revive the terminated waiter.
+    waiter.terminate();
+    blackboard.set(btHashInt(1), 1);
+    for(int i = 0; i < 5; ++i)
+    {
+        scheduler.update(1000, 0.016f);
+    }
+    AI_CHECK(worker.isDone());
+    AI_CHECK(worker.getStatus() == StatusTerminated);
+    AI_CHECK(waiter.getStatus() == StatusTerminated);
+    AI_CHECK(!resumed);
+
+    scheduler.clear();
+    return failures;
+}
+
+AI_TEST(CoroutineWaiterDestroyedBeforeAwaitedTaskCompletes)
+{
+    int failures = 0;
+
+    Scheduler scheduler;
+    IntBlackboard blackboard;
+    bool first = false;
+    bool second = false;
+    CoroutineTask worker(waitForKey(blackboard));
+    CoroutineTask* destroyed = new CoroutineTask(waitAndMark(worker, first));
+    CoroutineTask waiter(waitAndMark(worker, second));
+    scheduler.enqueue(&worker);
+    scheduler.enqueue(destroyed);
+    scheduler.enqueue(&waiter);
+
+    scheduler.update(1000, 0.016f);
+    AI_CHECK(destroyed->getStatus() == StatusWaiting);
+    AI_CHECK(waiter.getStatus() == StatusWaiting);
+
+    // Terminated directly rather than through CoroutineTask::terminate, then destroyed.
+    scheduler.dequeue(destroyed);
+    destroyed->setStatus(StatusTerminated);
+    delete destroyed;
+
+    blackboard.set(btHashInt(1), 1);
+    for(int i = 0; i < 5; ++i)
+    {
+        scheduler.update(1000, 0.016f);
+    }
+    AI_CHECK(worker.isDone());
+    AI_CHECK(!first);
+    AI_CHECK(second);
+    AI_CHECK(waiter.isDone());
+
+    scheduler.clear();
+    return failures;
+}
+
+#endif // __cpp_impl_coroutine
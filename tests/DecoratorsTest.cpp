@@ -0,0 +1,305 @@
+#include "Test.h"
+#include "Decorators.h"
+#include "Scheduler.h"
+
+using namespace ailib;
+
+namespace
+{
+
+// Fails its first __failFirst__ runs and succeeds afterwards, or waits until terminated.
+class ScriptedLeaf : public Behavior
+{
+public:
+    explicit ScriptedLeaf(uint32_t failFirst = 0, bool wait = false) :
+        mFailFirst(failFirst),
+        mWait(wait),
+        mRuns(0),
+        mLastStart(0)
+    {
+        ;
+    }
+
+    virtual void run()
+    {
+        ++mRuns;
+        mLastStart = HighResolutionTime::now();
+        if(mWait)
+        {
+            setStatus(StatusWaiting);
+        }
+        else if(mRuns <= mFailFirst)
+        {
+            notifyFailure();
+        }
+        else
+        {
+            notifySuccess();
+        }
+    }
+
+    uint32_t mFailFirst;
+    bool mWait;
+    uint32_t mRuns;
+    HighResolutionTime::Timestamp mLastStart;
+};
+
+class ResultCounter : public BehaviorListener
+{
+public:
+    ResultCounter() :
+        mSuccesses(0),
+        mFailures(0)
+    {
+        ;
+    }
+
+    virtual void onSuccess(Behavior* behavior)
+    {
+        UNUSED(behavior);
+        ++mSuccesses;
+    }
+
+    virtual void onFailure(Behavior* behavior)
+    {
+        UNUSED(behavior);
+        ++mFailures;
+    }
+
+    uint32_t mSuccesses;
+    uint32_t mFailures;
+};
+
+// Starts __root__ and updates __scheduler__ until the root finished, or gives up after a second.
+void runToCompletion(Scheduler& scheduler, Behavior& root)
+{
+    scheduler.enqueue(&root);
+    const HighResolutionTime::Timestamp start = HighResolutionTime::now();
+    while(root.getStatus() != StatusDormant &&
+          root.getStatus() != StatusTerminated &&
+          HighResolutionTime::now() - start < 1000000)
+    {
+        scheduler.update(1000, 0.016f);
+    }
+}
+
+} // namespace
+
+AI_TEST(SequenceStartsOverFromTheFirstChild)
+{
+    int failures = 0;
+
+    Scheduler scheduler;
+    ScriptedLeaf first;
+    ScriptedLeaf second;
+    Composite::BehaviorList children;
+    children.push_back(&first);
+    children.push_back(&second);
+    Sequence sequence(scheduler, children);
+
+    ResultCounter counter;
+    sequence.setListener(&counter);
+    runToCompletion(scheduler, sequence);
+    runToCompletion(scheduler, sequence);
+    AI_CHECK(counter.mSuccesses == 2);
+    AI_CHECK(first.mRuns == 2);
+    AI_CHECK(second.mRuns == 2);
+
+    // Repeated by a parent while its children are still reporting.
+    Repeat repeat(scheduler, &sequence, 3);
+    ResultCounter repeatCounter;
+    repeat.setListener(&repeatCounter);
+    runToCompletion(scheduler, repeat);
+    AI_CHECK(repeatCounter.mSuccesses == 1);
+    AI_CHECK(first.mRuns == 5);
+    AI_CHECK(second.mRuns == 5);
+
+    scheduler.clear();
+    return failures;
+}
+
+AI_TEST(InverterAndSucceederMapTheChildsResult)
+{
+    int failures = 0;
+
+    Scheduler scheduler;
+    ScriptedLeaf succeeding;
+    ScriptedLeaf failing(1000);
+    ResultCounter counter;
+
+    Inverter invertSuccess(scheduler, &succeeding);
+    invertSuccess.setListener(&counter);
+    runToCompletion(scheduler, invertSuccess);
+    AI_CHECK(counter.mFailures == 1);
+
+    Inverter invertFailure(scheduler, &failing);
+    invertFailure.setListener(&counter);
+    runToCompletion(scheduler, invertFailure);
+    AI_CHECK(counter.mSuccesses == 1);
+
+    Succeeder succeeder(scheduler, &failing);
+    succeeder.setListener(&counter);
+    runToCompletion(scheduler, succeeder);
+    AI_CHECK(counter.mSuccesses == 2);
+    AI_CHECK(counter.mFailures == 1);
+    AI_CHECK(succeeding.mRuns == 1);
+    AI_CHECK(failing.mRuns == 2);
+
+    scheduler.clear();
+    return failures;
+}
+
+AI_TEST(TimeoutFailsAndTerminatesOverdueChildren)
+{
+    int failures = 0;
+
+    Scheduler scheduler;
+    ScriptedLeaf stuck(0, true);
+    Timeout expiring(scheduler, &stuck, 2000);
+    ResultCounter counter;
+    expiring.setListener(&counter);
+
+    const HighResolutionTime::Timestamp start = HighResolutionTime::now();
+    runToCompletion(scheduler, expiring);
+    AI_CHECK(counter.mFailures == 1);
+    AI_CHECK(HighResolutionTime::now() - start >= 2000);
+    AI_CHECK(stuck.getStatus() == StatusTerminated);
+
+    // A child that finishes in time isn't failed later.
+    ScriptedLeaf quick;
+    Timeout timeout(scheduler, &quick, 2000);
+    ResultCounter quickCounter;
+    timeout.setListener(&quickCounter);
+    runToCompletion(scheduler, timeout);
+    AI_CHECK(quickCounter.mSuccesses == 1);
+
+    const HighResolutionTime::Timestamp finished = HighResolutionTime::now();
+    while(HighResolutionTime::now() - finished < 4000)
+    {
+        scheduler.update(1000, 0.016f);
+    }
+    AI_CHECK(quickCounter.mSuccesses == 1);
+    AI_CHECK(quickCounter.mFailures == 0);
+    AI_CHECK(quick.mRuns == 1);
+
+    scheduler.clear();
+    return failures;
+}
+
+AI_TEST(CooldownFailsOrWaitsUntilReady)
+{
+    int failures = 0;
+
+    Scheduler scheduler;
+    ScriptedLeaf leaf;
+    ResultCounter counter;
+
+    Cooldown failing(scheduler, &leaf, 100000, LimitFail);
+    failing.setListener(&counter);
+    runToCompletion(scheduler, failing);
+    runToCompletion(scheduler, failing);
+    AI_CHECK(counter.mSuccesses == 1);
+    AI_CHECK(counter.mFailures == 1);
+    AI_CHECK(leaf.mRuns == 1);
+
+    ScriptedLeaf waitingLeaf;
+    Cooldown waiting(scheduler, &waitingLeaf, 3000, LimitWait);
+    ResultCounter waitingCounter;
+    waiting.setListener(&waitingCounter);
+    runToCompletion(scheduler, waiting);
+    const HighResolutionTime::Timestamp readyTime = waiting.getReadyTime();
+    runToCompletion(scheduler, waiting);
+    AI_CHECK(waitingCounter.mSuccesses == 2);
+    AI_CHECK(waitingCounter.mFailures == 0);
+    AI_CHECK(waitingLeaf.mRuns == 2);
+    AI_CHECK(waitingLeaf.mLastStart >= readyTime);
+
+    scheduler.clear();
+    return failures;
+}
+
+AI_TEST(RateLimitFailsOrWaitsBeyondTheLimit)
+{
+    int failures = 0;
+
+    Scheduler scheduler;
+    ScriptedLeaf leaf;
+    ResultCounter counter;
+
+    RateLimit failing(scheduler, &leaf, 2, 100000, LimitFail);
+    failing.setListener(&counter);
+    for(int i = 0; i < 3; ++i)
+    {
+        runToCompletion(scheduler, failing);
+    }
+    AI_CHECK(counter.mSuccesses == 2);
+    AI_CHECK(counter.mFailures == 1);
+    AI_CHECK(leaf.mRuns == 2);
+
+    ScriptedLeaf waitingLeaf;
+    RateLimit waiting(scheduler, &waitingLeaf, 2, 3000, LimitWait);
+    ResultCounter waitingCounter;
+    waiting.setListener(&waitingCounter);
+    runToCompletion(scheduler, waiting);
+    const HighResolutionTime::Timestamp firstStart = waitingLeaf.mLastStart;
+    runToCompletion(scheduler, waiting);
+    runToCompletion(scheduler, waiting);
+    AI_CHECK(waitingCounter.mSuccesses == 3);
+    AI_CHECK(waitingCounter.mFailures == 0);
+    AI_CHECK(waitingLeaf.mRuns == 3);
+    // The third run waits until the first one left the window.
+    AI_CHECK(waitingLeaf.mLastStart >= firstStart + 3000);
+
+    scheduler.clear();
+    return failures;
+}
+
+AI_TEST(RetryAndRepeatRestartTheirChild)
+{
+    int failures = 0;
+
+    Scheduler scheduler;
+
+    // Succeeds on the second attempt.
+    ScriptedLeaf flaky(1);
+    Retry retry(scheduler, &flaky, 2);
+    ResultCounter retryCounter;
+    retry.setListener(&retryCounter);
+    runToCompletion(scheduler, retry);
+    AI_CHECK(retryCounter.mSuccesses == 1);
+    AI_CHECK(flaky.mRuns == 2);
+
+    // Gives up after the initial attempt and two retries.
+    ScriptedLeaf broken(1000);
+    Retry giveUp(scheduler, &broken, 2, 500);
+    ResultCounter giveUpCounter;
+    giveUp.setListener(&giveUpCounter);
+    runToCompletion(scheduler, giveUp);
+    AI_CHECK(giveUpCounter.mFailures == 1);
+    AI_CHECK(broken.mRuns == 3);
+
+    // Starting over resets the attempts.
+    runToCompletion(scheduler, giveUp);
+    AI_CHECK(giveUpCounter.mFailures == 2);
+    AI_CHECK(broken.mRuns == 6);
+
+    ScriptedLeaf leaf;
+    Repeat repeat(scheduler, &leaf, 3);
+    ResultCounter repeatCounter;
+    repeat.setListener(&repeatCounter);
+    runToCompletion(scheduler, repeat);
+    AI_CHECK(repeatCounter.mSuccesses == 1);
+    AI_CHECK(leaf.mRuns == 3);
+
+    // Fails as soon as the child fails.
+    ScriptedLeaf failing(1000);
+    Repeat failingRepeat(scheduler, &failing, 3);
+    ResultCounter failingCounter;
+    failingRepeat.setListener(&failingCounter);
+    runToCompletion(scheduler, failingRepeat);
+    AI_CHECK(failingCounter.mFailures == 1);
+    AI_CHECK(failing.mRuns == 1);
+
+    scheduler.clear();
+    return failures;
+}
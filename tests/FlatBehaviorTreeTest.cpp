@@ -0,0 +1,310 @@
+#include "Test.h"
+#include "FlatBehaviorTree.h"
+#include <set>
+#include <vector>
+
+using namespace ailib;
+
+namespace
+{
+
+// Returns a result set by the test and counts its executions and aborts.
+class ScriptedAction : public TreeAction
+{
+public:
+    explicit ScriptedAction(BehaviorResult result = ResultSuccess) :
+        mResult(result),
+        mExecutions(0),
+        mAborts(0)
+    {
+        ;
+    }
+
+    virtual BehaviorResult execute(BehaviorTreeInstance& instance)
+    {
+        UNUSED(instance);
+        ++mExecutions;
+        return mResult;
+    }
+
+    virtual void abort(BehaviorTreeInstance& instance)
+    {
+        UNUSED(instance);
+        ++mAborts;
+    }
+
+    BehaviorResult mResult;
+    uint32_t mExecutions;
+    uint32_t mAborts;
+};
+
+// Succeeds within its first run, or waits until the test completes it.
+class LeafBehavior : public Behavior
+{
+public:
+    explicit LeafBehavior(bool synchronous) :
+        mSynchronous(synchronous),
+        mRuns(0)
+    {
+        ;
+    }
+
+    virtual void run()
+    {
+        ++mRuns;
+        if(mSynchronous)
+        {
+            notifySuccess();
+        }
+        else
+        {
+            setStatus(StatusWaiting);
+        }
+    }
+
+    bool mSynchronous;
+    uint32_t mRuns;
+};
+
+} // namespace
+
+AI_TEST(FlatBehaviorTreeResumesSequencesAndSelectorsAtTheRunningChild)
+{
+    int failures = 0;
+
+    ScriptedAction first(ResultSuccess);
+    ScriptedAction second(ResultRunning);
+    ScriptedAction third(ResultSuccess);
+    BehaviorTreeDefinition sequence;
+    sequence.beginSequence();
+        sequence.action(&first);
+        sequence.action(&second);
+        sequence.action(&third);
+    sequence.end();
+
+    BehaviorTreeInstance instance(sequence);
+    AI_CHECK(sequence.tick(instance) == ResultRunning);
+    AI_CHECK(sequence.tick(instance) == ResultRunning);
+    AI_CHECK(first.mExecutions == 1);
+    AI_CHECK(second.mExecutions == 2);
+    AI_CHECK(third.mExecutions == 0);
+
+    second.mResult = ResultSuccess;
+    AI_CHECK(sequence.tick(instance) == ResultSuccess);
+    AI_CHECK(first.mExecutions == 1);
+    AI_CHECK(second.mExecutions == 3);
+    AI_CHECK(third.mExecutions == 1);
+    AI_CHECK(instance.getLastResult() == ResultSuccess);
+
+    // Finished sequences start over.
+    AI_CHECK(sequence.tick(instance) == ResultSuccess);
+    AI_CHECK(first.mExecutions == 2);
+
+    ScriptedAction failing(ResultFailure);
+    ScriptedAction running(ResultRunning);
+    BehaviorTreeDefinition selector;
+    selector.beginSelector();
+        selector.action(&failing);
+        selector.action(&running);
+    selector.end();
+
+    BehaviorTreeInstance other(selector);
+    AI_CHECK(selector.tick(other) == ResultRunning);
+    AI_CHECK(selector.tick(other) == ResultRunning);
+    AI_CHECK(failing.mExecutions == 1);
+    AI_CHECK(running.mExecutions == 2);
+
+    running.mResult = ResultFailure;
+    AI_CHECK(selector.tick(other) == ResultFailure);
+    AI_CHECK(failing.mExecutions == 1);
+    AI_CHECK(running.mExecutions == 3);
+    return failures;
+}
+
+AI_TEST(FlatBehaviorTreeParallelSucceedsFailsAndResets)
+{
+    int failures = 0;
+
+    ScriptedAction fast(ResultSuccess);
+    ScriptedAction slow(ResultRunning);
+    BehaviorTreeDefinition definition;
+    definition.beginParallel();
+        definition.action(&fast);
+        definition.action(&slow);
+    definition.end();
+
+    BehaviorTreeInstance instance(definition);
+    AI_CHECK(definition.tick(instance) == ResultRunning);
+    AI_CHECK(definition.tick(instance) == ResultRunning);
+    // Children that succeeded aren't executed again during the activation.
+    AI_CHECK(fast.mExecutions == 1);
+    AI_CHECK(slow.mExecutions == 2);
+
+    slow.mResult = ResultSuccess;
+    AI_CHECK(definition.tick(instance) == ResultSuccess);
+    AI_CHECK(fast.mExecutions == 1);
+    AI_CHECK(slow.mExecutions == 3);
+
+    // The next activation executes all children again.
+    fast.mResult = ResultRunning;
+    slow.mResult = ResultFailure;
+    AI_CHECK(definition.tick(instance) == ResultFailure);
+    AI_CHECK(fast.mExecutions == 2);
+    AI_CHECK(slow.mExecutions == 4);
+    // The failure ends the children that are still running.
+    AI_CHECK(fast.mAborts == 1);
+    AI_CHECK(slow.mAborts == 0);
+
+    slow.mResult = ResultRunning;
+    AI_CHECK(definition.tick(instance) == ResultRunning);
+    AI_CHECK(fast.mExecutions == 3);
+    AI_CHECK(fast.mAborts == 1);
+    return failures;
+}
+
+AI_TEST(FlatBehaviorTreeAbortReachesRunningActionsOnly)
+{
+    int failures = 0;
+
+    ScriptedAction done(ResultSuccess);
+    ScriptedAction running(ResultRunning);
+    ScriptedAction parallel(ResultRunning);
+    ScriptedAction fallback(ResultSuccess);
+    BehaviorTreeDefinition definition;
+    definition.beginSelector();
+        definition.beginSequence();
+            definition.action(&done);
+            definition.beginParallel();
+                definition.action(&running);
+                definition.action(&parallel);
+            definition.end();
+        definition.end();
+        definition.action(&fallback);
+    definition.end();
+
+    BehaviorTreeInstance instance(definition);
+    AI_CHECK(definition.tick(instance) == ResultRunning);
+
+    definition.abort(instance);
+    AI_CHECK(done.mAborts == 0);
+    AI_CHECK(running.mAborts == 1);
+    AI_CHECK(parallel.mAborts == 1);
+    AI_CHECK(fallback.mAborts == 0);
+
+    // Aborting an idle tree does nothing, the next tick starts over.
+    definition.abort(instance);
+    AI_CHECK(running.mAborts == 1);
+    AI_CHECK(definition.tick(instance) == ResultRunning);
+    AI_CHECK(done.mExecutions == 2);
+    AI_CHECK(running.mExecutions == 2);
+    return failures;
+}
+
+AI_TEST(FlatBehaviorTreeRunsLeafBehaviors)
+{
+    int failures = 0;
+
+    BehaviorAction syncAction(0);
+    BehaviorAction asyncAction(1);
+    BehaviorTreeDefinition definition;
+    definition.beginSequence();
+        definition.action(&syncAction);
+        definition.action(&asyncAction);
+    definition.end();
+
+    LeafBehavior sync(true);
+    LeafBehavior async(false);
+    BehaviorTreeInstance instance(definition);
+    instance.setLeaf(0, &sync);
+    instance.setLeaf(1, &async);
+
+    // The synchronous leaf finishes within the tick, the asynchronous one starts waiting.
+    AI_CHECK(definition.tick(instance) == ResultRunning);
+    AI_CHECK(sync.mRuns == 1);
+    AI_CHECK(sync.getStatus() == StatusDormant);
+    AI_CHECK(async.mRuns == 1);
+    AI_CHECK(async.getStatus() == StatusWaiting);
+
+    // Waiting leaves aren't run.
+    AI_CHECK(definition.tick(instance) == ResultRunning);
+    AI_CHECK(async.mRuns == 1);
+
+    // The result reported between ticks is picked up by the next tick.
+    async.notifySuccess();
+    AI_CHECK(definition.tick(instance) == ResultSuccess);
+    AI_CHECK(sync.mRuns == 1);
+    AI_CHECK(async.mRuns == 1);
+
+    // Aborting the tree terminates the waiting leaf.
+    AI_CHECK(definition.tick(instance) == ResultRunning);
+    AI_CHECK(sync.mRuns == 2);
+    AI_CHECK(async.mRuns == 2);
+    definition.abort(instance);
+    AI_CHECK(async.getStatus() == StatusTerminated);
+    AI_CHECK(definition.tick(instance) == ResultRunning);
+    AI_CHECK(sync.mRuns == 3);
+    AI_CHECK(async.mRuns == 3);
+    return failures;
+}
+
+AI_TEST(BehaviorTreeInstancePoolReusesSlotsAcrossChunks)
+{
+    int failures = 0;
+    const uint32_t INSTANCES_PER_CHUNK = 2;
+    const uint32_t NUM_INSTANCES = 5;
+
+    ScriptedAction first(ResultSuccess);
+    ScriptedAction second(ResultRunning);
+    BehaviorTreeDefinition definition;
+    definition.beginSequence();
+        definition.action(&first);
+        definition.action(&second);
+    definition.end();
+
+    BehaviorTreeInstancePool pool(definition, INSTANCES_PER_CHUNK);
+    std::vector<BehaviorTreeInstance*> instances;
+    for(uint32_t i = 0; i < NUM_INSTANCES; ++i)
+    {
+        instances.push_back(pool.create());
+        AI_CHECK(reinterpret_cast<uintptr_t>(instances.back()) % sizeof(void*) == 0);
+        AI_CHECK(definition.tick(*instances.back()) == ResultRunning);
+    }
+    AI_CHECK(pool.size() == NUM_INSTANCES);
+    AI_CHECK(std::set<BehaviorTreeInstance*>(instances.begin(), instances.end()).size() ==
+             NUM_INSTANCES);
+
+    // Release slots of the first and the last chunk.
+    BehaviorTreeInstance* const released[] = { instances[0], instances[4] };
+    pool.destroy(instances[0]);
+    pool.destroy(instances[4]);
+    AI_CHECK(pool.size() == NUM_INSTANCES - 2);
+
+    std::set<BehaviorTreeInstance*> reused;
+    reused.insert(pool.create(&first));
+    reused.insert(pool.create(&second));
+    AI_CHECK(reused.count(released[0]) == 1);
+    AI_CHECK(reused.count(released[1]) == 1);
+    AI_CHECK(pool.size() == NUM_INSTANCES);
+
+    // Reused slots start with a fresh state, the other instances keep theirs.
+    const uint32_t executions = first.mExecutions;
+    for(std::set<BehaviorTreeInstance*>::iterator it = reused.begin(); it != reused.end(); ++it)
+    {
+        AI_CHECK((*it)->getContext() == &first || (*it)->getContext() == &second);
+        AI_CHECK(definition.tick(**it) == ResultRunning);
+    }
+    AI_CHECK(first.mExecutions == executions + 2);
+    AI_CHECK(definition.tick(*instances[2]) == ResultRunning);
+    AI_CHECK(first.mExecutions == executions + 2);
+
+    for(std::set<BehaviorTreeInstance*>::iterator it = reused.begin(); it != reused.end(); ++it)
+    {
+        pool.destroy(*it);
+    }
+    for(uint32_t i = 1; i < NUM_INSTANCES - 1; ++i)
+    {
+        pool.destroy(instances[i]);
+    }
+    AI_CHECK(pool.size() == 0);
+    return failures;
+}
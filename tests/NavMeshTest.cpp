@@ -0,0 +1,186 @@
+#include "Test.h"
+#include "NavMesh.h"
+
+using namespace ailib;
+
+namespace
+{
+
+// Adds the axis-aligned rectangle [x0, x1] x [z0, z1] at height 0 as two triangles.
+void addQuad(btAlignedObjectArray<btVector3>& vertices,
+             btAlignedObjectArray<uint32_t>& indices,
+             btScalar x0, btScalar z0, btScalar x1, btScalar z1)
+{
+    const uint32_t first = vertices.size();
+    vertices.push_back(btVector3(x0, 0, z0));
+    vertices.push_back(btVector3(x1, 0, z0));
+    vertices.push_back(btVector3(x1, 0, z1));
+    vertices.push_back(btVector3(x0, 0, z1));
+
+    const uint32_t triangles[] = { 0, 1, 2, 0, 2, 3 };
+    for(uint32_t i = 0; i < 6; ++i)
+    {
+        indices.push_back(first + triangles[i]);
+    }
+}
+
+// @returns true if __position__ lies inside or on the boundary of __polygon__ in the XZ plane.
+bool covers(const NavMesh& mesh, uint16_t polygon, const btVector3& position)
+{
+    if(polygon == NavMesh::INVALID_POLYGON)
+    {
+        return false;
+    }
+
+    const NavMeshPolygon& node = *mesh.getGraph().getNode(polygon);
+    for(uint32_t i = 0; i < node.numVertices; ++i)
+    {
+        const btVector3& a = mesh.getVertex(node.vertices[i]);
+        const btVector3& b = mesh.getVertex(node.vertices[(i+1) % node.numVertices]);
+        const btScalar side = (b.x() - a.x()) * (position.z() - a.z()) -
+                              (position.x() - a.x()) * (b.z() - a.z());
+        if(side < btScalar(-1e-4))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool near(const btVector3& lv, const btVector3& rv)
+{
+    return lv.distance(rv) < btScalar(1e-3);
+}
+
+} // namespace
+
+AI_TEST(NavMeshFindsPolygonsOnSharedEdgesAndVertices)
+{
+    int failures = 0;
+
+    // A 2x2 grid of unit squares, kept as triangles so many polygons share edges and vertices.
+    btAlignedObjectArray<btVector3> vertices;
+    btAlignedObjectArray<uint32_t> indices;
+    for(int z = 0; z < 2; ++z)
+    {
+        for(int x = 0; x < 2; ++x)
+        {
+            addQuad(vertices, indices, x, z, x + 1, z + 1);
+        }
+    }
+
+    const btVector3 inside[] =
+    {
+        // Interior, on a diagonal and on an edge shared by two squares.
+        btVector3(btScalar(0.25), 0, btScalar(0.75)),
+        btVector3(btScalar(0.5), 0, btScalar(0.5)),
+        btVector3(1, 0, btScalar(0.5)),
+        btVector3(btScalar(1.5), 0, 1),
+        // The vertex shared by all squares, and the corners of the mesh.
+        btVector3(1, 0, 1),
+        btVector3(0, 0, 0),
+        btVector3(2, 0, 2),
+        btVector3(2, 0, 0),
+        // Within the height tolerance.
+        btVector3(btScalar(1.5), btScalar(1.5), btScalar(1.5))
+    };
+
+    // Grid cells that are chosen automatically, align with the squares or cut through them.
+    const btScalar cellSizes[] = { 0, 1, btScalar(0.3) };
+    for(uint32_t i = 0; i < sizeof(cellSizes) / sizeof(cellSizes[0]); ++i)
+    {
+        NavMesh::BuildParameters params;
+        params.maxVerticesPerPolygon = 3;
+        params.cellSize = cellSizes[i];
+
+        NavMesh mesh;
+        AI_CHECK(mesh.build(vertices, indices, params));
+        AI_CHECK(mesh.getNumPolygons() == 8);
+
+        for(uint32_t j = 0; j < sizeof(inside) / sizeof(inside[0]); ++j)
+        {
+            AI_CHECK(covers(mesh, mesh.findPolygon(inside[j]), inside[j]));
+        }
+
+        AI_CHECK(mesh.findPolygon(btVector3(btScalar(-0.5), 0, btScalar(0.5))) ==
+                 NavMesh::INVALID_POLYGON);
+        AI_CHECK(mesh.findPolygon(btVector3(btScalar(2.5), 0, btScalar(2.5))) ==
+                 NavMesh::INVALID_POLYGON);
+        AI_CHECK(mesh.findPolygon(btVector3(btScalar(0.5), 5, btScalar(0.5))) ==
+                 NavMesh::INVALID_POLYGON);
+    }
+    return failures;
+}
+
+AI_TEST(NavMeshPathThroughStraightCorridorIsStraight)
+{
+    int failures = 0;
+
+    btAlignedObjectArray<btVector3> vertices;
+    btAlignedObjectArray<uint32_t> indices;
+    for(int x = 0; x < 10; ++x)
+    {
+        addQuad(vertices, indices, x, 0, x + 1, 1);
+    }
+
+    NavMesh mesh;
+    AI_CHECK(mesh.build(vertices, indices));
+    AI_CHECK(mesh.getNumPolygons() > 1);
+
+    const btVector3 start(btScalar(0.5), 0, btScalar(0.25));
+    const btVector3 goal(btScalar(9.5), 0, btScalar(0.75));
+    NavMesh::path_type path;
+    AI_CHECK(mesh.findPath(start, goal, path));
+    AI_CHECK(path.size() == 2);
+    if(path.size() == 2)
+    {
+        AI_CHECK(near(path[0], start));
+        AI_CHECK(near(path[1], goal));
+    }
+    return failures;
+}
+
+AI_TEST(NavMeshPathThroughLShapedCorridorBendsAtInnerCorner)
+{
+    int failures = 0;
+
+    // A horizontal arm along +X and a vertical arm along +Z, joined at the square [2, 3]^2.
+    btAlignedObjectArray<btVector3> vertices;
+    btAlignedObjectArray<uint32_t> indices;
+    for(int x = 0; x < 3; ++x)
+    {
+        addQuad(vertices, indices, x, 0, x + 1, 1);
+    }
+    for(int z = 1; z < 4; ++z)
+    {
+        addQuad(vertices, indices, 2, z, 3, z + 1);
+    }
+
+    NavMesh mesh;
+    AI_CHECK(mesh.build(vertices, indices));
+
+    const btVector3 start(btScalar(0.5), 0, btScalar(0.5));
+    const btVector3 goal(btScalar(2.5), 0, btScalar(3.5));
+    const btVector3 corner(2, 0, 1);
+
+    // Both directions, so the corner is found on either side of the funnel.
+    NavMesh::path_type path;
+    AI_CHECK(mesh.findPath(start, goal, path));
+    AI_CHECK(path.size() == 3);
+    if(path.size() == 3)
+    {
+        AI_CHECK(near(path[0], start));
+        AI_CHECK(near(path[1], corner));
+        AI_CHECK(near(path[2], goal));
+    }
+
+    AI_CHECK(mesh.findPath(goal, start, path));
+    AI_CHECK(path.size() == 3);
+    if(path.size() == 3)
+    {
+        AI_CHECK(near(path[0], goal));
+        AI_CHECK(near(path[1], corner));
+        AI_CHECK(near(path[2], start));
+    }
+    return failures;
+}
@@ -0,0 +1,135 @@
+#include "Test.h"
+#include "ParallelScheduler.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace ailib;
+
+namespace
+{
+
+const uint32_t NUM_THREADS = 4;
+const uint32_t NUM_KEYS = 8;
+const uint32_t TASKS_PER_KEY = 4;
+const uint32_t RUNS_PER_TASK = 20;
+
+// Detects tasks of the same key running at the same time.
+class StrandState
+{
+public:
+    StrandState() :
+        mInFlight(0),
+        mOverlaps(0)
+    {
+        ;
+    }
+
+    std::atomic<uint32_t> mInFlight;
+    std::atomic<uint32_t> mOverlaps;
+};
+
+class KeyedTask : public Task
+{
+public:
+    KeyedTask() :
+        mStrand(NULL),
+        mRuns(0)
+    {
+        ;
+    }
+
+    virtual void run()
+    {
+        if(mStrand->mInFlight.fetch_add(1) != 0)
+        {
+            mStrand->mOverlaps.fetch_add(1);
+        }
+
+        // Let the other workers run while this task is in flight.
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+
+        mStrand->mInFlight.fetch_sub(1);
+
+        if(++mRuns == RUNS_PER_TASK)
+        {
+            setStatus(StatusTerminated);
+        }
+    }
+
+    StrandState* mStrand;
+    // Only accessed by the strand's worker.
+    uint32_t mRuns;
+};
+
+// Enqueues every __stride__th task, starting at __first__, with the key of its strand.
+void enqueueAll(ParallelScheduler* scheduler, std::vector<KeyedTask>* tasks,
+                uint32_t first, uint32_t stride)
+{
+    for(uint32_t i = first; i < tasks->size(); i += stride)
+    {
+        scheduler->enqueue(&(*tasks)[i], i % NUM_KEYS);
+    }
+}
+
+bool allTerminated(const std::vector<KeyedTask>& tasks)
+{
+    for(uint32_t i = 0; i < tasks.size(); ++i)
+    {
+        if(tasks[i].getStatus() != StatusTerminated)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+AI_TEST(ParallelSchedulerNeverRunsTasksOfOneKeyConcurrently)
+{
+    int failures = 0;
+
+    ParallelScheduler scheduler(NUM_THREADS);
+    scheduler.setSliceRuntime(100);
+
+    std::vector<StrandState> strands(NUM_KEYS);
+    std::vector<KeyedTask> tasks(NUM_KEYS * TASKS_PER_KEY);
+    for(uint32_t i = 0; i < tasks.size(); ++i)
+    {
+        tasks[i].mStrand = &strands[i % NUM_KEYS];
+    }
+
+    // Every producer enqueues some tasks of every key while the scheduler updates.
+    std::vector<std::thread> producers;
+    for(uint32_t i = 0; i < NUM_THREADS; ++i)
+    {
+        producers.push_back(std::thread(&enqueueAll, &scheduler, &tasks, i, NUM_THREADS));
+    }
+    for(uint32_t update = 0; update < 10; ++update)
+    {
+        scheduler.update(2000, 0.016f);
+    }
+    for(uint32_t i = 0; i < producers.size(); ++i)
+    {
+        producers[i].join();
+    }
+
+    for(uint32_t update = 0; update < 1000 && !allTerminated(tasks); ++update)
+    {
+        scheduler.update(2000, 0.016f);
+    }
+
+    for(uint32_t i = 0; i < tasks.size(); ++i)
+    {
+        AI_CHECK(tasks[i].mRuns == RUNS_PER_TASK);
+    }
+    for(uint32_t i = 0; i < strands.size(); ++i)
+    {
+        AI_CHECK(strands[i].mOverlaps.load() == 0);
+    }
+
+    scheduler.clear();
+    return failures;
+}
@@ -0,0 +1,93 @@
+#include "Test.h"
+#include "Random.h"
+#include "HighResolutionTime.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+using namespace ailib;
+
+namespace
+{
+
+const uint32_t NUM_DRAWS = 10000000;
+// The number of children of a typical random composite.
+const uint32_t BOUND = 7;
+
+// Keeps the compiler from discarding the draws.
+volatile uint32_t gSink = 0;
+
+class StdRand
+{
+public:
+    uint32_t next()
+    {
+        return static_cast<uint32_t>(std::rand());
+    }
+
+    uint32_t nextBelow(uint32_t bound)
+    {
+        return static_cast<uint32_t>(std::rand()) % bound;
+    }
+
+    float nextFloat()
+    {
+        return static_cast<float>(std::rand()) / RAND_MAX;
+    }
+};
+
+// @returns The average time per draw in nanoseconds.
+template <typename GENERATOR>
+double drawBounded(GENERATOR& generator)
+{
+    uint32_t sum = 0;
+    const HighResolutionTime::Timestamp start = HighResolutionTime::now();
+    for(uint32_t i = 0; i < NUM_DRAWS; ++i)
+    {
+        sum += generator.nextBelow(BOUND);
+    }
+    const HighResolutionTime::Timestamp duration = HighResolutionTime::now() - start;
+    gSink = sum;
+    return duration * 1000.0 / NUM_DRAWS;
+}
+
+template <typename GENERATOR>
+double drawFloats(GENERATOR& generator)
+{
+    float sum = 0.0f;
+    const HighResolutionTime::Timestamp start = HighResolutionTime::now();
+    for(uint32_t i = 0; i < NUM_DRAWS; ++i)
+    {
+        sum += generator.nextFloat();
+    }
+    const HighResolutionTime::Timestamp duration = HighResolutionTime::now() - start;
+    gSink = static_cast<uint32_t>(sum);
+    return duration * 1000.0 / NUM_DRAWS;
+}
+
+} // namespace
+
+AI_BENCHMARK(RandomThroughput)
+{
+    StdRand stdRand;
+    Random random;
+
+    // Best of a few alternating runs.
+    double stdBounded = std::numeric_limits<double>::max();
+    double randomBounded = std::numeric_limits<double>::max();
+    double stdFloats = std::numeric_limits<double>::max();
+    double randomFloats = std::numeric_limits<double>::max();
+    for(uint32_t i = 0; i < 3; ++i)
+    {
+        stdBounded = std::min(stdBounded, drawBounded(stdRand));
+        randomBounded = std::min(randomBounded, drawBounded(random));
+        stdFloats = std::min(stdFloats, drawFloats(stdRand));
+        randomFloats = std::min(randomFloats, drawFloats(random));
+    }
+
+    std::printf("Below %u: rand() %.2f ns per draw, Random %.2f ns per draw\n",
+                BOUND, stdBounded, randomBounded);
+    std::printf("Floats: rand() %.2f ns per draw, Random %.2f ns per draw\n",
+                stdFloats, randomFloats);
+    return 0;
+}
@@ -0,0 +1,361 @@
+#include "Test.h"
+#include "Scheduler.h"
+#include "Random.h"
+#include <vector>
+
+using namespace ailib;
+
+/*
+ * Randomized test of the scheduler's state machine. Tasks change their own status and the
+ * status of other tasks, enqueue, dequeue and terminate tasks from within run() and between
+ * updates, following the scheduler's contract: only inactive tasks (dormant, terminated or
+ * removed) and the executing task are enqueued. After every step, the scheduler's sets must
+ * be consistent (Scheduler::validate) and must match the tasks reported to a
+ * SchedulerListener. No task may be lost, i.e. be active and attached without being part
+ * of the scheduler, running tasks must eventually run, and requests of the executing task
+ * to restart or remove itself must be honored once it returns.
+ */
+
+namespace
+{
+
+const uint32_t NUM_TASKS = 24;
+const uint32_t NUM_SEEDS = 16;
+const uint32_t NUM_UPDATES = 1500;
+// A running task that didn't run for this many updates is considered lost.
+const uint32_t MAX_STARVED_UPDATES = 200;
+
+class Fuzzer;
+
+class FuzzTask : public Task
+{
+public:
+    FuzzTask() :
+        mFuzzer(NULL),
+        mLastRun(0),
+        mMember(false),
+        mPosted(false),
+        mDraining(false)
+    {
+        ;
+    }
+
+    virtual void run();
+
+    Fuzzer* mFuzzer;
+    uint32_t mLastRun;
+    // Whether the scheduler reported the task as added and not yet removed.
+    bool mMember;
+    // Posted tasks are left alone until the inbox was drained.
+    bool mPosted;
+    bool mDraining;
+};
+
+class Fuzzer : public SchedulerListener
+{
+public:
+    Fuzzer(uint64_t seed) :
+        mRandom(seed),
+        mTasks(NUM_TASKS),
+        mFinished(NULL),
+        mFinishedStatus(StatusDormant),
+        mRequest(RequestNone),
+        mUpdate(0),
+        mFailures(0)
+    {
+        mScheduler.setListener(this);
+        mScheduler.setValidating(true);
+        for(uint32_t i = 0; i < NUM_TASKS; ++i)
+        {
+            mTasks[i].mFuzzer = this;
+        }
+    }
+
+    ~Fuzzer()
+    {
+        mScheduler.setListener(NULL);
+        mScheduler.clear();
+    }
+
+    int run()
+    {
+        for(uint32_t i = 0; i < NUM_TASKS; i += 2)
+        {
+            mScheduler.enqueue(&mTasks[i]);
+        }
+
+        // Stops at the first inconsistency, the following ones are likely caused by it.
+        for(mUpdate = 1; mUpdate <= NUM_UPDATES && mFailures == 0; ++mUpdate)
+        {
+            const uint32_t numActions = mRandom.nextBelow(4);
+            for(uint32_t i = 0; i < numActions; ++i)
+            {
+                act(NULL);
+            }
+            check(NULL);
+
+            // The update drains the requests posted until now. Requests posted during the
+            // update are drained by the next one.
+            for(uint32_t i = 0; i < NUM_TASKS; ++i)
+            {
+                mTasks[i].mDraining = mTasks[i].mPosted;
+            }
+
+            // A small budget, so tasks that keep running don't monopolize the update.
+            mScheduler.update(200, 0.016f);
+            checkFinished();
+            for(uint32_t i = 0; i < NUM_TASKS; ++i)
+            {
+                if(mTasks[i].mDraining)
+                {
+                    mTasks[i].mPosted = false;
+                    mTasks[i].mDraining = false;
+                }
+            }
+            check(NULL);
+        }
+
+        if(mFailures != 0)
+        {
+            std::printf("Inconsistent in update %u.\n", mUpdate - 1);
+        }
+        return mFailures;
+    }
+
+    // Performs a random action on behalf of __current__ (NULL between updates).
+    void act(FuzzTask* current)
+    {
+        FuzzTask* task = &mTasks[mRandom.nextBelow(NUM_TASKS)];
+        if(task == current)
+        {
+            actOnCurrent(current);
+        }
+        else if(!task->mPosted)
+        {
+            actOnOther(task);
+        }
+        check(current);
+    }
+
+    void onTaskRun(FuzzTask* task)
+    {
+        task->mLastRun = mUpdate;
+        mRequest = RequestNone;
+        const uint32_t numActions = mRandom.nextBelow(3);
+        for(uint32_t i = 0; i < numActions; ++i)
+        {
+            act(task);
+        }
+
+        // How the task's execution ends.
+        switch(mRandom.nextBelow(6))
+        {
+        case 0:
+            task->setStatus(StatusRunning);
+            break;
+        case 1:
+            task->setStatus(StatusWaiting);
+            break;
+        case 2:
+            task->setStatus(StatusDormant);
+            break;
+        case 3:
+            task->setStatus(StatusTerminated);
+            break;
+        case 4:
+            task->sleepFor(mRandom.nextBelow(2000));
+            break;
+        default:
+            // Keep the status set by the actions.
+            break;
+        }
+        check(task);
+
+        mFinished = task;
+        mFinishedStatus = task->getStatus();
+    }
+
+    virtual void onBeginRunTask(Task* task)
+    {
+        UNUSED(task);
+        checkFinished();
+    }
+
+    virtual void onTaskAdded(Task* task)
+    {
+        FuzzTask* fuzzTask = static_cast<FuzzTask*>(task);
+        int& failures = mFailures;
+        AI_CHECK(!fuzzTask->mMember);
+        fuzzTask->mMember = true;
+    }
+
+    virtual void onTaskRemoved(Task* task)
+    {
+        FuzzTask* fuzzTask = static_cast<FuzzTask*>(task);
+        int& failures = mFailures;
+        AI_CHECK(fuzzTask->mMember);
+        fuzzTask->mMember = false;
+    }
+private:
+    static bool isActive(const Task* task)
+    {
+        return task->getStatus() == StatusRunning ||
+               task->getStatus() == StatusWaiting ||
+               task->getStatus() == StatusSleeping;
+    }
+
+    void actOnCurrent(FuzzTask* current)
+    {
+        switch(mRandom.nextBelow(7))
+        {
+        case 0:
+            // Restart after returning.
+            mScheduler.enqueue(current);
+            mRequest = RequestRestart;
+            break;
+        case 1:
+            mScheduler.dequeue(current);
+            mRequest = RequestRemove;
+            break;
+        case 2:
+            current->sleepFor(mRandom.nextBelow(2000));
+            break;
+        default:
+            current->setStatus(static_cast<Status>(mRandom.nextBelow(StatusTerminated + 1)));
+            break;
+        }
+    }
+
+    void actOnOther(FuzzTask* task)
+    {
+        // The scheduler is the only listener.
+        const bool attached = task->getListener() != NULL;
+        if(attached && isActive(task))
+        {
+            switch(mRandom.nextBelow(7))
+            {
+            case 0:
+                mScheduler.dequeue(task);
+                break;
+            case 1:
+                task->sleepFor(mRandom.nextBelow(2000));
+                break;
+            case 2:
+                mScheduler.postStatus(task, static_cast<Status>(mRandom.nextBelow(StatusTerminated + 1)));
+                task->mPosted = true;
+                break;
+            default:
+                task->setStatus(static_cast<Status>(mRandom.nextBelow(StatusTerminated + 1)));
+                break;
+            }
+        }
+        else if(attached && task->getStatus() == StatusDormant && mRandom.nextBelow(2) == 0)
+        {
+            // Dormant tasks are started by their status.
+            task->setStatus(StatusRunning);
+        }
+        else if(mRandom.nextBelow(4) == 0)
+        {
+            mScheduler.post(task);
+            task->mPosted = true;
+        }
+        else
+        {
+            mScheduler.enqueue(task);
+        }
+    }
+
+    /*
+     * Checks what the scheduler did with the task that ran last. Called before anything else
+     * can change the task: when the next task starts or the update returns.
+     */
+    void checkFinished()
+    {
+        FuzzTask* task = mFinished;
+        if(!task)
+        {
+            return;
+        }
+        mFinished = NULL;
+
+        int& failures = mFailures;
+        AI_CHECK(task->getStatus() == (mFinishedStatus == StatusDormant &&
+                                       mRequest == RequestRestart ? StatusRunning :
+                                                                    mFinishedStatus));
+        if(mRequest == RequestRemove || mFinishedStatus == StatusTerminated)
+        {
+            // Removed by the scheduler.
+            AI_CHECK(!task->mMember && task->getListener() == NULL);
+        }
+        else
+        {
+            // Queued according to its status, dormant tasks stay attached.
+            AI_CHECK(task->mMember == isActive(task) && task->getListener() != NULL);
+        }
+    }
+
+    // Compares the scheduler's state with the statuses of the tasks.
+    void check(const FuzzTask* current)
+    {
+        int& failures = mFailures;
+        AI_CHECK(mScheduler.validate());
+
+        for(uint32_t i = 0; i < NUM_TASKS; ++i)
+        {
+            const FuzzTask& task = mTasks[i];
+            if(&task == current)
+            {
+                continue;
+            }
+
+            // Active tasks are either part of the scheduler or were removed from it.
+            const bool expected = isActive(&task) && task.getListener() != NULL;
+            AI_CHECK(task.mMember == expected);
+
+            if(current == NULL && task.mMember && task.getStatus() == StatusRunning)
+            {
+                AI_CHECK(mUpdate - task.mLastRun < MAX_STARVED_UPDATES);
+            }
+        }
+
+    }
+
+    // The last request of the executing task concerning itself.
+    enum Request
+    {
+        RequestNone = 0,
+        RequestRestart,
+        RequestRemove
+    };
+
+    Random mRandom;
+    Scheduler mScheduler;
+    std::vector<FuzzTask> mTasks;
+    FuzzTask* mFinished;
+    Status mFinishedStatus;
+    Request mRequest;
+    uint32_t mUpdate;
+    int mFailures;
+};
+
+void FuzzTask::run()
+{
+    mFuzzer->onTaskRun(this);
+}
+
+} // namespace
+
+AI_TEST(SchedulerSurvivesRandomReentrantChanges)
+{
+    int failures = 0;
+    for(uint64_t seed = 1; seed <= NUM_SEEDS && failures == 0; ++seed)
+    {
+        Fuzzer fuzzer(seed);
+        failures += fuzzer.run();
+        if(failures != 0)
+        {
+            std::printf("Failed with seed %llu.\n", static_cast<unsigned long long>(seed));
+        }
+    }
+    return failures;
+}
@@ -0,0 +1,120 @@
+#include "Test.h"
+#include "Scheduler.h"
+
+using namespace ailib;
+
+namespace
+{
+
+// Busy waits for the given time in every run. Keeps running unless told to finish.
+class BusyTask : public Task
+{
+public:
+    explicit BusyTask(HighResolutionTime::Timestamp duration) :
+        mDuration(duration),
+        mRuns(0),
+        mFinish(false)
+    {
+        ;
+    }
+
+    virtual void run()
+    {
+        ++mRuns;
+        const HighResolutionTime::Timestamp start = HighResolutionTime::now();
+        while(HighResolutionTime::now() - start < mDuration)
+        {
+            ;
+        }
+        if(mFinish)
+        {
+            setStatus(StatusDormant);
+        }
+    }
+
+    HighResolutionTime::Timestamp mDuration;
+    uint32_t mRuns;
+    bool mFinish;
+};
+
+} // namespace
+
+AI_TEST(SchedulerCountsOnlyUpdatesThatLeaveTasksOut)
+{
+    int failures = 0;
+    const uint32_t NUM_UPDATES = 5;
+
+    // A persistent task that fits the budget runs until the budget is used up in every
+    // update, nothing is left out.
+    {
+        Scheduler scheduler;
+        BusyTask task(0);
+        task.setStatus(StatusRunning);
+        scheduler.enqueue(&task);
+        for(uint32_t i = 0; i < NUM_UPDATES; ++i)
+        {
+            scheduler.update(2000, 0.016f);
+        }
+        AI_CHECK(task.mRuns >= NUM_UPDATES);
+        AI_CHECK(scheduler.getStatistics().overloadedUpdates == 0);
+        scheduler.clear();
+    }
+
+    // Only one of two tasks exceeding the budget runs per update.
+    {
+        Scheduler scheduler;
+        BusyTask first(2000);
+        BusyTask second(2000);
+        first.setStatus(StatusRunning);
+        second.setStatus(StatusRunning);
+        scheduler.enqueue(&first);
+        scheduler.enqueue(&second);
+        for(uint32_t i = 0; i < NUM_UPDATES; ++i)
+        {
+            scheduler.update(1000, 0.016f);
+        }
+        AI_CHECK(first.mRuns + second.mRuns == NUM_UPDATES);
+        AI_CHECK(scheduler.getStatistics().overloadedUpdates == NUM_UPDATES);
+        scheduler.clear();
+    }
+    return failures;
+}
+
+AI_TEST(SchedulerCountsMissedDeadlinesOfQueuedTasksOnce)
+{
+    int failures = 0;
+
+    DeadlinePolicy policy;
+    Scheduler scheduler(&policy);
+
+    // The critical task takes up the whole budget, the normal one never gets to run.
+    BusyTask busy(2000);
+    busy.setPriority(PriorityCritical);
+    busy.setStatus(StatusRunning);
+    scheduler.enqueue(&busy);
+
+    BusyTask starved(0);
+    starved.setPriority(PriorityNormal);
+    starved.setDeadline(HighResolutionTime::now() + 1000);
+    starved.setStatus(StatusRunning);
+    scheduler.enqueue(&starved);
+
+    for(uint32_t i = 0; i < 5; ++i)
+    {
+        scheduler.update(1000, 0.016f);
+    }
+    AI_CHECK(starved.mRuns == 0);
+    AI_CHECK(scheduler.getStatistics().deadlineMisses[PriorityNormal] == 1);
+    AI_CHECK(scheduler.getStatistics().deadlineMisses[PriorityCritical] == 0);
+
+    // Once it runs and completes late, the activation isn't counted again.
+    busy.setStatus(StatusDormant);
+    starved.mFinish = true;
+    scheduler.update(100000, 0.016f);
+    AI_CHECK(starved.mRuns == 1);
+    AI_CHECK(starved.getStatus() == StatusDormant);
+    AI_CHECK(scheduler.getStatistics().deadlineMisses[PriorityNormal] == 1);
+
+    scheduler.clear();
+    return failures;
+}
@@ -0,0 +1,263 @@
+#include "Test.h"
+#include "TaskInbox.h"
+#include "Scheduler.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace ailib;
+
+namespace
+{
+
+const uint32_t NUM_PRODUCERS = 4;
+
+class CountingTask : public Task
+{
+public:
+    CountingTask() :
+        mPosted(0),
+        mReceived(0),
+        mRuns(0)
+    {
+        ;
+    }
+
+    virtual void run()
+    {
+        ++mRuns;
+        setStatus(StatusTerminated);
+    }
+
+    std::atomic<uint32_t> mPosted;
+    std::atomic<uint32_t> mReceived;
+    uint32_t mRuns;
+};
+
+// Counts the drained requests and detects deliveries that weren't posted.
+class Receiver
+{
+public:
+    Receiver() :
+        mNumReceived(0),
+        mNumUnexpected(0)
+    {
+        ;
+    }
+
+    void operator()(Task* task, uint8_t request)
+    {
+        CountingTask* counting = static_cast<CountingTask*>(task);
+        if(request != TaskInbox::RequestEnqueue ||
+           counting->mReceived.load() >= counting->mPosted.load())
+        {
+            ++mNumUnexpected;
+        }
+        counting->mReceived.fetch_add(1);
+        ++mNumReceived;
+    }
+
+    uint32_t mNumReceived;
+    uint32_t mNumUnexpected;
+};
+
+void postAll(TaskInbox* inbox, std::vector<CountingTask>* tasks, uint32_t begin, uint32_t end)
+{
+    for(uint32_t i = begin; i < end; ++i)
+    {
+        (*tasks)[i].mPosted.fetch_add(1);
+        inbox->post(&(*tasks)[i], TaskInbox::RequestEnqueue);
+    }
+}
+
+// Posts every task __rounds__ times, each time after the previous request was drained.
+void repost(TaskInbox* inbox,
+            std::vector<CountingTask>* tasks,
+            uint32_t begin,
+            uint32_t end,
+            uint32_t rounds)
+{
+    for(uint32_t round = 0; round < rounds; ++round)
+    {
+        for(uint32_t i = begin; i < end; ++i)
+        {
+            (*tasks)[i].mPosted.fetch_add(1);
+            inbox->post(&(*tasks)[i], TaskInbox::RequestEnqueue);
+        }
+        for(uint32_t i = begin; i < end; ++i)
+        {
+            while((*tasks)[i].mReceived.load() <= round)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+} // namespace
+
+AI_TEST(TaskInboxKeepsLastRequest)
+{
+    int failures = 0;
+
+    TaskInbox inbox;
+    CountingTask task;
+    for(uint8_t status = StatusDormant; status <= StatusSleeping; ++status)
+    {
+        inbox.post(&task, TaskInbox::RequestStatus + status);
+    }
+
+    std::vector<uint8_t> requests;
+    struct Collect
+    {
+        std::vector<uint8_t>* requests;
+        void operator()(Task*, uint8_t request)
+        {
+            requests->push_back(request);
+        }
+    } collect = {&requests};
+    inbox.drain(collect);
+
+    AI_CHECK(requests.size() == 1);
+    AI_CHECK(!requests.empty() && requests[0] == TaskInbox::RequestStatus + StatusSleeping);
+    AI_CHECK(inbox.empty());
+    return failures;
+}
+
+AI_TEST(TaskInboxConcurrentPostsArriveOnce)
+{
+    int failures = 0;
+
+    const uint32_t tasksPerProducer = 20000;
+    std::vector<CountingTask> tasks(NUM_PRODUCERS * tasksPerProducer);
+    TaskInbox inbox;
+    Receiver receiver;
+
+    std::vector<std::thread> producers;
+    for(uint32_t i = 0; i < NUM_PRODUCERS; ++i)
+    {
+        producers.push_back(std::thread(&postAll, &inbox, &tasks,
+                                        i * tasksPerProducer, (i + 1) * tasksPerProducer));
+    }
+
+    // Drain concurrently with the producers.
+    while(receiver.mNumReceived < tasks.size())
+    {
+        inbox.drain(receiver);
+    }
+
+    for(uint32_t i = 0; i < producers.size(); ++i)
+    {
+        producers[i].join();
+    }
+    inbox.drain(receiver);
+
+    uint32_t numWrong = 0;
+    for(uint32_t i = 0; i < tasks.size(); ++i)
+    {
+        numWrong += tasks[i].mReceived.load() != 1;
+    }
+    AI_CHECK(numWrong == 0);
+    AI_CHECK(receiver.mNumUnexpected == 0);
+    AI_CHECK(receiver.mNumReceived == tasks.size());
+    AI_CHECK(inbox.empty());
+    return failures;
+}
+
+AI_TEST(TaskInboxRepostedTasksArriveOncePerPost)
+{
+    int failures = 0;
+
+    // Tasks are re-linked while the consumer is still walking the list they left.
+    const uint32_t tasksPerProducer = 16;
+    const uint32_t rounds = 1000;
+    std::vector<CountingTask> tasks(NUM_PRODUCERS * tasksPerProducer);
+    TaskInbox inbox;
+    Receiver receiver;
+
+    std::vector<std::thread> producers;
+    for(uint32_t i = 0; i < NUM_PRODUCERS; ++i)
+    {
+        producers.push_back(std::thread(&repost, &inbox, &tasks,
+                                        i * tasksPerProducer, (i + 1) * tasksPerProducer,
+                                        rounds));
+    }
+
+    while(receiver.mNumReceived < tasks.size() * rounds)
+    {
+        inbox.drain(receiver);
+    }
+
+    for(uint32_t i = 0; i < producers.size(); ++i)
+    {
+        producers[i].join();
+    }
+
+    uint32_t numWrong = 0;
+    for(uint32_t i = 0; i < tasks.size(); ++i)
+    {
+        numWrong += tasks[i].mReceived.load() != rounds;
+    }
+    AI_CHECK(numWrong == 0);
+    AI_CHECK(receiver.mNumUnexpected == 0);
+    AI_CHECK(inbox.empty());
+    return failures;
+}
+
+AI_TEST(SchedulerRunsConcurrentlyPostedTasksOnce)
+{
+    int failures = 0;
+
+    const uint32_t tasksPerProducer = 5000;
+    std::vector<CountingTask> tasks(NUM_PRODUCERS * tasksPerProducer);
+    Scheduler scheduler;
+
+    struct Producer
+    {
+        static void post(Scheduler* scheduler,
+                         std::vector<CountingTask>* tasks,
+                         uint32_t begin,
+                         uint32_t end)
+        {
+            for(uint32_t i = begin; i < end; ++i)
+            {
+                scheduler->post(&(*tasks)[i]);
+            }
+        }
+    };
+
+    std::vector<std::thread> producers;
+    for(uint32_t i = 0; i < NUM_PRODUCERS; ++i)
+    {
+        producers.push_back(std::thread(&Producer::post, &scheduler, &tasks,
+                                        i * tasksPerProducer, (i + 1) * tasksPerProducer));
+    }
+
+    // Update while posting, every update drains the inbox first.
+    uint32_t numRuns = 0;
+    while(numRuns < tasks.size())
+    {
+        scheduler.update(1000000, 0.016f);
+        numRuns = 0;
+        for(uint32_t i = 0; i < tasks.size(); ++i)
+        {
+            numRuns += tasks[i].mRuns;
+        }
+    }
+
+    for(uint32_t i = 0; i < producers.size(); ++i)
+    {
+        producers[i].join();
+    }
+    scheduler.update(1000000, 0.016f);
+
+    uint32_t numWrong = 0;
+    for(uint32_t i = 0; i < tasks.size(); ++i)
+    {
+        numWrong += tasks[i].mRuns != 1;
+    }
+    AI_CHECK(numWrong == 0);
+    AI_CHECK(!scheduler.hasRunningTasks());
+    AI_CHECK(scheduler.validate());
+    return failures;
+}
@@ -0,0 +1,91 @@
+#include "Test.h"
+#include "TaskPool.h"
+#include "Scheduler.h"
+#include "HighResolutionTime.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace ailib;
+
+namespace
+{
+
+const uint32_t NUM_TASKS = 100000;
+const uint32_t NUM_FRAMES = 20;
+// Large enough to run all tasks of a frame.
+const HighResolutionTime::Timestamp FRAME_BUDGET = 10000000;
+
+class ChurnTask : public Task
+{
+public:
+    virtual void run()
+    {
+        setStatus(StatusTerminated);
+    }
+};
+
+class HeapAllocator
+{
+public:
+    ChurnTask* create()
+    {
+        return new ChurnTask();
+    }
+
+    void destroy(ChurnTask* task)
+    {
+        delete task;
+    }
+};
+
+// Every frame creates NUM_TASKS tasks, runs each once and destroys them.
+// @returns The average time per task in nanoseconds.
+template <typename ALLOCATOR>
+double churn(ALLOCATOR& allocator)
+{
+    Scheduler scheduler;
+    std::vector<ChurnTask*> tasks(NUM_TASKS);
+
+    const HighResolutionTime::Timestamp start = HighResolutionTime::now();
+    for(uint32_t frame = 0; frame < NUM_FRAMES; ++frame)
+    {
+        for(uint32_t i = 0; i < NUM_TASKS; ++i)
+        {
+            tasks[i] = allocator.create();
+            scheduler.enqueue(tasks[i]);
+        }
+
+        scheduler.update(FRAME_BUDGET, 0.016f);
+
+        for(uint32_t i = 0; i < NUM_TASKS; ++i)
+        {
+            allocator.destroy(tasks[i]);
+        }
+    }
+    const HighResolutionTime::Timestamp duration = HighResolutionTime::now() - start;
+
+    return duration * 1000.0 / (double(NUM_FRAMES) * NUM_TASKS);
+}
+
+} // namespace
+
+AI_BENCHMARK(TaskPoolChurn)
+{
+    HeapAllocator heap;
+    TaskPool<ChurnTask> pool;
+    pool.reserve(NUM_TASKS);
+
+    // Best of a few alternating runs, the first runs warm up the allocator and caches.
+    double heapTime = std::numeric_limits<double>::max();
+    double poolTime = std::numeric_limits<double>::max();
+    for(uint32_t i = 0; i < 3; ++i)
+    {
+        heapTime = std::min(heapTime, churn(heap));
+        poolTime = std::min(poolTime, churn(pool));
+    }
+
+    std::printf("%u tasks per frame: new/delete %.1f ns per task, TaskPool %.1f ns per task\n",
+                NUM_TASKS, heapTime, poolTime);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef TEST_H
+#define TEST_H
+
+#pragma once
+
+#include <cstdio>
+
+/*
+ * Minimal test support without external dependencies. Tests are functions that return their
+ * number of failed checks and register themselves with AI_TEST or AI_BENCHMARK:
+ *
+ * AI_TEST(TaskInboxKeepsLastRequest)
+ * {
+ *     int failures = 0;
+ *     AI_CHECK(1 + 1 == 2);
+ *     return failures;
+ * }
+ *
+ * Benchmarks print their measurements and only run with "--bench".
+ */
+
+typedef int (*TestFunction)();
+
+class TestRegistration
+{
+public:
+    TestRegistration(const char* name, TestFunction function, bool benchmark);
+};
+
+#define AI_TEST(name) \
+    static int name(); \
+    static TestRegistration name##Registration(#name, &name, false); \
+    static int name()
+
+#define AI_BENCHMARK(name) \
+    static int name(); \
+    static TestRegistration name##Registration(#name, &name, true); \
+    static int name()
+
+#define AI_CHECK(condition) \
+    do \
+    { \
+        if(!(condition)) \
+        { \
+            std::printf("%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failures; \
+        } \
+    } while(0)
+
+#endif // TEST_H
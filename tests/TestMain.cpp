@@ -0,0 +1,71 @@
+#include "Test.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+struct RegisteredTest
+{
+    const char* name;
+    TestFunction function;
+    bool benchmark;
+};
+
+// Constructed on first use, the registrations run during static initialization.
+std::vector<RegisteredTest>& getTests()
+{
+    static std::vector<RegisteredTest> tests;
+    return tests;
+}
+
+} // namespace
+
+TestRegistration::TestRegistration(const char* name, TestFunction function, bool benchmark)
+{
+    RegisteredTest test = {name, function, benchmark};
+    getTests().push_back(test);
+}
+
+// Usage: tests [--bench] [name]
+int main(int argc, char** argv)
+{
+    bool benchmarks = false;
+    const char* filter = NULL;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(std::strcmp(argv[i], "--bench") == 0)
+        {
+            benchmarks = true;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+    int numFailed = 0;
+    int numRun = 0;
+    const std::vector<RegisteredTest>& tests = getTests();
+    for(size_t i = 0; i < tests.size(); ++i)
+    {
+        if(tests[i].benchmark != benchmarks ||
+           (filter && std::strcmp(filter, tests[i].name) != 0))
+        {
+            continue;
+        }
+
+        std::printf("[ RUN  ] %s\n", tests[i].name);
+        const int failures = tests[i].function();
+        std::printf("[ %s ] %s\n", failures == 0 ? " OK " : "FAIL", tests[i].name);
+
+        ++numRun;
+        if(failures != 0)
+        {
+            ++numFailed;
+        }
+    }
+
+    std::printf("%d of %d passed.\n", numRun - numFailed, numRun);
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#-------------------------------------------------
+#
+# Unit tests and benchmarks of AICore.
+# Run "tests" for the tests, "tests --bench" for the benchmarks.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+TARGET = tests
+TEMPLATE = app
+CONFIG += console c++11 thread
+CONFIG -= app_bundle
+
+SOURCES += \
+    TestMain.cpp \
+    TaskInboxTest.cpp \
+    TaskPoolBenchmark.cpp \
+    SchedulerFuzzTest.cpp \
+    BehaviorTreeLoaderTest.cpp \
+    BehaviorProfilerTest.cpp \
+    RandomBenchmark.cpp \
+    BlackboardTest.cpp \
+    SchedulerStatisticsTest.cpp \
+    CoroutineTest.cpp \
+    ParallelSchedulerTest.cpp \
+    FlatBehaviorTreeTest.cpp \
+    DecoratorsTest.cpp \
+    NavMeshTest.cpp
+
+HEADERS += \
+    Test.h
+
+CONFIG(release, debug|release) {
+    M_BUILD_DIR = release
+} else {
+    M_BUILD_DIR = debug
+}
+
+win32:LIBS += -L$$OUT_PWD/../AICore/$$M_BUILD_DIR/ -lailib \
+              -L$$OUT_PWD/../LinearMath/$$M_BUILD_DIR/ -lLinearMath
+else:unix:LIBS += -L$$OUT_PWD/../AICore/ -lailib \
+                  -L$$OUT_PWD/../LinearMath/ -lLinearMath
+
+INCLUDEPATH += $$PWD/../AICore $$PWD/../LinearMath $$PWD/..
+DEPENDPATH += $$PWD/../AICore $$PWD/../LinearMath
+
+win32-g++: PRE_TARGETDEPS += $$OUT_PWD/../AICore/$$M_BUILD_DIR/libailib.a
+else:win32:!win32-g++: PRE_TARGETDEPS += $$OUT_PWD/../AICore/$$M_BUILD_DIR/ailib.lib
+else:unix: PRE_TARGETDEPS += $$OUT_PWD/../AICore/libailib.a